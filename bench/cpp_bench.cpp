@@ -0,0 +1,279 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* Compare reading through plhm.hpp with reading through the C
+ * interface.  A thread plays the device on a pseudo-terminal, writing
+ * frames of binary records as fast as they are read; each path reads
+ * them and sums the fields, and the CPU time of the reading thread is
+ * measured per frame.  Each field set is run several times, the paths
+ * alternating, and the best run of each is reported.
+ *
+ *   cpp_bench [frames [stations [runs]]] */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include <plhm.hpp>
+
+static int frames = 200000, stations = 8, runs = 5;
+static int master;
+static int record_bytes;
+static std::vector<char> frame;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double thread_cpu()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+        + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+/* Frames of records with the fields F, the frame number in the
+ * timestamp where there is one. */
+template <int F>
+static void make_frame()
+{
+    typedef plhm::Layout<F> L;
+    record_bytes = L::bytes;
+    frame.assign(stations * L::bytes, 0);
+    for (int s = 0; s < stations; s++) {
+        char *r = &frame[s * L::bytes];
+        float pos[3] = { (float)s, 2.0f * s, -1.0f };
+        float euler[3] = { 10.0f * s, 5.0f, -20.0f };
+        short size = L::bytes - 8;
+        r[0] = 'L';
+        r[1] = 'Y';
+        r[2] = s + 1;
+        r[3] = 'C';
+        r[4] = ' ';
+        r[5] = 0;
+        memcpy(r + 6, &size, 2);
+        if (F & plhm::Position)
+            memcpy(r + L::position, pos, 12);
+        if (F & plhm::Euler)
+            memcpy(r + L::euler, euler, 12);
+        r[L::bytes - 2] = '\r';
+        r[L::bytes - 1] = '\n';
+    }
+}
+
+static void *play_device(void *arg)
+{
+    int ts_offset = *(int*)arg;
+    std::vector<char> f(frame);
+    for (unsigned int i = 0; i < (unsigned)frames; i++) {
+        if (ts_offset >= 0)
+            for (int s = 0; s < stations; s++)
+                memcpy(&f[s * record_bytes + ts_offset], &i, 4);
+        if (write(master, f.data(), f.size()) != (ssize_t)f.size()) {
+            perror("write");
+            break;
+        }
+    }
+    return 0;
+}
+
+struct result { double cpu, wall, sum; };
+
+static void open_device(plhm::Device &dev, int fields)
+{
+    plhm_t *p = dev.get();
+    p->binary = 1;
+    p->fields = fields | PLHM_DATA_CRLF;
+    p->stations = stations;
+}
+
+template <int F>
+static int run_c(const char *device, result &res)
+{
+    typedef plhm::Layout<F> L;
+    plhm::Device dev(device);
+    plhm_record_t r;
+    pthread_t thread;
+    int ts_offset = F & plhm::Timestamp ? (int)L::timestamp : -1;
+    double sum = 0, cpu, wall;
+    int i, s, rc = 0;
+
+    open_device(dev, F);
+    pthread_create(&thread, 0, play_device, &ts_offset);
+    cpu = thread_cpu();
+    wall = now();
+
+    for (i = 0; i < frames && !rc; i++)
+        for (s = 0; s < stations && !rc; s++) {
+            if ((rc = plhm_read_data_record(dev.get(), &r)))
+                break;
+            if (r.fields & PLHM_DATA_POSITION)
+                sum += r.position[0] + r.position[1] + r.position[2];
+            if (r.fields & PLHM_DATA_EULER)
+                sum += r.euler[0] + r.euler[1] + r.euler[2];
+            if (r.fields & PLHM_DATA_TIMESTAMP)
+                sum += r.timestamp;
+        }
+
+    res.cpu = thread_cpu() - cpu;
+    res.wall = now() - wall;
+    res.sum = sum;
+    pthread_join(thread, 0);
+    return rc;
+}
+
+/* Sums of each field of a record; the accessors of fields a stream
+ * lacks do not compile, so those are left out by specialization. */
+template <int F, bool = (F & plhm::Position) != 0>
+struct position_sum {
+    static double of(const plhm::Record<F> &r) {
+        plhm::Vec3 v = r.position();
+        return v.x + v.y + v.z;
+    }
+};
+template <int F> struct position_sum<F, false> {
+    static double of(const plhm::Record<F> &) { return 0; }
+};
+
+template <int F, bool = (F & plhm::Euler) != 0>
+struct euler_sum {
+    static double of(const plhm::Record<F> &r) {
+        plhm::Angles a = r.euler();
+        return a.azimuth + a.elevation + a.roll;
+    }
+};
+template <int F> struct euler_sum<F, false> {
+    static double of(const plhm::Record<F> &) { return 0; }
+};
+
+template <int F, bool = (F & plhm::Timestamp) != 0>
+struct timestamp_sum {
+    static double of(const plhm::Record<F> &r) { return r.timestamp(); }
+};
+template <int F> struct timestamp_sum<F, false> {
+    static double of(const plhm::Record<F> &) { return 0; }
+};
+
+template <int F>
+static int run_cpp(const char *device, result &res)
+{
+    typedef plhm::Layout<F> L;
+    plhm::Device dev(device);
+    pthread_t thread;
+    int ts_offset = F & plhm::Timestamp ? (int)L::timestamp : -1;
+    double sum = 0, cpu, wall;
+    int i, rc = 0;
+
+    open_device(dev, F);
+    plhm::Stream<F> stream(dev, plhm::streaming);
+    pthread_create(&thread, 0, play_device, &ts_offset);
+    cpu = thread_cpu();
+    wall = now();
+
+    try {
+        for (i = 0; i < frames; i++)
+            for (auto r : stream.read()) {
+                sum += position_sum<F>::of(r);
+                sum += euler_sum<F>::of(r);
+                sum += timestamp_sum<F>::of(r);
+            }
+    }
+    catch (plhm::Error &e) {
+        printf("%s\n", e.what());
+        rc = 1;
+    }
+
+    res.cpu = thread_cpu() - cpu;
+    res.wall = now() - wall;
+    res.sum = sum;
+    pthread_join(thread, 0);
+    return rc;
+}
+
+template <int F>
+static int compare(const char *device, const char *name)
+{
+    result c, cpp, best_c = { 1e9, 1e9, 0 }, best_cpp = { 1e9, 1e9, 0 };
+    int i, rc = 0;
+
+    make_frame<F>();
+    for (i = 0; i < runs && !rc; i++) {
+        rc |= run_c<F>(device, c);
+        rc |= run_cpp<F>(device, cpp);
+        if (c.sum != cpp.sum) {
+            printf("%s: the paths disagree (%g, %g)\n", name, c.sum, cpp.sum);
+            rc = 1;
+        }
+        if (c.cpu < best_c.cpu) best_c = c;
+        if (cpp.cpu < best_cpp.cpu) best_cpp = cpp;
+    }
+    if (rc)
+        return rc;
+
+    printf("%-8s %-5s %10.3f %10.3f %10.0f\n", name, "C",
+           best_c.cpu / frames * 1e6, best_c.wall / frames * 1e6,
+           frames / best_c.wall);
+    printf("%-8s %-5s %10.3f %10.3f %10.0f %+9.1f%%\n", name, "C++",
+           best_cpp.cpu / frames * 1e6, best_cpp.wall / frames * 1e6,
+           frames / best_cpp.wall,
+           (best_cpp.cpu - best_c.cpu) / best_c.cpu * 100);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *device;
+    int rc = 0;
+
+    if (argc > 1) frames = atoi(argv[1]);
+    if (argc > 2) stations = atoi(argv[2]);
+    if (argc > 3) runs = atoi(argv[3]);
+    if (frames < 1 || stations < 1 || stations > 16 || runs < 1) {
+        printf("Usage: %s [frames [stations [runs]]]\n", argv[0]);
+        return 1;
+    }
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)
+        || !(device = ptsname(master)))
+    {
+        perror("posix_openpt");
+        return 1;
+    }
+
+    printf("%d frames of %d stations through %s, best of %d\n\n",
+           frames, stations, device, runs);
+    printf("%-8s %-5s %10s %10s %10s %10s\n", "fields", "path",
+           "cpu us/fr", "wall us/fr", "frames/s", "cpu vs C");
+    try {
+        rc |= compare<plhm::Position>(device, "P");
+        rc |= compare<plhm::Position | plhm::Euler>(device, "PE");
+        rc |= compare<plhm::Position | plhm::Euler | plhm::Timestamp>(device, "PET");
+    }
+    catch (plhm::Error &e) {
+        printf("%s\n", e.what());
+        rc = 1;
+    }
+
+    close(master);
+    return rc;
+}
@@ -0,0 +1,197 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* Compare the read() and io_uring input paths.  A thread plays the
+ * device on a pseudo-terminal, writing a frame of binary records at a
+ * fixed rate with the frame number in the timestamp field; the reader
+ * measures the system calls it makes per frame, the CPU time the
+ * process spends per frame, apart from the writing thread but with any
+ * io_uring worker threads, and the time from the write to the last
+ * record of the frame being parsed.
+ *
+ *   input_bench [frames [rate [stations]]] */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include <plhm.h>
+
+#define FIELDS (PLHM_DATA_POSITION | PLHM_DATA_EULER | PLHM_DATA_TIMESTAMP \
+                | PLHM_DATA_CRLF)
+#define RECORD_BYTES (20 + 12 + 4 + 2)
+
+static int frames = 1000, rate = 240, stations = 8;
+static int master;
+static double *sent;
+static double player_cpu;   // us, of the thread playing the device
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double cpu_us(const struct rusage *a, const struct rusage *b)
+{
+    return ((b->ru_utime.tv_sec - a->ru_utime.tv_sec
+             + b->ru_stime.tv_sec - a->ru_stime.tv_sec) * 1e6
+            + (b->ru_utime.tv_usec - a->ru_utime.tv_usec
+               + b->ru_stime.tv_usec - a->ru_stime.tv_usec));
+}
+
+static void *play_device(void *arg)
+{
+    unsigned char frame[16 * RECORD_BYTES];
+    struct timespec next;
+    struct rusage start, end;
+    int i, s;
+
+    getrusage(RUSAGE_THREAD, &start);
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (i = 0; i < frames; i++)
+    {
+        for (s = 0; s < stations; s++) {
+            unsigned char *r = frame + s * RECORD_BYTES;
+            float v[6] = { s, 2.0f * s, -1.0f, 10.0f * s, 5.0f, -20.0f };
+            unsigned int ts = i;
+            short size = RECORD_BYTES - 8;
+            r[0] = 'L';
+            r[1] = 'Y';
+            r[2] = s + 1;
+            r[3] = 'C';
+            r[4] = ' ';
+            r[5] = 0;
+            memcpy(r + 6, &size, 2);
+            memcpy(r + 8, v, sizeof(v));
+            memcpy(r + 32, &ts, 4);
+            r[36] = '\r';
+            r[37] = '\n';
+        }
+
+        next.tv_nsec += 1000000000L / rate;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, 0);
+
+        sent[i] = now();
+        if (write(master, frame, stations * RECORD_BYTES)
+            != stations * RECORD_BYTES)
+            perror("write");
+    }
+    getrusage(RUSAGE_THREAD, &end);
+    player_cpu = cpu_us(&start, &end);
+    return 0;
+}
+
+static int compare(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static int run(const char *name, const char *device, plhm_input input)
+{
+    plhm_t p;
+    plhm_record_t r;
+    pthread_t thread;
+    struct rusage start, end;
+    double *latency = calloc(frames, sizeof(double)), sum = 0, cpu;
+    int i, s, n = 0;
+
+    memset(&p, 0, sizeof(p));
+    if (plhm_set_input(&p, input)) {
+        printf("%-8s unavailable\n", name);
+        free(latency);
+        return 0;
+    }
+    if (plhm_open_device(&p, device))
+        return 1;
+    p.binary = 1;
+    p.fields = FIELDS;
+    p.stations = stations;
+
+    // io_uring may hand reads to worker threads of the process, so
+    // count the whole process and take the player's share off
+    getrusage(RUSAGE_SELF, &start);
+    pthread_create(&thread, 0, play_device, 0);
+
+    for (i = 0; i < frames; i++) {
+        for (s = 0; s < stations; s++)
+            if (plhm_read_data_record(&p, &r)) {
+                printf("%s: read failed at frame %d\n", name, i);
+                goto done;
+            }
+        if (r.timestamp < (unsigned)frames) {
+            latency[n] = (now() - sent[r.timestamp]) * 1e6;
+            sum += latency[n++];
+        }
+    }
+
+  done:
+    pthread_join(thread, 0);
+    getrusage(RUSAGE_SELF, &end);
+    cpu = cpu_us(&start, &end) - player_cpu;
+
+    qsort(latency, n, sizeof(double), compare);
+    if (n)
+        printf("%-8s %10.2f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name,
+               (double)p.input_calls / n, cpu / n, sum / n,
+               latency[n / 2], latency[(int)(n * 0.99)], latency[n - 1]);
+
+    plhm_close_device(&p);
+    free(latency);
+    return n != frames;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *device;
+    int rc = 0;
+
+    if (argc > 1) frames = atoi(argv[1]);
+    if (argc > 2) rate = atoi(argv[2]);
+    if (argc > 3) stations = atoi(argv[3]);
+    if (frames < 1 || rate < 1 || stations < 1 || stations > 16) {
+        printf("Usage: %s [frames [rate [stations]]]\n", argv[0]);
+        return 1;
+    }
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)
+        || !(device = ptsname(master)))
+    {
+        perror("posix_openpt");
+        return 1;
+    }
+    sent = calloc(frames, sizeof(double));
+
+    printf("%d frames of %d stations at %d Hz through %s\n\n",
+           frames, stations, rate, device);
+    printf("%-8s %10s %10s %10s %10s %10s %10s\n", "input",
+           "calls/fr", "cpu us/fr", "mean us", "p50 us", "p99 us", "max us");
+    rc |= run("read", device, PLHM_INPUT_READ);
+    rc |= run("io_uring", device, PLHM_INPUT_URING);
+
+    close(master);
+    free(sent);
+    return rc;
+}
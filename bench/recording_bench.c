@@ -0,0 +1,153 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* Record a synthetic session of slowly moving stations, report the
+ * compression ratio against the text format and the encode and decode
+ * rates, and check that the round trip is lossless. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <plhm_recording.h>
+
+#define STATIONS 8
+#define FRAMES 200000
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make_frame(plhm_record_t *recs, int frame)
+{
+    // 240 Hz with some read-time jitter, sensor quantization of 0.01
+    long long usec = 1000000000LL + frame * 4167LL + (rand() % 200);
+    int i;
+
+    for (i = 0; i < STATIONS; i++) {
+        float t = frame / 240.0f;
+        recs[i].fields = (PLHM_DATA_POSITION | PLHM_DATA_EULER
+                          | PLHM_DATA_TIMESTAMP);
+        recs[i].station = i + 1;
+        recs[i].error = ' ';
+        recs[i].position[0] = roundf(1000 * sinf(t * 0.3f + i)) / 100;
+        recs[i].position[1] = roundf(1000 * cosf(t * 0.2f + i)) / 100;
+        recs[i].position[2] = roundf(500 * sinf(t * 0.1f)) / 100;
+        recs[i].euler[0] = roundf(9000 * sinf(t * 0.05f + i)) / 100;
+        recs[i].euler[1] = roundf(3000 * cosf(t * 0.07f)) / 100;
+        recs[i].euler[2] = -20.0f;
+        recs[i].timestamp = frame * 4;
+        recs[i].readtime.tv_sec = usec / 1000000;
+        recs[i].readtime.tv_usec = usec % 1000000;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static plhm_record_t recs[PLHM_REC_BLOCK_FRAMES
+                              * PLHM_REC_MAX_STATIONS];
+    plhm_record_t frame[STATIONS];
+    plhm_rec_writer_t w;
+    plhm_rec_reader_t r;
+    plhm_rec_block_t b;
+    char *data;
+    size_t size;
+    unsigned long long text = 0;
+    double start, encode, decode;
+    int i, n, frames = 0, errors = 0, rc;
+    FILE *file = open_memstream(&data, &size);
+
+    if (!file || plhm_rec_writer_open(&w, file))
+        return 1;
+
+    srand(1);
+    start = now();
+    for (i = 0; i < FRAMES; i++) {
+        make_frame(frame, i);
+        plhm_rec_write(&w, frame, STATIONS);
+    }
+    plhm_rec_writer_close(&w);
+    encode = now() - start;
+    fclose(file);
+
+    // size of the same session written by plhm -o
+    srand(1);
+    for (i = 0; i < FRAMES; i++) {
+        char line[256];
+        int j;
+        make_frame(frame, i);
+        for (j = 0; j < STATIONS; j++)
+            text += snprintf(line, sizeof(line),
+                             "%d, %.4f, %.4f, %.4f, %.4f, %.4f, %.4f, "
+                             "%u, %f\n", j + 1,
+                             frame[j].position[0], frame[j].position[1],
+                             frame[j].position[2], frame[j].euler[0],
+                             frame[j].euler[1], frame[j].euler[2],
+                             frame[j].timestamp,
+                             frame[j].readtime.tv_sec * 1000.0
+                             + frame[j].readtime.tv_usec / 1000.0);
+    }
+
+    if (plhm_rec_reader_init(&r, data, size))
+        return 1;
+    start = now();
+    while ((rc = plhm_rec_next_block(&r, &b)) == 0) {
+        n = plhm_rec_decode_block(&b, recs);
+        if (n < 0)
+            break;
+        frames += n / STATIONS;
+        __asm__ __volatile__("" : : "r"(recs) : "memory");
+    }
+    decode = now() - start;
+
+    // check the round trip
+    srand(1);
+    plhm_rec_reader_init(&r, data, size);
+    i = 0;
+    while (plhm_rec_next_block(&r, &b) == 0) {
+        int j;
+        n = plhm_rec_decode_block(&b, recs);
+        for (j = 0; j < n; j++) {
+            if (j % STATIONS == 0)
+                make_frame(frame, i++);
+            if (memcmp(recs[j].position, frame[j % STATIONS].position, 12)
+                || memcmp(recs[j].euler, frame[j % STATIONS].euler, 12)
+                || recs[j].timestamp != frame[j % STATIONS].timestamp
+                || recs[j].readtime.tv_sec
+                   != frame[j % STATIONS].readtime.tv_sec
+                || recs[j].readtime.tv_usec
+                   != frame[j % STATIONS].readtime.tv_usec
+                || recs[j].station != frame[j % STATIONS].station)
+                errors++;
+        }
+    }
+
+    printf("frames:       %d of %d decoded, %d mismatched records\n",
+           frames, FRAMES, errors);
+    printf("size:         %zu bytes, %.2f bits per value\n", size,
+           size * 8.0 / (FRAMES * STATIONS * 8.0));
+    printf("vs. text:     %.1fx smaller\n", (double)text / size);
+    printf("encode:       %.0f frames/s (%.2f us per frame)\n",
+           FRAMES / encode, encode / FRAMES * 1e6);
+    printf("decode:       %.0f MB/s compressed, %.0f MB/s of records, "
+           "%.1f M records/s\n", size / decode / 1e6,
+           frames * STATIONS * sizeof(plhm_record_t) / decode / 1e6,
+           frames * STATIONS / decode / 1e6);
+
+    free(data);
+    return (rc < 0 || frames != FRAMES || errors) ? 1 : 0;
+}
@@ -0,0 +1,756 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* End-to-end soak test of the plhm daemon.  The daemon is started
+ * with -D on a pseudo-terminal where a thread plays a Liberty,
+ * answering its commands and streaming binary records once told to.
+ * Each record carries the frame number in its timestamp and the time
+ * it was written, in microseconds modulo 2^24, in its x position,
+ * which a float holds exactly.  Local UDP receivers, the -s
+ * destination and the rest subscribed through -l, time each bundle
+ * against that, and the compressed recording the daemon writes is
+ * checked for missing frames at the end.  The daemon's CPU time and
+ * resident size are sampled every second.
+ *
+ * The report is JSON, on stdout or in the file given with -o.
+ * Options after -- are passed to the daemon; those that change
+ * positions or timestamps (-g, -f, -r) make the latency meaningless.
+ *
+ *   soak_bench [-t seconds] [-w warmup] [-r rate] [-s stations]
+ *              [-n receivers] [-x path/to/plhm] [-o report] [-k]
+ *              [-v] [-- daemon options] */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <plhm.h>
+#include <plhm_recording.h>
+
+#define MAX_RECEIVERS 16
+#define SEND_MASK ((1 << 24) - 1)
+
+// latency histogram: 10 us buckets up to 1 s
+#define BUCKET_US 10
+#define BUCKETS 100000
+
+static int seconds = 60, warmup = 3, rate = 240, stations = 8;
+static int n_receivers = 2, verbose = 0, keep = 0;
+
+/* Device state, as set by the daemon's commands. */
+static int master;
+static volatile int streaming = 0, quit = 0;
+static int fields = 0, binary = 0, active = ~0, device_rate = 240;
+static volatile unsigned int frames_sent = 0, overruns = 0;
+static volatile double stream_start = 0;
+
+typedef struct {
+    int sock, port;
+    unsigned long long bundles, received, reordered;
+    long long first, last;
+    unsigned long long hist[BUCKETS + 1];
+    double sum, max;
+} receiver_t;
+
+static receiver_t receivers[MAX_RECEIVERS];
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t now_us()
+{
+    return (uint32_t)(uint64_t)(now() * 1e6) & SEND_MASK;
+}
+
+static void respond(const char *s)
+{
+    if (write(master, s, strlen(s)) < 0)
+        perror("write");
+}
+
+static void command(const char *c)
+{
+    char buf[64];
+    int a, b;
+
+    if (!strcmp(c, "\x16")) {
+        respond("Liberty emulated by soak_bench\r\n");
+    }
+    else if (c[0] == 0x16 && sscanf(c + 1, "%d", &a) == 1) {
+        if (a >= 1 && a <= stations) {
+            sprintf(buf, "Station %d ID:1\r\n", a);
+            respond(buf);
+        }
+        else
+            respond("ID:0\r\n");
+    }
+    else if (c[0] == 0x14) {
+        respond("0\r\n");
+    }
+    else if (c[0] == 0x15 && sscanf(c + 1, "%d,%d", &a, &b) == 2) {
+        if (a >= 1 && a <= 16) {
+            if (b)
+                active |= 1 << (a - 1);
+            else
+                active &= ~(1 << (a - 1));
+        }
+    }
+    else if (!strcmp(c, "C")) {
+        if (!stream_start)
+            stream_start = now();
+        streaming = 1;
+    }
+    else if (!strcmp(c, "F0"))
+        binary = 0;
+    else if (!strcmp(c, "F1"))
+        binary = 1;
+    else if (!strcmp(c, "R3"))
+        device_rate = 120;
+    else if (!strcmp(c, "R4"))
+        device_rate = 240;
+    else if (!strncmp(c, "O*", 2)) {
+        const char *p = c + 2;
+        fields = 0;
+        while (*p == ',') {
+            switch (atoi(++p)) {
+            case 1: fields |= PLHM_DATA_CRLF; break;
+            case 2: fields |= PLHM_DATA_POSITION; break;
+            case 4: fields |= PLHM_DATA_EULER; break;
+            case 8: fields |= PLHM_DATA_TIMESTAMP; break;
+            }
+            while (*p && *p != ',')
+                p++;
+        }
+    }
+    // hemisphere and units need no answer
+}
+
+/* Write one frame of binary records for the active stations. */
+static void write_frame(unsigned int seq)
+{
+    unsigned char frame[16 * 48], *r = frame;
+    float x = (float)now_us();
+    int s;
+
+    for (s = 0; s < stations; s++)
+    {
+        short size = 0;
+        unsigned char *start = r;
+        float v[3] = { 0, 10.0f * s, -1.0f };
+
+        if (!(active & (1 << s)))
+            continue;
+        r[0] = 'L';
+        r[1] = 'Y';
+        r[2] = s + 1;
+        r[3] = 'C';
+        r[4] = ' ';
+        r[5] = 0;
+        r += 8;
+        if (fields & PLHM_DATA_POSITION) {
+            v[0] = x;
+            memcpy(r, v, 12);
+            r += 12;
+        }
+        if (fields & PLHM_DATA_EULER) {
+            float e[3] = { 5.0f * s, 10.0f, -20.0f };
+            memcpy(r, e, 12);
+            r += 12;
+        }
+        if (fields & PLHM_DATA_TIMESTAMP) {
+            memcpy(r, &seq, 4);
+            r += 4;
+        }
+        if (fields & PLHM_DATA_CRLF) {
+            r[0] = '\r';
+            r[1] = '\n';
+            r += 2;
+        }
+        size = r - start - 8;
+        memcpy(start + 6, &size, 2);
+    }
+
+    if (r > frame && write(master, frame, r - frame) != r - frame)
+        perror("write");
+}
+
+/* Play the device: answer commands, and stream while asked to. */
+static void *play_device(void *arg)
+{
+    char cmd[256];
+    int len = 0;
+    double next = 0;
+
+    while (!quit)
+    {
+        struct pollfd pfd = { master, POLLIN, 0 };
+        double wait = 0.01;
+        struct timespec timeout;
+        int rc;
+
+        if (streaming && binary) {
+            double t = now();
+            if (!next)
+                next = t;
+            if (t >= next) {
+                write_frame(frames_sent++);
+                next += 1.0 / device_rate;
+                // more than a frame behind: the daemon is not reading
+                if (now() > next + 1.0 / device_rate) {
+                    overruns++;
+                    next = now();
+                }
+            }
+            wait = next - now();
+            if (wait < 0)
+                wait = 0;
+        }
+        else
+            next = 0;
+
+        timeout.tv_sec = 0;
+        timeout.tv_nsec = (long)(wait * 1e9);
+        rc = ppoll(&pfd, 1, &timeout, 0);
+        if (rc <= 0 || !(pfd.revents & POLLIN))
+            continue;
+        rc = read(master, cmd + len, sizeof(cmd) - 1 - len);
+        if (rc <= 0)
+            continue;
+        len += rc;
+
+        // 'P' stands alone; everything else ends with a return
+        while (len > 0)
+        {
+            char *cr;
+            if (cmd[0] == 'P') {
+                streaming = 0;
+                memmove(cmd, cmd + 1, --len);
+                continue;
+            }
+            cmd[len] = 0;
+            if (!(cr = memchr(cmd, '\r', len))) {
+                if (len == sizeof(cmd) - 1)
+                    len = 0;
+                break;
+            }
+            *cr = 0;
+            command(cmd);
+            len -= cr + 1 - cmd;
+            memmove(cmd, cr + 1, len);
+        }
+    }
+    return 0;
+}
+
+/* Read the OSC string at p, returning the position after its
+ * padding, or 0 past the end. */
+static const char *osc_string(const char *p, const char *end)
+{
+    const char *z = memchr(p, 0, end - p);
+    if (!z)
+        return 0;
+    p += ((z - p) / 4 + 1) * 4;
+    return p <= end ? p : 0;
+}
+
+static uint32_t osc_int(const char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return ntohl(v);
+}
+
+/* Find the frame number and send time of station 1 in a bundle.
+ * Returns 0 if both were found. */
+static int parse_bundle(const char *b, int size, uint32_t *seq, uint32_t *sent)
+{
+    const char *p = b + 16, *end = b + size;
+    int found = 0;
+
+    if (size < 16 || memcmp(b, "#bundle", 8))
+        return 1;
+
+    while (p + 4 <= end && found != 3)
+    {
+        uint32_t len = osc_int(p);
+        const char *m = p + 4, *types, *args;
+        p = m + len;
+        if (p > end || !(types = osc_string(m, p))
+            || !(args = osc_string(types, p)) || args + 4 > p)
+            continue;
+
+        if (!strcmp(m, "/liberty/marker/1/x") && !strcmp(types, ",f")) {
+            uint32_t v = osc_int(args);
+            float f;
+            memcpy(&f, &v, 4);
+            *sent = (uint32_t)f;
+            found |= 1;
+        }
+        else if (!strcmp(m, "/liberty/marker/1/timestamp")
+                 && !strcmp(types, ",i")) {
+            *seq = osc_int(args);
+            found |= 2;
+        }
+    }
+    return found != 3;
+}
+
+static void *receive(void *arg)
+{
+    struct pollfd pfd[MAX_RECEIVERS];
+    char buf[65536];
+    unsigned int skip = warmup * rate;
+    int i;
+
+    for (i = 0; i < n_receivers; i++) {
+        pfd[i].fd = receivers[i].sock;
+        pfd[i].events = POLLIN;
+    }
+
+    while (!quit)
+    {
+        if (poll(pfd, n_receivers, 100) <= 0)
+            continue;
+
+        for (i = 0; i < n_receivers; i++)
+        {
+            receiver_t *r = &receivers[i];
+            uint32_t seq = 0, sent = 0, us;
+            int size;
+
+            if (!(pfd[i].revents & POLLIN))
+                continue;
+            while ((size = recv(r->sock, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+            {
+                us = now_us();
+                r->bundles++;
+                if (parse_bundle(buf, size, &seq, &sent) || seq < skip)
+                    continue;
+
+                us = (us - sent) & SEND_MASK;
+                r->hist[us / BUCKET_US < BUCKETS ? us / BUCKET_US : BUCKETS]++;
+                r->sum += us;
+                if (us > r->max)
+                    r->max = us;
+
+                if (!r->received)
+                    r->first = r->last = seq;
+                else if (seq > r->last)
+                    r->last = seq;
+                else {
+                    r->reordered++;
+                    continue;
+                }
+                r->received++;
+            }
+        }
+    }
+    return 0;
+}
+
+static double percentile(const unsigned long long *hist, unsigned long long n,
+                         double p)
+{
+    unsigned long long want = (unsigned long long)(n * p), c = 0;
+    int i;
+    for (i = 0; i <= BUCKETS; i++)
+        if ((c += hist[i]) > want)
+            return (i + 0.5) * BUCKET_US;
+    return 0;
+}
+
+/* CPU seconds and resident kB of a process, or -1. */
+static int proc_usage(pid_t pid, double *cpu, long *rss)
+{
+    char path[64], buf[1024], *c;
+    unsigned long utime, stime;
+    FILE *f;
+
+    sprintf(path, "/proc/%d/stat", pid);
+    if (!(f = fopen(path, "r")))
+        return -1;
+    c = fgets(buf, sizeof(buf), f) ? strrchr(buf, ')') : 0;
+    fclose(f);
+    if (!c || sscanf(c + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+                     "%lu %lu", &utime, &stime) != 2)
+        return -1;
+    *cpu = (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+
+    sprintf(path, "/proc/%d/status", pid);
+    if (!(f = fopen(path, "r")))
+        return -1;
+    *rss = 0;
+    while (fgets(buf, sizeof(buf), f))
+        if (sscanf(buf, "VmRSS: %ld", rss) == 1)
+            break;
+    fclose(f);
+    return 0;
+}
+
+static int open_receiver(receiver_t *r)
+{
+    struct sockaddr_in a;
+    socklen_t len = sizeof(a);
+    int size = 4 << 20;
+
+    memset(r, 0, sizeof(*r));
+    r->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (r->sock < 0 || bind(r->sock, (struct sockaddr*)&a, sizeof(a))
+        || getsockname(r->sock, (struct sockaddr*)&a, &len))
+        return 1;
+    setsockopt(r->sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    r->port = ntohs(a.sin_port);
+    return 0;
+}
+
+/* A port that was free a moment ago, for the daemon to listen on. */
+static int free_port()
+{
+    receiver_t r;
+    if (open_receiver(&r))
+        return 0;
+    close(r.sock);
+    return r.port;
+}
+
+static char *osc_put_string(char *p, const char *s)
+{
+    int n = strlen(s) + 1;
+    memcpy(p, s, n);
+    memset(p + n, 0, 3);
+    return p + (n + 3) / 4 * 4;
+}
+
+static char *osc_put_int(char *p, int32_t i)
+{
+    uint32_t v = htonl(i);
+    memcpy(p, &v, 4);
+    return p + 4;
+}
+
+/* Subscribe a receiver to all stations and fields, without expiry. */
+static void subscribe(int port, int listen_port)
+{
+    struct sockaddr_in a;
+    char msg[128], *p = msg;
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+
+    p = osc_put_string(p, "/liberty/subscribe");
+    p = osc_put_string(p, ",siiisi");
+    p = osc_put_string(p, "127.0.0.1");
+    p = osc_put_int(p, port);
+    p = osc_put_int(p, 1);
+    p = osc_put_int(p, 0);
+    p = osc_put_string(p, "");
+    p = osc_put_int(p, 0);
+
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    a.sin_port = htons(listen_port);
+    if (s >= 0) {
+        sendto(s, msg, p - msg, 0, (struct sockaddr*)&a, sizeof(a));
+        close(s);
+    }
+}
+
+/* Count the frames of station 1 in the recording, from the first
+ * after the warmup.  Returns the number missing. */
+static long long check_recording(const char *path, unsigned long long *records)
+{
+    plhm_rec_reader_t rd;
+    plhm_rec_block_t b;
+    plhm_record_t *recs;
+    long long first = -1, last = -1, frames = 0;
+    unsigned int skip = warmup * rate;
+    int i, n;
+
+    *records = 0;
+    recs = malloc(sizeof(plhm_record_t) * PLHM_REC_BLOCK_FRAMES
+                  * PLHM_REC_MAX_STATIONS);
+    if (!recs || plhm_rec_reader_open(&rd, path)) {
+        free(recs);
+        return -1;
+    }
+    while (plhm_rec_next_block(&rd, &b) == 0) {
+        if ((n = plhm_rec_decode_block(&b, recs)) < 0)
+            continue;
+        *records += n;
+        for (i = 0; i < n; i++) {
+            if (recs[i].station != 1 || recs[i].timestamp < skip
+                || (long long)recs[i].timestamp <= last)
+                continue;
+            if (first < 0)
+                first = recs[i].timestamp;
+            last = recs[i].timestamp;
+            frames++;
+        }
+    }
+    plhm_rec_reader_close(&rd);
+    free(recs);
+    return first < 0 ? -1 : last - first + 1 - frames;
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [options] [-- daemon options]\n"
+"  -t <seconds>   soak period after the warmup (default 60)\n"
+"  -w <seconds>   warmup, not measured (default 3)\n"
+"  -r <Hz>        frame rate of the emulated device (default 240)\n"
+"  -s <n>         stations (default 8)\n"
+"  -n <n>         UDP receivers (default 2, at most %d); 0 for a\n"
+"                 daemon built without OSC\n"
+"  -x <path>      daemon to run (default ../src/plhm)\n"
+"  -o <path>      write the report there rather than to stdout\n"
+"  -k             keep the daemon's recording\n"
+"  -v             show the daemon's output and progress\n",
+           name, MAX_RECEIVERS);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *daemon = "../src/plhm", *report = 0, *device;
+    char recording[] = "/tmp/plhm-soak-XXXXXX";
+    char url[64], port_arg[16], output_arg[64];
+    char **args;
+    pthread_t device_thread, receive_thread;
+    int c, i, n, slave, listen_port, status, fd;
+    double t0 = 0, cpu0 = 0, cpu = 0, elapsed, last_sub = 0;
+    long rss = 0, rss0 = 0, rss_max = 0;
+    unsigned long long records;
+    long long file_lost;
+    pid_t pid;
+    FILE *out;
+    struct termios tio;
+
+    while ((c = getopt(argc, argv, "t:w:r:s:n:x:o:kvh")) != -1)
+    {
+        switch (c) {
+        case 't': seconds = atoi(optarg); break;
+        case 'w': warmup = atoi(optarg); break;
+        case 'r': rate = atoi(optarg); break;
+        case 's': stations = atoi(optarg); break;
+        case 'n': n_receivers = atoi(optarg); break;
+        case 'x': daemon = optarg; break;
+        case 'o': report = optarg; break;
+        case 'k': keep = 1; break;
+        case 'v': verbose = 1; break;
+        default:
+            usage(argv[0]);
+            return c != 'h';
+        }
+    }
+    if (seconds < 1 || warmup < 0 || (rate != 120 && rate != 240)
+        || stations < 1 || stations > 16
+        || n_receivers < 0 || n_receivers > MAX_RECEIVERS)
+    {
+        printf("Rate must be 120 or 240 Hz, with 1 to 16 stations and 0 "
+               "to %d receivers.\n", MAX_RECEIVERS);
+        return 1;
+    }
+    device_rate = rate;
+
+    // keep the terminal open ourselves, so that the master does not
+    // see a hangup whenever the daemon closes it
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)
+        || !(device = ptsname(master))
+        || (slave = open(device, O_RDWR | O_NOCTTY)) < 0)
+    {
+        perror("posix_openpt");
+        return 1;
+    }
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    for (i = 0; i < n_receivers; i++)
+        if (open_receiver(&receivers[i])) {
+            perror("socket");
+            return 1;
+        }
+    listen_port = free_port();
+
+    if ((fd = mkstemp(recording)) < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    // plhm -D -d <pty> -P -E -T -o <recording> -z -s <url> -l <port> ...
+    args = calloc(argc + 16, sizeof(char*));
+    n = 0;
+    args[n++] = (char*)daemon;
+    args[n++] = "-D";
+    args[n++] = "-d";
+    args[n++] = (char*)device;
+    args[n++] = "-P";
+    args[n++] = "-E";
+    args[n++] = "-T";
+    args[n++] = "-z";
+    sprintf(output_arg, "-o%s", recording);
+    args[n++] = output_arg;
+    if (n_receivers) {
+        sprintf(url, "osc.udp://127.0.0.1:%d", receivers[0].port);
+        args[n++] = "-s";
+        args[n++] = url;
+        sprintf(port_arg, "%d", listen_port);
+        args[n++] = "-l";
+        args[n++] = port_arg;
+    }
+    for (i = optind; i < argc; i++)
+        args[n++] = argv[i];
+
+    pthread_create(&device_thread, 0, play_device, 0);
+    pthread_create(&receive_thread, 0, receive, 0);
+
+    if (!(pid = fork())) {
+        if (!verbose) {
+            int null = open("/dev/null", O_WRONLY);
+            dup2(null, 1);
+            dup2(null, 2);
+        }
+        close(master);
+        close(slave);
+        execv(daemon, args);
+        perror(daemon);
+        _exit(127);
+    }
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+
+    // wait for streaming, then measure from the end of the warmup
+    if (verbose)
+        fprintf(stderr, "waiting for the daemon to start streaming\n");
+    while (1)
+    {
+        double t = now();
+        if (waitpid(pid, &status, WNOHANG) == pid) {
+            printf("The daemon exited early.\n");
+            quit = 1;
+            return 1;
+        }
+
+        // subscriptions are resent in case the first were lost
+        if (t - last_sub > 2 && !t0) {
+            for (i = 1; i < n_receivers; i++)
+                subscribe(receivers[i].port, listen_port);
+            last_sub = t;
+        }
+
+        if (stream_start && !t0 && t > stream_start + warmup) {
+            t0 = t;
+            proc_usage(pid, &cpu0, &rss0);
+        }
+        if (t0) {
+            if (!proc_usage(pid, &cpu, &rss) && rss > rss_max)
+                rss_max = rss;
+            if (verbose)
+                fprintf(stderr, "%5.0f s: %u frames, cpu %.1f%%, "
+                        "rss %ld kB\n", t - t0, frames_sent,
+                        (cpu - cpu0) * 100 / (t - t0 + 1e-9), rss);
+            if (t >= t0 + seconds)
+                break;
+        }
+        usleep(t0 ? 1000000 : 100000);
+    }
+    elapsed = now() - t0;
+    proc_usage(pid, &cpu, &rss);
+
+    // the daemon stops the device before it exits
+    kill(pid, SIGINT);
+    for (i = 0; i < 200 && waitpid(pid, &status, WNOHANG) != pid; i++)
+        usleep(50000);
+    if (i == 200) {
+        printf("The daemon did not stop, killing it.\n");
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+    }
+    quit = 1;
+    pthread_join(device_thread, 0);
+    pthread_join(receive_thread, 0);
+
+    file_lost = check_recording(recording, &records);
+    if (!keep)
+        unlink(recording);
+
+    out = report ? fopen(report, "w") : stdout;
+    if (!out) {
+        perror(report);
+        return 1;
+    }
+    fprintf(out, "{\n");
+    fprintf(out, "  \"seconds\": %.1f,\n", elapsed);
+    fprintf(out, "  \"rate\": %d,\n", rate);
+    fprintf(out, "  \"stations\": %d,\n", stations);
+    fprintf(out, "  \"frames_sent\": %u,\n", frames_sent);
+    fprintf(out, "  \"device_overruns\": %u,\n", overruns);
+    fprintf(out, "  \"cpu_percent\": %.2f,\n",
+            (cpu - cpu0) * 100 / elapsed);
+    fprintf(out, "  \"rss_kb\": { \"start\": %ld, \"end\": %ld, "
+            "\"max\": %ld },\n", rss0, rss, rss_max);
+    fprintf(out, "  \"recording\": { \"records\": %llu, \"lost\": %lld%s%s%s },\n",
+            records, file_lost, keep ? ", \"path\": \"" : "",
+            keep ? recording : "", keep ? "\"" : "");
+    fprintf(out, "  \"receivers\": [\n");
+    for (i = 0; i < n_receivers; i++)
+    {
+        receiver_t *r = &receivers[i];
+        unsigned long long n = 0;
+        int j;
+        for (j = 0; j <= BUCKETS; j++)
+            n += r->hist[j];
+        fprintf(out, "    { \"port\": %d, \"bundles\": %llu, "
+                "\"frames\": %llu, \"lost\": %lld, \"reordered\": %llu,\n",
+                r->port, r->bundles, r->received,
+                r->received ? r->last - r->first + 1 - (long long)r->received
+                : -1, r->reordered);
+        fprintf(out, "      \"latency_us\": { \"mean\": %.1f, \"p50\": %.0f, "
+                "\"p90\": %.0f, \"p99\": %.0f, \"p999\": %.0f, "
+                "\"max\": %.0f } }%s\n",
+                n ? r->sum / n : 0, percentile(r->hist, n, 0.5),
+                percentile(r->hist, n, 0.9), percentile(r->hist, n, 0.99),
+                percentile(r->hist, n, 0.999), r->max,
+                i < n_receivers - 1 ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    if (out != stdout)
+        fclose(out);
+
+    close(slave);
+    close(master);
+    free(args);
+    return !WIFEXITED(status) || WEXITSTATUS(status);
+}
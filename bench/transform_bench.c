@@ -0,0 +1,104 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* Compare the vectorized per-station transform against the scalar
+ * fallback for 8 and 16 stations. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include <plhm_frame.h>
+
+#define ITERATIONS 2000000
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void setup(plhm_frame_t *f, plhm_transform_t *t, int stations)
+{
+    plhm_record_t recs[PLHM_FRAME_STATIONS];
+    int i;
+
+    plhm_transform_identity(t);
+    for (i = 0; i < stations; i++) {
+        float q[4] = { cosf(0.01f * i), 0, sinf(0.01f * i), 0 };
+        float tr[3] = { 0.1f * i, -0.2f, 0.3f };
+        plhm_transform_set_quat(t, i + 1, q, tr, 1.0f);
+
+        recs[i].fields = PLHM_DATA_POSITION | PLHM_DATA_EULER;
+        recs[i].station = i + 1;
+        recs[i].error = ' ';
+        recs[i].position[0] = i;
+        recs[i].position[1] = 2.0f * i;
+        recs[i].position[2] = -1.0f;
+        recs[i].euler[0] = 10.0f * i;
+        recs[i].euler[1] = 5.0f;
+        recs[i].euler[2] = -20.0f;
+        recs[i].timestamp = 0;
+        recs[i].readtime.tv_sec = 0;
+        recs[i].readtime.tv_usec = 0;
+    }
+    plhm_frame_clear(f);
+    plhm_frame_from_records(f, recs, stations);
+}
+
+static double run(void (*fn)(plhm_frame_t*, const plhm_transform_t*),
+                  plhm_frame_t *f, const plhm_transform_t *t)
+{
+    double start = now();
+    int i;
+    for (i = 0; i < ITERATIONS; i++) {
+        fn(f, t);
+        // keep the compiler from hoisting the work out of the loop
+        __asm__ __volatile__("" : : "r"(f) : "memory");
+    }
+    return (now() - start) / ITERATIONS * 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    static plhm_frame_t a, b;
+    static plhm_transform_t t;
+    int sizes[] = { 8, 16 }, n, i;
+
+    printf("%-9s %12s %12s %8s\n", "stations", "scalar ns", "simd ns",
+           "speed-up");
+    for (n = 0; n < 2; n++)
+    {
+        double scalar, simd, err = 0;
+
+        setup(&a, &t, sizes[n]);
+        b = a;
+        plhm_frame_transform_scalar(&a, &t);
+        plhm_frame_transform(&b, &t);
+        for (i = 0; i < sizes[n]; i++)
+            err += fabsf(a.px[i] - b.px[i]) + fabsf(a.qw[i] - b.qw[i]);
+        if (err > 1e-4) {
+            printf("results differ for %d stations\n", sizes[n]);
+            return 1;
+        }
+
+        setup(&a, &t, sizes[n]);
+        scalar = run(plhm_frame_transform_scalar, &a, &t);
+        setup(&a, &t, sizes[n]);
+        simd = run(plhm_frame_transform, &a, &t);
+        printf("%-9d %12.2f %12.2f %7.2fx\n", sizes[n], scalar, simd,
+               scalar / simd);
+    }
+    return 0;
+}
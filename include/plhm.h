@@ -18,6 +18,10 @@
 
 #define plhm_rsp_max 1024
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef enum _plhm_device_type
 {
     PLHM_UNKNOWN,
@@ -46,6 +50,39 @@ enum plhm_data_fields
     // more..
 };
 
+/* How input is read from the device. */
+typedef enum _plhm_input
+{
+    PLHM_INPUT_READ,    // read() and poll()
+    PLHM_INPUT_URING,   // io_uring, where the kernel supports it
+} plhm_input;
+
+/* Counters kept as records are read, for monitoring. */
+typedef struct _plhm_stats
+{
+    unsigned long long records;         // records read
+    unsigned long long parse_errors;    // records that could not be read
+    unsigned long long resyncs;         // times input skipped to a record
+    unsigned long long station_errors;  // records with the error byte set
+    unsigned long long timeouts;        // reads that gave up waiting
+    unsigned long long decode_ns;       // time spent decoding records
+    unsigned long long bytes;           // bytes of the records read
+} plhm_stats_t;
+
+/* The station layout found by plhm_get_stations(), the byte rate the
+ * requested rate and fields need from the link, and what the link
+ * delivered when last measured by plhm_measure_link(). */
+typedef struct _plhm_link
+{
+    int stations;               // stations active
+    int station_mask;           // bit n set for station n+1
+    int rate_hz;
+    int record_bytes;           // per record, estimated for text
+    double required;            // bytes per second
+    double measured;            // bytes per second delivered, or 0
+    double records_per_s;       // records per second delivered, or 0
+} plhm_link_t;
+
 typedef struct _plhm
 {
     // input / output serial ports
@@ -61,6 +98,19 @@ typedef struct _plhm
     int fields;
     int binary;
     int stations;
+    int station_mask;
+    int detected_mask;          // stations with a sensor, of those found
+
+    plhm_input input;
+    struct _plhm_uring *uring;
+    unsigned long input_calls;  // system calls made waiting for input
+
+    plhm_stats_t stats;
+    time_t error_time;          // errors are printed once a second,
+    unsigned long errors_held;  // counting the others
+
+    int rate_hz;                // as last set, 0 for the default
+    plhm_link_t link;           // as last measured
 } plhm_t;
 
 typedef struct _plhm_record
@@ -74,6 +124,12 @@ typedef struct _plhm_record
     struct timeval readtime;
 } plhm_record_t;
 
+/* A zeroed plhm_t, for plhm_open_device().  plhm_t grows as the
+ * library does, so programs that allocate it with plhm_new() keep
+ * working with later versions; plhm_delete() closes and frees it. */
+plhm_t *plhm_new(void);
+void plhm_delete(plhm_t *p);
+
 int plhm_find_device(const char *device);
 int plhm_open_device(plhm_t *p, const char *device);
 int plhm_close_device(plhm_t *p);
@@ -91,7 +147,44 @@ int plhm_get_version(plhm_t *p);
 int plhm_set_hemisphere(plhm_t *p);
 int plhm_set_units(plhm_t *p, plhm_unit units);
 int plhm_set_rate(plhm_t *p, plhm_rate rate);
+int plhm_rate_hz(plhm_rate rate);
 int plhm_set_data_fields(plhm_t *p, int fields);
+int plhm_set_station_active(plhm_t *p, int station, int active);
+int plhm_pause_continuous(plhm_t *p);
+int plhm_resume_continuous(plhm_t *p);
 void plhm_reset(plhm_t *p);
 
+/* Choose how input is read, before or after opening the device.
+ * Returns 1, with a message, and keeps PLHM_INPUT_READ if io_uring is
+ * not available. */
+int plhm_set_input(plhm_t *p, plhm_input input);
+
+/* Wait up to ms for input, keeping what arrives for the next read.
+ * Returns 1 if there is input to read, 0 on timeout, -1 on error. */
+int plhm_wait_input(plhm_t *p, int ms);
+
+/* The current layout and required byte rate, with the delivered rate
+ * as last measured. */
+int plhm_get_link(const plhm_t *p, plhm_link_t *l);
+
+/* Stream for ms milliseconds and measure the bytes and records the
+ * link delivers.  The device must be set up but not streaming, and is
+ * left paused. */
+int plhm_measure_link(plhm_t *p, int ms, plhm_link_t *l);
+
+/* Measure each rate from the fastest down, and keep the first at
+ * which the link delivers every record, or the slowest.  *rate
+ * receives the rate chosen, l the measurement at that rate. */
+int plhm_choose_rate(plhm_t *p, int ms, plhm_rate *rate, plhm_link_t *l);
+
+/* Read the next n binary records without decoding them.  *data points
+ * to the records, laid out as selected by p->fields, in a buffer owned
+ * by p and valid until the next read. */
+int plhm_read_raw_records(plhm_t *p, int n, const char **data,
+                          struct timeval *readtime);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif // _PLHM_H_
@@ -0,0 +1,283 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* C++ interface to libplhm, header only.
+ *
+ *   plhm::Device dev("/dev/ttyUSB0");
+ *   plhm::Stream<plhm::Position | plhm::Euler> stream(dev);
+ *   for (;;) {
+ *       auto frame = stream.read();
+ *       for (auto r : frame)
+ *           use(r.station(), r.position().x, r.euler().roll);
+ *   }
+ *
+ * The device is closed and a stream stopped when they go out of scope.
+ * The field set is a template parameter, so the layout of a record is
+ * known at compile time: a frame is a view over the records as the
+ * library read them, and each accessor is a load at a fixed offset.
+ * Asking for a field the stream does not carry fails to compile.
+ *
+ * Frames are valid until the next read from the stream.  Errors are
+ * thrown as plhm::Error. */
+
+#ifndef _PLHM_HPP_
+#define _PLHM_HPP_
+
+#include <cstring>
+#include <string>
+#include <stdexcept>
+
+#include <plhm.h>
+
+namespace plhm {
+
+enum Field {
+    Position = PLHM_DATA_POSITION,
+    Euler = PLHM_DATA_EULER,
+    Timestamp = PLHM_DATA_TIMESTAMP,
+};
+
+class Error : public std::runtime_error
+{
+  public:
+    explicit Error(const std::string &what) : std::runtime_error(what) {}
+};
+
+struct Vec3 { float x, y, z; };
+struct Angles { float azimuth, elevation, roll; };
+
+/* Offsets of the fields of a binary record, as the Liberty sends them
+ * for the field set F; records always end in cr/lf. */
+template <int F>
+struct Layout
+{
+    enum {
+        fields = F | PLHM_DATA_CRLF,
+        position = 8,
+        euler = position + (F & Position ? 12 : 0),
+        timestamp = euler + (F & Euler ? 12 : 0),
+        bytes = timestamp + (F & Timestamp ? 4 : 0) + 2,
+    };
+};
+
+template <int F>
+class Record
+{
+  public:
+    typedef Layout<F> layout;
+
+    explicit Record(const char *data) : d(data) {}
+
+    int station() const { return d[2]; }
+
+    // ' ' if there is no error, as in plhm_record_t
+    int error() const { return d[4]; }
+
+    Vec3 position() const {
+        static_assert(F & Position, "the stream does not carry positions");
+        Vec3 v;
+        std::memcpy(&v, d + layout::position, sizeof(v));
+        return v;
+    }
+
+    Angles euler() const {
+        static_assert(F & Euler, "the stream does not carry orientations");
+        Angles a;
+        std::memcpy(&a, d + layout::euler, sizeof(a));
+        return a;
+    }
+
+    unsigned int timestamp() const {
+        static_assert(F & Timestamp, "the stream does not carry timestamps");
+        unsigned int t;
+        std::memcpy(&t, d + layout::timestamp, sizeof(t));
+        return t;
+    }
+
+    // for the C interfaces
+    void decode(plhm_record_t &r, const struct timeval &readtime) const {
+        std::memset(&r, 0, sizeof(r));
+        r.fields = layout::fields;
+        r.station = station();
+        r.error = error();
+        if (F & Position)
+            std::memcpy(r.position, d + layout::position, 12);
+        if (F & Euler)
+            std::memcpy(r.euler, d + layout::euler, 12);
+        if (F & Timestamp)
+            std::memcpy(&r.timestamp, d + layout::timestamp, 4);
+        r.readtime = readtime;
+    }
+
+  private:
+    const char *d;
+};
+
+template <int F>
+class Frame
+{
+  public:
+    typedef Layout<F> layout;
+
+    class iterator
+    {
+      public:
+        explicit iterator(const char *data) : d(data) {}
+        Record<F> operator*() const { return Record<F>(d); }
+        iterator &operator++() { d += layout::bytes; return *this; }
+        bool operator!=(const iterator &o) const { return d != o.d; }
+        bool operator==(const iterator &o) const { return d == o.d; }
+      private:
+        const char *d;
+    };
+
+    Frame(const char *data, int n, const struct timeval &readtime)
+        : d(data), n(n), t(readtime) {}
+
+    int size() const { return n; }
+    Record<F> operator[](int i) const { return Record<F>(d + i * layout::bytes); }
+    iterator begin() const { return iterator(d); }
+    iterator end() const { return iterator(d + n * layout::bytes); }
+
+    // when the last record of the frame was read
+    const struct timeval &readtime() const { return t; }
+
+  private:
+    const char *d;
+    int n;
+    struct timeval t;
+};
+
+/* An open device; closed on destruction. */
+class Device
+{
+  public:
+    explicit Device(const std::string &path,
+                    plhm_input input = PLHM_INPUT_READ) {
+        std::memset(&p, 0, sizeof(p));
+        if (input != PLHM_INPUT_READ)
+            plhm_set_input(&p, input);
+        if (plhm_find_device(path.c_str())
+            || plhm_open_device(&p, path.c_str()))
+        {
+            plhm_set_input(&p, PLHM_INPUT_READ);
+            throw Error("could not open " + path);
+        }
+    }
+
+    Device(Device &&o) {
+        p = o.p;
+        std::memset(&o.p, 0, sizeof(o.p));
+    }
+
+    ~Device() {
+        plhm_close_device(&p);
+        plhm_set_input(&p, PLHM_INPUT_READ);
+    }
+
+    Device(const Device &) = delete;
+    Device &operator=(const Device &) = delete;
+
+    int stations() const { return p.stations; }
+    int station_mask() const { return p.station_mask; }
+
+    void set_station_active(int station, bool active) {
+        if (plhm_pause_continuous(&p)
+            || plhm_set_station_active(&p, station - 1, active)
+            || plhm_resume_continuous(&p))
+            throw Error("could not set station " + std::to_string(station));
+    }
+
+    void set_rate(plhm_rate rate) {
+        if (plhm_pause_continuous(&p) || plhm_set_rate(&p, rate)
+            || plhm_resume_continuous(&p))
+            throw Error("could not set the rate");
+    }
+
+    // for calls into the C library
+    plhm_t *get() { return &p; }
+
+  private:
+    plhm_t p;
+};
+
+/* Marks a stream over a device that is already streaming its fields
+ * in binary, so that the stream neither starts nor stops it. */
+struct Streaming {};
+constexpr Streaming streaming = Streaming();
+
+/* Continuous binary output of the fields F; stopped on destruction. */
+template <int F>
+class Stream
+{
+  public:
+    typedef Layout<F> layout;
+    typedef Frame<F> frame_type;
+    typedef Record<F> record_type;
+
+    static_assert((F & ~(Position | Euler | Timestamp)) == 0,
+                  "unknown fields");
+
+    explicit Stream(Device &dev, plhm_rate rate = PLHM_RATE_240)
+        : p(dev.get()), owner(true) {
+        plhm_data_request(p);
+        while (!plhm_read_until_timeout(p, 500)) {}
+        if (plhm_text_mode(p) || plhm_get_version(p) || plhm_read_bits(p)
+            || plhm_get_stations(p) || plhm_set_hemisphere(p)
+            || plhm_set_units(p, PLHM_UNITS_METRIC) || plhm_set_rate(p, rate)
+            || plhm_set_data_fields(p, layout::fields) || plhm_binary_mode(p)
+            || plhm_data_request_continuous(p))
+            throw Error("could not start the device");
+        check();
+    }
+
+    Stream(Device &dev, Streaming) : p(dev.get()), owner(false) {
+        if (!p->binary || p->fields != layout::fields)
+            throw Error("the device is not streaming these fields");
+        check();
+    }
+
+    ~Stream() {
+        if (owner && p->device_open) {
+            plhm_data_request(p);
+            plhm_read_until_timeout(p, 500);
+            plhm_text_mode(p);
+        }
+    }
+
+    Stream(const Stream &) = delete;
+    Stream &operator=(const Stream &) = delete;
+
+    int stations() const { return p->stations; }
+
+    // the next frame, valid until the next read
+    Frame<F> read() {
+        const char *data;
+        struct timeval t;
+        if (plhm_read_raw_records(p, p->stations, &data, &t))
+            throw Error("could not read a frame");
+        return Frame<F>(data, p->stations, t);
+    }
+
+  private:
+    void check() {
+        if (p->stations < 1 || p->stations * layout::bytes >= plhm_rsp_max)
+            throw Error("unsupported number of stations");
+    }
+
+    plhm_t *p;
+    bool owner;
+};
+
+} // namespace plhm
+
+#endif // _PLHM_HPP_
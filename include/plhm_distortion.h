@@ -0,0 +1,72 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _PLHM_DISTORTION_H_
+#define _PLHM_DISTORTION_H_
+
+#include <plhm.h>
+#include <plhm_frame.h>
+
+/* Compensation for magnetic field distortion, e.g. from metal in the
+ * tracking volume.  A regular grid over the volume maps measured
+ * positions to corrections: an offset to add to the position, and a
+ * rotation to apply to the orientation.  Corrections are
+ * interpolated trilinearly between grid nodes.
+ *
+ * Nodes are stored in 4x4x4 bricks so that the eight corners of an
+ * interpolation cell are usually in the same 2 KB block, and each
+ * node is padded to eight floats for aligned vector loads. */
+
+#define PLHM_GRID_MAGIC "PLHMGRID"
+#define PLHM_GRID_VERSION 1
+
+/* One grid node, as stored in a grid file. */
+typedef struct _plhm_grid_node
+{
+    float offset[3];    // true minus measured position
+    float rotation[4];  // correction quaternion w, x, y, z
+} plhm_grid_node_t;
+
+typedef struct _plhm_grid
+{
+    int dims[3];        // nodes along x, y, z, at least 2 each
+    float min[3];       // position of node (0,0,0)
+    float max[3];       // position of the last node
+    float scale[3];     // cells per unit length
+    int bricks[3];      // bricks along x, y, z
+    float *nodes;       // 8 floats per node, in bricks
+} plhm_grid_t;
+
+/* Build a grid from nodes in x-fastest order.  Returns 0 on success. */
+int plhm_grid_init(plhm_grid_t *g, const int dims[3], const float min[3],
+                   const float max[3], const plhm_grid_node_t *nodes);
+void plhm_grid_free(plhm_grid_t *g);
+
+/* Grid files: an 8-byte magic, then version, dims[3], min[3], max[3]
+ * and the nodes in x-fastest order, all little-endian 32-bit. */
+int plhm_grid_load(plhm_grid_t *g, const char *path);
+int plhm_grid_save(const char *path, const int dims[3], const float min[3],
+                   const float max[3], const plhm_grid_node_t *nodes);
+
+/* Interpolated correction at a measured position.  Positions outside
+ * the grid use the nearest boundary cell. */
+void plhm_grid_lookup(const plhm_grid_t *g, const float position[3],
+                      plhm_grid_node_t *out);
+
+/* Correct a decoded record in place. */
+void plhm_grid_apply_record(const plhm_grid_t *g, plhm_record_t *r);
+
+/* Correct all stations of a frame; the quaternions are corrected and
+ * the Euler angles recomputed. */
+void plhm_grid_apply_frame(const plhm_grid_t *g, plhm_frame_t *f);
+
+#endif // _PLHM_DISTORTION_H_
@@ -0,0 +1,100 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _PLHM_FEATURES_H_
+#define _PLHM_FEATURES_H_
+
+#include <stdint.h>
+#include <plhm_frame.h>
+
+/* Gesture features computed from consecutive frames: derivatives of
+ * position by finite differences, angular velocity from successive
+ * orientations, and the distance between every pair of stations.
+ * Each is computed once per frame for all stations together. */
+
+#define PLHM_FEATURE_VELOCITY         0x01
+#define PLHM_FEATURE_ACCELERATION     0x02
+#define PLHM_FEATURE_JERK             0x04
+#define PLHM_FEATURE_SPEED            0x08
+#define PLHM_FEATURE_ANGULAR_VELOCITY 0x10
+#define PLHM_FEATURE_DISTANCE         0x20
+
+#define PLHM_FEATURE_PAIRS \
+    (PLHM_FRAME_STATIONS * (PLHM_FRAME_STATIONS - 1) / 2)
+
+/* Index into distance[] of the pair of 0-based stations a < b. */
+#define PLHM_FEATURE_PAIR(a,b) \
+    ((a) * (2 * PLHM_FRAME_STATIONS - (a) - 1) / 2 + (b) - (a) - 1)
+
+/* Features of one frame, indexed by 0-based station.  Derivatives
+ * are per second, angular velocity is in radians per second about
+ * the source axes.  Read times jitter with serial and USB latency,
+ * so derivatives use each station's average sample interval rather
+ * than the time between two reads.  A derivative is only valid once
+ * enough consecutive samples of the station have been seen: see the
+ * masks. */
+typedef struct _plhm_feature_values
+{
+    int features;               // PLHM_FEATURE_* bits computed
+    uint32_t station_mask;      // stations in the frame
+    uint32_t velocity_mask;     // also speed and angular velocity
+    uint32_t acceleration_mask;
+    uint32_t jerk_mask;
+
+    float velocity[PLHM_FRAME_STATIONS][3];
+    float acceleration[PLHM_FRAME_STATIONS][3];
+    float jerk[PLHM_FRAME_STATIONS][3];
+    float speed[PLHM_FRAME_STATIONS];
+    float angular_velocity[PLHM_FRAME_STATIONS][3];
+    float distance[PLHM_FEATURE_PAIRS];   // both stations present
+} plhm_feature_values_t;
+
+/* History needed for the derivatives. */
+typedef struct _plhm_features
+{
+    int features;
+    int fields;
+    int samples[PLHM_FRAME_STATIONS];   // consecutive, up to 3
+    double last[PLHM_FRAME_STATIONS];   // readtime, ms
+    double period[PLHM_FRAME_STATIONS]; // smoothed sample interval, ms
+
+    float px[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float py[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float pz[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float vx[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float vy[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float vz[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float ax[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float ay[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float az[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float qw[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float qx[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float qy[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float qz[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+} plhm_features_t;
+
+void plhm_features_init(plhm_features_t *fe, int features);
+void plhm_features_reset(plhm_features_t *fe);
+
+/* Feature bit for one of the letters v(elocity), a(cceleration),
+ * j(erk), s(peed), w (angular velocity) and d(istance), or 0. */
+int plhm_features_letter(char c);
+
+/* Feature bits for a string of letters, or -1 if one is unknown. */
+int plhm_features_parse(const char *letters);
+
+/* Update the history with a frame and compute its features.  Only
+ * features whose data fields are present in the frame are computed. */
+void plhm_features_compute(plhm_features_t *fe, const plhm_frame_t *fr,
+                           plhm_feature_values_t *out);
+
+#endif // _PLHM_FEATURES_H_
@@ -0,0 +1,88 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _PLHM_FILTER_H_
+#define _PLHM_FILTER_H_
+
+#include <stdint.h>
+#include <plhm_frame.h>
+
+/* Smoothing and forward prediction of station poses.  Each station
+ * keeps its own state; all stations of a frame are filtered together.
+ * Position and the orientation quaternion are filtered per component,
+ * the quaternion is renormalized, and the Euler angles recomputed.
+ *
+ * The one-euro filter is a low-pass whose cutoff rises with speed,
+ * trading jitter at rest for lag in motion.  The Kalman filter
+ * assumes constant velocity per component.  Either can extrapolate
+ * its output forward by a lead time to hide transport latency. */
+
+typedef enum {
+    PLHM_FILTER_NONE,
+    PLHM_FILTER_ONE_EURO,
+    PLHM_FILTER_KALMAN,
+} plhm_filter_type;
+
+// px, py, pz, qw, qx, qy, qz
+#define PLHM_FILTER_CHANNELS 7
+
+typedef struct _plhm_filter
+{
+    plhm_filter_type type;
+    float lead;             // prediction, seconds
+
+    // one-euro: cutoffs in Hz, beta in 1/(units/s)
+    float min_cutoff;
+    float beta;
+    float d_cutoff;
+
+    // Kalman: acceleration noise density and measurement variance
+    float process_noise;
+    float measurement_noise;
+
+    int fields;             // fields filtered so far
+    uint32_t primed;        // bit n set once station n+1 has state
+    double last[PLHM_FRAME_STATIONS];   // readtime of last sample, ms
+
+    // filtered value and its rate of change per second
+    float x[PLHM_FILTER_CHANNELS][PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float v[PLHM_FILTER_CHANNELS][PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+
+    // Kalman covariance of (x, v)
+    float p00[PLHM_FILTER_CHANNELS][PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float p01[PLHM_FILTER_CHANNELS][PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float p11[PLHM_FILTER_CHANNELS][PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+} plhm_filter_t;
+
+void plhm_filter_init_one_euro(plhm_filter_t *f, float min_cutoff,
+                               float beta, float d_cutoff);
+void plhm_filter_init_kalman(plhm_filter_t *f, float process_noise,
+                             float measurement_noise);
+
+/* Extrapolate output by lead milliseconds (0 for none). */
+void plhm_filter_set_prediction(plhm_filter_t *f, float lead);
+
+/* Forget all station state; the next sample of each station passes
+ * through unchanged. */
+void plhm_filter_reset(plhm_filter_t *f);
+
+/* Parse "euro[:min_cutoff[,beta[,d_cutoff]]]" or
+ * "kalman[:process_noise[,measurement_noise]]".  Returns 0 on
+ * success. */
+int plhm_filter_parse(plhm_filter_t *f, const char *spec);
+
+/* Filter a frame in place, using each station's readtime as its
+ * sample time. */
+void plhm_filter_apply(plhm_filter_t *f, plhm_frame_t *fr);
+void plhm_filter_apply_scalar(plhm_filter_t *f, plhm_frame_t *fr);
+
+#endif // _PLHM_FILTER_H_
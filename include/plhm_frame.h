@@ -0,0 +1,95 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _PLHM_FRAME_H_
+#define _PLHM_FRAME_H_
+
+#include <stdint.h>
+#include <plhm.h>
+
+/* A frame holds one sample of every station, stored per component so
+ * that processing stages can work on all stations at once.  Station
+ * n is at index n-1 of each array.  Arrays are padded to a multiple
+ * of the SIMD width and aligned for aligned loads. */
+
+#define PLHM_FRAME_STATIONS 16
+#define PLHM_FRAME_ALIGN __attribute__((aligned(32)))
+
+typedef struct _plhm_frame
+{
+    int fields;
+    uint32_t station_mask;      // bit n set if station n+1 is present
+    int lanes;                  // stations to process, rounded up to 4
+
+    float px[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float py[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float pz[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+
+    // orientation as received, in degrees
+    float azimuth[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float elevation[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float roll[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+
+    // the same orientation as a unit quaternion
+    float qw[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float qx[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float qy[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float qz[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+
+    uint32_t timestamp[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    double readtime[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;   // ms
+    int error[PLHM_FRAME_STATIONS];
+} plhm_frame_t;
+
+/* A per-station rigid transform with uniform scale, such as a
+ * boresight rotation and a translation into room coordinates:
+ *   position' = scale * R * position + translation
+ *   orientation' = R * orientation
+ * Stored per component like the frame.  Stations without a transform
+ * set keep the identity. */
+typedef struct _plhm_transform
+{
+    // rows of scale * R, and the translation
+    float m[3][4][PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    // R as a quaternion
+    float qw[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float qx[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float qy[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float qz[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+} plhm_transform_t;
+
+/* Conversions between Liberty Euler angles (azimuth, elevation, roll
+ * in degrees) and unit quaternions (w, x, y, z). */
+void plhm_euler_to_quat(const float euler[3], float q[4]);
+void plhm_quat_to_euler(const float q[4], float euler[3]);
+
+void plhm_frame_clear(plhm_frame_t *f);
+int plhm_frame_from_records(plhm_frame_t *f, const plhm_record_t *recs, int n);
+int plhm_frame_to_records(const plhm_frame_t *f, plhm_record_t *recs);
+
+/* Recompute azimuth, elevation and roll from the quaternions, after
+ * a stage has changed the orientation. */
+void plhm_frame_update_euler(plhm_frame_t *f);
+
+void plhm_transform_identity(plhm_transform_t *t);
+int plhm_transform_set_quat(plhm_transform_t *t, int station,
+                            const float q[4], const float translation[3],
+                            float scale);
+/* m is row-major; the upper 3x3 must be a rotation times a uniform
+ * scale */
+int plhm_transform_set_matrix(plhm_transform_t *t, int station,
+                              const float m[16]);
+
+void plhm_frame_transform(plhm_frame_t *f, const plhm_transform_t *t);
+void plhm_frame_transform_scalar(plhm_frame_t *f, const plhm_transform_t *t);
+
+#endif // _PLHM_FRAME_H_
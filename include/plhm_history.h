@@ -0,0 +1,106 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _PLHM_HISTORY_H_
+#define _PLHM_HISTORY_H_
+
+#include <stdint.h>
+#include <plhm.h>
+
+/* The recent past of every station, in a fixed-capacity ring per
+ * station ordered by read time, so that a window such as "the last 2
+ * seconds of station 3" can be found by binary search and copied out.
+ * Read time is the host clock every output is stamped with, and is
+ * shared by all trackers on the host; the tracker's own timestamp
+ * counts from when it was powered on and wraps, so it is kept in each
+ * sample but not searched.
+ *
+ * The history lives either in private memory or in a POSIX shared
+ * memory segment that other processes open read-only.  There is one
+ * writer; readers take no lock and never delay it.  Each station
+ * counts the samples ever written to it, and sample i is kept in slot
+ * i % capacity until sample i + capacity replaces it.  A reader copies
+ * what it wants and then checks the count again, discarding samples
+ * the writer may have replaced meanwhile. */
+
+#define PLHM_HISTORY_DEFAULT_NAME "/plhm-history"
+#define PLHM_HISTORY_MAGIC 0x48484c50   // "PLHH"
+#define PLHM_HISTORY_VERSION 1
+#define PLHM_HISTORY_STATIONS 16
+
+typedef struct _plhm_history_sample
+{
+    double time;                // host read time, ms
+    float position[3];
+    float euler[3];
+    uint32_t timestamp;
+    int32_t error;
+} plhm_history_sample_t;
+
+typedef struct _plhm_history_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;          // samples per station, a power of two
+    int32_t fields;
+    volatile uint64_t written[PLHM_HISTORY_STATIONS];
+    // followed by the samples, station n at (n-1) * capacity
+} plhm_history_header_t;
+
+typedef struct _plhm_history
+{
+    int fd;
+    int writer;
+    char name[256];
+    size_t size;
+    plhm_history_header_t *header;
+    plhm_history_sample_t *samples;
+} plhm_history_t;
+
+/* writer: capacity is rounded up to a power of two; with a null name
+ * the history is private to the process */
+int plhm_history_create(plhm_history_t *h, const char *name, int capacity);
+
+/* Append every record to the history of its station.  Read times that
+ * go backwards, as when the clock is stepped, are held at the last. */
+void plhm_history_add(plhm_history_t *h, const plhm_record_t *recs, int n);
+
+/* reader */
+int plhm_history_open(plhm_history_t *h, const char *name);
+
+/* The number of samples kept for a station, and the times of the
+ * oldest and newest of them.  Returns 0 if there are none. */
+int plhm_history_bounds(const plhm_history_t *h, int station,
+                        double *oldest, double *newest);
+
+/* The index of the first sample of a station read at or after time,
+ * or of the next sample to be written if there is none yet. */
+uint64_t plhm_history_seek(const plhm_history_t *h, int station,
+                           double time);
+
+/* Copy up to max samples of a station from *index on, advancing
+ * *index past them.  If the samples at *index have already been
+ * replaced, it starts from the oldest kept instead.  Returns the
+ * number copied, or -1 for an unknown station. */
+int plhm_history_read(const plhm_history_t *h, int station,
+                      uint64_t *index, plhm_history_sample_t *out, int max);
+
+/* Up to max samples of a station read between from and to, inclusive,
+ * oldest first.  Returns the number copied, or -1. */
+int plhm_history_range(const plhm_history_t *h, int station,
+                       double from, double to,
+                       plhm_history_sample_t *out, int max);
+
+/* closes either end; the writer also removes a shared segment */
+int plhm_history_close(plhm_history_t *h);
+
+#endif // _PLHM_HISTORY_H_
@@ -0,0 +1,135 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _PLHM_MERGE_H_
+#define _PLHM_MERGE_H_
+
+#include <stdint.h>
+#include <sys/time.h>
+#include <plhm.h>
+#include <plhm_frame.h>
+
+/* Merge the records of several trackers, or of a tracker and a
+ * replayed recording, into one stream in time order.
+ *
+ * Each source is given its own range of output stations.  Records
+ * are placed on the host clock: when they carry a device timestamp,
+ * at the device time plus an offset tracked as the smallest
+ * difference between read time and device time seen recently, which
+ * removes the jitter of serial transfer and follows the drift between
+ * the clocks; otherwise at their read time.  A record is released
+ * once every source has reached its time, or once it is older than
+ * the reorder window, so a stalled source delays the others by at
+ * most the window.  Records arriving after that are dropped as late.
+ *
+ * Optionally the output is resampled to a common frame clock: at
+ * each tick, one record per station holding its latest state. */
+
+#define PLHM_MERGE_MAX_SOURCES 8
+#define PLHM_MERGE_QUEUE 1024
+
+typedef struct _plhm_merge_stats
+{
+    unsigned long long records;     // accepted
+    unsigned long long late;        // dropped, older than the output
+    unsigned long long overflow;    // dropped, queue full
+    double latency_mean, latency_max;   // ms from device time to read
+    double delay_mean, delay_max;       // ms from record time to release,
+                                        // if now is given
+    double offset;                  // ms from device clock to host clock
+    double skew;                    // device clock drift, ppm
+} plhm_merge_stats_t;
+
+typedef struct _plhm_merge_source
+{
+    int station_offset;
+    int64_t time_offset;            // us, added to read times
+    int ended;
+
+    // queued records and their times on the host clock, in order
+    plhm_record_t queue[PLHM_MERGE_QUEUE];
+    int64_t times[PLHM_MERGE_QUEUE];
+    int head, count;
+    int64_t latest;                 // newest time pushed
+
+    // device clock, and its offset to the host clock as the smallest
+    // difference over this window and the one before
+    int timestamp_us;               // length of a timestamp tick
+    uint32_t last_timestamp;
+    int64_t ticks;                  // counter, extended past wrapping
+    int synced;
+    int64_t clock, window_min, previous_min, window_start;
+    int64_t first_clock, first_time, last_time;
+
+    unsigned long long records, late, overflow;
+    double latency_sum, latency_max;
+    unsigned long long latency_n;
+    double delay_sum, delay_max;
+    unsigned long long delay_n;
+} plhm_merge_source_t;
+
+typedef struct _plhm_merge
+{
+    plhm_merge_source_t sources[PLHM_MERGE_MAX_SOURCES];
+    int n_sources;
+    int64_t window;                 // us
+    int64_t released;               // time of the newest output
+    int started;
+
+    // frame clock, if period is not zero
+    int64_t period;                 // us
+    int64_t next_tick;
+    int64_t newest;                 // newest time pushed to any source
+    plhm_record_t held[PLHM_FRAME_STATIONS];
+    int64_t held_time[PLHM_FRAME_STATIONS];
+    uint32_t held_mask;
+} plhm_merge_t;
+
+/* Wait at most window_ms for a late source before releasing records. */
+void plhm_merge_init(plhm_merge_t *m, float window_ms);
+
+/* Add a source whose station n is output as station n plus
+ * station_offset.  Returns the source index, or -1 if there are too
+ * many. */
+int plhm_merge_add_source(plhm_merge_t *m, int station_offset);
+
+/* Shift a source's read times, e.g. for a recording replayed from
+ * another session. */
+void plhm_merge_set_time_offset(plhm_merge_t *m, int source, float ms);
+
+/* Microseconds per device timestamp tick; 1000 by default. */
+void plhm_merge_set_timestamp_unit(plhm_merge_t *m, int source, int us);
+
+/* Output one frame per tick of rate_hz rather than each record as it
+ * comes; 0 to turn off. */
+void plhm_merge_set_clock(plhm_merge_t *m, float rate_hz);
+
+/* Add records from a source, in the order they were read.  Returns
+ * the number accepted. */
+int plhm_merge_push(plhm_merge_t *m, int source,
+                    const plhm_record_t *recs, int n);
+
+/* A source that has ended no longer holds back the others. */
+void plhm_merge_end_source(plhm_merge_t *m, int source);
+
+/* Take released records, in time order.  now is the current host time,
+ * or null to release only what every source has reached, as when
+ * merging recordings.  Without a clock, returns up to max records;
+ * with a clock, returns the records of one tick, with their read time
+ * set to the tick, and should be called until it returns 0. */
+int plhm_merge_pop(plhm_merge_t *m, plhm_record_t *out, int max,
+                   const struct timeval *now);
+
+void plhm_merge_get_stats(const plhm_merge_t *m, int source,
+                          plhm_merge_stats_t *st);
+
+#endif // _PLHM_MERGE_H_
@@ -0,0 +1,84 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _PLHM_PLUGIN_H_
+#define _PLHM_PLUGIN_H_
+
+#include <stdint.h>
+#include <plhm.h>
+#include <plhm_features.h>
+#include <plhm_triggers.h>
+
+/* Output plugins for the plhm daemon, loaded with plhm -x <path>.
+ *
+ * A plugin is a shared object exporting plhm_plugin_describe(), which
+ * returns a description of the plugin.  Each plugin runs as a sink of
+ * its own: write() is called on a thread of its own, once per frame,
+ * in order, with a view of the frame.  A plugin that blocks sees the
+ * frame in place in the shared frame ring; one that drops or coalesces
+ * frames sees a copy of its own, and cannot delay acquisition however
+ * long write() takes.  Either way the view and everything it points to
+ * is only valid until write() returns. */
+
+/* plhm refuses plugins built against another version.  It changes
+ * whenever the layout of any structure a plugin sees does:
+ *
+ *   plhm_plugin_t, plhm_plugin_frame_t and plhm_plugin_policy, here
+ *   plhm_record_t, in plhm.h
+ *   plhm_feature_values_t, in plhm_features.h
+ *   plhm_trigger_event_t and plhm_trigger_type, in plhm_triggers.h */
+#define PLHM_PLUGIN_VERSION 1
+
+typedef enum {
+    PLHM_PLUGIN_BLOCK,          // delay acquisition rather than lose frames
+    PLHM_PLUGIN_DROP_OLDEST,    // skip frames when behind
+    PLHM_PLUGIN_COALESCE,       // merge them into the latest per station
+} plhm_plugin_policy;
+
+/* One frame: a record for each station present, and the gesture
+ * features and trigger events computed from it, if enabled. */
+typedef struct _plhm_plugin_frame
+{
+    int n;
+    const plhm_record_t *recs;
+    uint32_t station_mask;      // bit n set if station n+1 is present
+    int64_t tick;               // index of a resampled frame, else -1
+    const plhm_feature_values_t *features;
+    int n_events;
+    const plhm_trigger_event_t *events;
+} plhm_plugin_frame_t;
+
+typedef struct _plhm_plugin
+{
+    int version;                // PLHM_PLUGIN_VERSION
+    const char *name;           // for -b <name>:<policy> and statistics
+
+    // Data the plugin needs: PLHM_DATA_* fields to request from the
+    // tracker in addition to those asked for on the command line, and
+    // the stations whose frames it is given, 0 for all.
+    int fields;
+    uint32_t station_mask;
+    plhm_plugin_policy policy;
+
+    // Called with the text after the path in -x <path>:<args>, or an
+    // empty string.  Returns the plugin's state, or null on failure.
+    void *(*open)(const char *args);
+    void (*write)(void *state, const plhm_plugin_frame_t *frame);
+    void (*close)(void *state);
+} plhm_plugin_t;
+
+typedef const plhm_plugin_t *plhm_plugin_describe_fn(void);
+
+/* the entry point every plugin exports */
+const plhm_plugin_t *plhm_plugin_describe(void);
+
+#endif // _PLHM_PLUGIN_H_
@@ -0,0 +1,120 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _PLHM_RECORDING_H_
+#define _PLHM_RECORDING_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <plhm.h>
+
+/* Compressed recordings.  Frames are grouped into blocks that can be
+ * decoded independently of each other.  Within a block, read times
+ * and device timestamps are stored as the difference between
+ * successive deltas, and each float as the XOR with the previous
+ * value of the same station and channel, keeping only the bits that
+ * changed.  Slowly moving stations compress to a few bits per value.
+ *
+ * A file is an 8-byte magic and a 32-bit version, followed by blocks.
+ * Each block has a header (see plhm_rec_block_t) and a bit stream
+ * padded to a multiple of 8 bytes.  All header fields are
+ * little-endian. */
+
+#define PLHM_REC_MAGIC "PLHMREC"
+#define PLHM_REC_VERSION 1
+#define PLHM_REC_BLOCK_MAGIC 0x42484c50     // "PLHB"
+#define PLHM_REC_HEADER_BYTES 12
+#define PLHM_REC_BLOCK_HEADER_BYTES 20
+
+// frames per block at most, which bounds the records a block decodes to
+#define PLHM_REC_BLOCK_FRAMES 256
+#define PLHM_REC_BLOCK_BYTES 65536
+#define PLHM_REC_MAX_STATIONS 16
+
+typedef struct _plhm_rec_block
+{
+    uint32_t payload;       // bytes of bit stream
+    uint32_t frames;
+    uint32_t station_mask;  // bit n set for station n+1
+    uint32_t fields;
+    const uint8_t *data;
+} plhm_rec_block_t;
+
+/* Prediction state for one station. */
+typedef struct _plhm_rec_station
+{
+    uint32_t value[6];          // previous floats, as bits
+    unsigned char lead[6];      // leading and trailing zeros of the
+    unsigned char trail[6];     // last stored XOR, lead 255 if none
+    int64_t time, time_delta;   // read time in microseconds
+    uint32_t timestamp;
+    int64_t timestamp_delta;
+    int error;
+} plhm_rec_station_t;
+
+typedef struct _plhm_rec_writer
+{
+    FILE *file;
+    uint32_t station_mask;
+    int fields;
+    int frames;
+
+    // bit stream of the current block
+    uint8_t *buffer;
+    size_t bytes;
+    uint64_t acc;
+    int bits;
+
+    plhm_rec_station_t station[PLHM_REC_MAX_STATIONS];
+
+    // totals, for reporting the compression ratio
+    unsigned long long records, written;
+} plhm_rec_writer_t;
+
+/* Start a recording on an open file.  Returns 0 on success. */
+int plhm_rec_writer_open(plhm_rec_writer_t *w, FILE *file);
+
+/* Append one frame.  A block is written out when it is full, or when
+ * the stations or fields change. */
+int plhm_rec_write(plhm_rec_writer_t *w, const plhm_record_t *recs, int n);
+
+/* Write out the last block; the file is left open. */
+int plhm_rec_writer_close(plhm_rec_writer_t *w);
+
+typedef struct _plhm_rec_reader
+{
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+    int fd;             // if the reader mapped the file itself
+} plhm_rec_reader_t;
+
+/* Read a recording from memory, or map a file.  Return 0 on
+ * success. */
+int plhm_rec_reader_init(plhm_rec_reader_t *r, const void *data, size_t size);
+int plhm_rec_reader_open(plhm_rec_reader_t *r, const char *path);
+void plhm_rec_reader_close(plhm_rec_reader_t *r);
+
+/* Locate the next block.  Returns 0 on success, 1 at the end, and -1
+ * if the file is damaged. */
+int plhm_rec_next_block(plhm_rec_reader_t *r, plhm_rec_block_t *b);
+
+/* Decode a block into records, frame by frame in station order.
+ * recs must have room for frames times stations records, at most
+ * PLHM_REC_BLOCK_FRAMES * PLHM_REC_MAX_STATIONS.  Returns the number
+ * of records, or -1 if the block is damaged. */
+int plhm_rec_decode_block(const plhm_rec_block_t *b, plhm_record_t *recs);
+
+/* Whether a file starts with the recording magic. */
+int plhm_rec_is_recording(const void *data, size_t size);
+
+#endif // _PLHM_RECORDING_H_
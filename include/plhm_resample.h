@@ -0,0 +1,109 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _PLHM_RESAMPLE_H_
+#define _PLHM_RESAMPLE_H_
+
+#include <stdint.h>
+#include <sys/time.h>
+#include <plhm.h>
+#include <plhm_frame.h>
+
+/* Resampling of the record stream to a fixed output rate, such as
+ * 1 kHz or one frame per 64 samples at 48 kHz.
+ *
+ * The rate is a ratio num/den Hz, and tick k falls at
+ * start + k * den / num seconds, rounded to the microsecond but
+ * computed from k so that it never drifts.  Input frames are placed
+ * on a clock that follows their read times through a phase-locked
+ * loop, which removes most of the jitter of serial transfer.
+ *
+ * Positions are interpolated linearly or by cubic Hermite splines
+ * through the neighbouring samples; orientations by spherical linear
+ * interpolation of their quaternions.  A tick is output once every
+ * station has the samples after it that the interpolation needs, or
+ * at the latest once the host clock is past it by the latency bound,
+ * in which case stations without newer samples hold their last pose.
+ * Ticks fall due even while no input arrives, so the caller should
+ * wait for input no longer than plhm_resample_timeout().  A station
+ * that stops while others go on is left out once its last sample is
+ * older than the latest input by the latency bound. */
+
+typedef enum {
+    PLHM_RESAMPLE_LINEAR,
+    PLHM_RESAMPLE_HERMITE,
+} plhm_resample_method;
+
+// samples kept per station, newest last
+#define PLHM_RESAMPLE_HISTORY 8
+
+typedef struct _plhm_resample_station
+{
+    int count;
+    double time[PLHM_RESAMPLE_HISTORY];     // us from start
+    plhm_record_t rec[PLHM_RESAMPLE_HISTORY];
+    float q[PLHM_RESAMPLE_HISTORY][4];      // in one hemisphere
+} plhm_resample_station_t;
+
+typedef struct _plhm_resample
+{
+    plhm_resample_method method;
+    int64_t num, den;           // rate in Hz, as a ratio
+    int64_t latency;            // us
+
+    int started;
+    struct timeval start;       // time of tick 0
+    int64_t tick;               // next tick to output
+
+    // input clock: times of the first and last frame since it was
+    // last restarted, and the frame period, us from start
+    int frames;
+    double first, clock, period;
+
+    plhm_resample_station_t station[PLHM_FRAME_STATIONS];
+
+    unsigned long long ticks;   // output
+    unsigned long long forced;  // output by the latency bound
+    unsigned long long skipped; // not output, across gaps in the input
+} plhm_resample_t;
+
+/* Output num/den frames per second, waiting at most latency_ms for
+ * input.  Returns 0 on success. */
+int plhm_resample_init(plhm_resample_t *r, int num, int den,
+                       plhm_resample_method method, float latency_ms);
+
+/* Parse "<rate>[/<div>][:linear|cubic[,latency_ms]]", for a rate of
+ * rate/div Hz; cubic by default, with a 20 ms latency bound.  Returns
+ * 0 on success. */
+int plhm_resample_parse(plhm_resample_t *r, const char *spec);
+
+/* Forget all input; ticks start again from the next frame. */
+void plhm_resample_reset(plhm_resample_t *r);
+
+/* Add the records of one frame. */
+void plhm_resample_push(plhm_resample_t *r, const plhm_record_t *recs, int n);
+
+/* Take the records of the next tick, if it is ready, with their read
+ * times set to the tick time.  out must have room for
+ * PLHM_FRAME_STATIONS records; tick, if not null, receives the tick
+ * index.  now is the current host time, or null to wait for input
+ * only.  Returns the number of records, 0 if no tick is ready; call
+ * until it returns 0. */
+int plhm_resample_pull(plhm_resample_t *r, plhm_record_t *out,
+                       const struct timeval *now, int64_t *tick);
+
+/* Milliseconds from now until the next tick is output by the latency
+ * bound, 0 if it is due, or -1 if there is no input to output. */
+int plhm_resample_timeout(const plhm_resample_t *r,
+                          const struct timeval *now);
+
+#endif // _PLHM_RESAMPLE_H_
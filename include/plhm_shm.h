@@ -0,0 +1,81 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _PLHM_SHM_H_
+#define _PLHM_SHM_H_
+
+#include <stdint.h>
+#include <plhm.h>
+
+/* Latest-pose publishing through POSIX shared memory.  The writer
+ * overwrites a single frame in place; readers never block it.  The
+ * frame is protected by a sequence lock: seq is odd while the writer
+ * is updating, and a reader's view is consistent if seq was even and
+ * unchanged across the read. */
+
+#define PLHM_SHM_DEFAULT_NAME "/plhm"
+#define PLHM_SHM_MAGIC 0x4d484c50   // "PLHM"
+#define PLHM_SHM_VERSION 1
+#define PLHM_SHM_STATIONS 16
+
+typedef struct _plhm_shm_station
+{
+    int32_t station;
+    int32_t error;
+    float position[3];
+    float euler[3];
+    uint32_t timestamp;
+    uint32_t reserved;
+    int64_t readtime_sec;
+    int64_t readtime_usec;
+} plhm_shm_station_t;
+
+typedef struct _plhm_shm_frame
+{
+    uint32_t magic;
+    uint32_t version;
+    volatile uint32_t seq;
+    int32_t fields;
+    uint32_t station_mask;      // bit n set if station[n] is valid
+    uint32_t reserved;
+    uint64_t frame;             // incremented for every frame published
+    int64_t readtime_sec;       // when the frame was read
+    int64_t readtime_usec;
+    plhm_shm_station_t station[PLHM_SHM_STATIONS];  // station n at n-1
+} plhm_shm_frame_t;
+
+typedef struct _plhm_shm
+{
+    int fd;
+    int writer;
+    char name[256];
+    plhm_shm_frame_t *frame;
+} plhm_shm_t;
+
+/* writer */
+int plhm_shm_create(plhm_shm_t *s, const char *name);
+int plhm_shm_publish(plhm_shm_t *s, const plhm_record_t *recs, int n);
+
+/* reader */
+int plhm_shm_open(plhm_shm_t *s, const char *name);
+int plhm_shm_read(plhm_shm_t *s, plhm_shm_frame_t *out);
+int plhm_shm_read_station(plhm_shm_t *s, int station, plhm_record_t *r);
+
+/* Zero-copy reads: access s->frame directly between these two calls,
+ * and repeat if plhm_shm_read_retry() returns non-zero. */
+uint32_t plhm_shm_read_begin(plhm_shm_t *s);
+int plhm_shm_read_retry(plhm_shm_t *s, uint32_t seq);
+
+/* closes either end; the writer also removes the segment */
+int plhm_shm_close(plhm_shm_t *s);
+
+#endif // _PLHM_SHM_H_
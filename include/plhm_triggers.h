@@ -0,0 +1,124 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _PLHM_TRIGGERS_H_
+#define _PLHM_TRIGGERS_H_
+
+#include <stdint.h>
+#include <plhm_frame.h>
+
+/* Events raised when a station enters or leaves a region of space, or
+ * when two stations come near each other.  Regions are boxes, spheres
+ * and half-spaces bounded by a plane.  Bounded regions are indexed in
+ * a uniform grid so that each station only tests the regions around
+ * it.  A hysteresis margin keeps a station that hovers on a boundary
+ * from raising a stream of events. */
+
+#define PLHM_TRIGGER_NAME 32
+
+// regions a station may be inside at once
+#define PLHM_TRIGGER_MAX_INSIDE 64
+
+typedef enum {
+    PLHM_REGION_BOX,
+    PLHM_REGION_SPHERE,
+    PLHM_REGION_PLANE,
+} plhm_region_type;
+
+typedef struct _plhm_region
+{
+    plhm_region_type type;
+    char name[PLHM_TRIGGER_NAME];
+    // box: min, max;  sphere: centre, radius in b[0];
+    // plane: unit normal, offset in b[0], inside where n.p >= offset
+    float a[3], b[3];
+} plhm_region_t;
+
+typedef struct _plhm_proximity
+{
+    char name[PLHM_TRIGGER_NAME];
+    int a, b;           // 0-based stations
+    float distance;
+} plhm_proximity_t;
+
+typedef enum {
+    PLHM_TRIGGER_ENTER,
+    PLHM_TRIGGER_EXIT,
+    PLHM_TRIGGER_NEAR,
+    PLHM_TRIGGER_FAR,
+} plhm_trigger_type;
+
+typedef struct _plhm_trigger_event
+{
+    plhm_trigger_type type;
+    int index;          // region, or proximity rule for NEAR and FAR
+    int station;        // 0-based
+    int other;          // second station for NEAR and FAR
+} plhm_trigger_event_t;
+
+typedef struct _plhm_triggers
+{
+    plhm_region_t *regions;
+    int n_regions;
+    plhm_proximity_t *rules;
+    int n_rules;
+    float hysteresis;
+
+    // grid index of bounded regions; unbounded ones are always tested
+    float min[3];
+    float inv_cell[3];
+    int dims[3];
+    int *cell_start;    // dims product + 1 offsets into cell_items
+    int *cell_items;
+    int *unbounded;
+    int n_unbounded;
+
+    // per station state
+    uint32_t *inside;   // n_regions bits per station
+    int n_words;
+    short inside_list[PLHM_FRAME_STATIONS][PLHM_TRIGGER_MAX_INSIDE];
+    int n_inside[PLHM_FRAME_STATIONS];
+    unsigned char *near;    // per proximity rule
+} plhm_triggers_t;
+
+void plhm_triggers_init(plhm_triggers_t *t);
+void plhm_triggers_free(plhm_triggers_t *t);
+
+/* Definitions may be added in any order; plhm_triggers_build() must
+ * be called before the next update.  Return 0 on success. */
+int plhm_triggers_add_box(plhm_triggers_t *t, const char *name,
+                          const float min[3], const float max[3]);
+int plhm_triggers_add_sphere(plhm_triggers_t *t, const char *name,
+                             const float centre[3], float radius);
+int plhm_triggers_add_plane(plhm_triggers_t *t, const char *name,
+                            const float normal[3], float offset);
+int plhm_triggers_add_proximity(plhm_triggers_t *t, const char *name,
+                                int a, int b, float distance);
+int plhm_triggers_build(plhm_triggers_t *t);
+
+/* Read definitions from a text file, one per line:
+ *   box <name> minx miny minz maxx maxy maxz
+ *   sphere <name> x y z radius
+ *   plane <name> nx ny nz offset
+ *   proximity <name> station station distance
+ *   hysteresis <margin>
+ * Stations are numbered from 1.  '#' starts a comment.  The index is
+ * built after reading. */
+int plhm_triggers_load(plhm_triggers_t *t, const char *path);
+
+/* Test the stations of a frame and write up to max events.  Returns
+ * the number of events written; changes that do not fit are reported
+ * on a later frame. */
+int plhm_triggers_update(plhm_triggers_t *t, const plhm_frame_t *fr,
+                         plhm_trigger_event_t *events, int max);
+
+#endif // _PLHM_TRIGGERS_H_
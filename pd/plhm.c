@@ -0,0 +1,464 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* [plhm] for Pure Data: drives the tracker through libplhm, without
+ * the daemon or OSC in between.
+ *
+ * A thread opens the device, configures it and reads frames into a
+ * queue; once per DSP tick the queue is emptied into the patch, one
+ * list per station:
+ *
+ *   station [x y z] [azimuth elevation roll] [timestamp]
+ *
+ * with the fields that were requested.  The right outlet reports the
+ * state of the device.
+ *
+ *   [plhm [device [fields]]]
+ *
+ *   open [device]        start acquisition, retrying until the device
+ *                        is found
+ *   close                stop acquisition and close the device
+ *   fields PET           any of P(osition), E(uler), T(imestamp)
+ *   rate 120|240
+ *   station n 0|1        disable or enable station n; stations without
+ *                        a sensor and the last active one are refused
+ *
+ * Changes to fields, rate and stations are applied between frames,
+ * as in the daemon. */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <m_pd.h>
+
+#include <plhm.h>
+
+#define QUEUE_FRAMES 64
+#define MAX_STATIONS 16
+
+typedef struct _frame
+{
+    int n;
+    plhm_record_t recs[MAX_STATIONS];
+} frame_t;
+
+typedef struct _plhm_pd
+{
+    t_object obj;
+    t_outlet *data_out, *status_out;
+    t_clock *clock;
+
+    pthread_t thread;
+    int started;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+
+    // requested by the patch, under lock
+    char device[256];
+    int run, quit;
+    int fields;
+    plhm_rate rate;
+    int disabled;
+    int changed;
+
+    // frames read, under lock
+    frame_t queue[QUEUE_FRAMES];
+    int head, count;
+    unsigned long dropped;
+
+    // state of the device, under lock; reported when it changes
+    int open, stations;
+    int detected;                   // stations with a sensor, 0 until open
+    int reported_open, reported_stations;
+    unsigned long reported_dropped;
+} t_plhm_pd;
+
+static t_class *plhm_class;
+
+static int parse_fields(const char *s)
+{
+    int fields = 0;
+    for (; *s; s++) {
+        switch (*s) {
+        case 'P': case 'p': fields |= PLHM_DATA_POSITION; break;
+        case 'E': case 'e': fields |= PLHM_DATA_EULER; break;
+        case 'T': case 't': fields |= PLHM_DATA_TIMESTAMP; break;
+        default: return -1;
+        }
+    }
+    return fields;
+}
+
+static int running(t_plhm_pd *x)
+{
+    int run;
+    pthread_mutex_lock(&x->lock);
+    run = x->run && !x->quit;
+    pthread_mutex_unlock(&x->lock);
+    return run;
+}
+
+static void set_state(t_plhm_pd *x, int open, const plhm_t *p)
+{
+    pthread_mutex_lock(&x->lock);
+    x->open = open;
+    x->stations = open ? p->stations : 0;
+    x->detected = open ? p->detected_mask : 0;
+    pthread_mutex_unlock(&x->lock);
+}
+
+static void push_frame(t_plhm_pd *x, const frame_t *f)
+{
+    pthread_mutex_lock(&x->lock);
+    if (x->count == QUEUE_FRAMES) {
+        // the patch is not keeping up: keep the newest
+        x->head = (x->head + 1) % QUEUE_FRAMES;
+        x->count--;
+        x->dropped++;
+    }
+    x->queue[(x->head + x->count) % QUEUE_FRAMES] = *f;
+    x->count++;
+    pthread_mutex_unlock(&x->lock);
+}
+
+/* Switch stations as requested, skipping those without a sensor and
+ * keeping the last active one on: requests made before the stations
+ * were known could not be checked.  A refused change leaves the device
+ * as it is rather than stopping it.  Returns the stations disabled. */
+static int apply_stations(plhm_t *p, int disabled)
+{
+    int i, bit;
+
+    for (i = 0; i < MAX_STATIONS; i++)
+    {
+        bit = 1 << i;
+        if (!(p->detected_mask & bit)
+            || !(disabled & bit) == !!(p->station_mask & bit))
+            continue;
+        if ((disabled & bit) && p->station_mask == bit)
+            continue;
+        plhm_set_station_active(p, i, !(disabled & bit));
+    }
+    return (disabled & ~p->detected_mask)
+        | (p->detected_mask & ~p->station_mask);
+}
+
+/* Apply requested changes between frames; returns non-zero on error. */
+static int apply_changes(t_plhm_pd *x, plhm_t *p, int *fields, int *rate,
+                         int *disabled)
+{
+    int f, r, d, changed;
+
+    pthread_mutex_lock(&x->lock);
+    changed = x->changed;
+    x->changed = 0;
+    f = x->fields;
+    r = x->rate;
+    d = x->disabled;
+    pthread_mutex_unlock(&x->lock);
+
+    if (!changed || (f == *fields && r == *rate && d == *disabled))
+        return 0;
+
+    if (plhm_pause_continuous(p) || plhm_set_rate(p, r))
+        return 1;
+    if (d != *disabled)
+        d = apply_stations(p, d);
+    if (f != *fields && plhm_set_data_fields(p, f))
+        return 1;
+    *fields = f;
+    *rate = r;
+    *disabled = d;
+    return plhm_resume_continuous(p);
+}
+
+/* Open and configure the device, as the daemon does. */
+static int start_device(plhm_t *p, const char *device, int fields, int rate,
+                        int disabled)
+{
+    if (plhm_find_device(device) || plhm_open_device(p, device))
+        return 1;
+
+    plhm_data_request(p);
+    while (!plhm_read_until_timeout(p, 500)) {}
+    if (plhm_text_mode(p) || plhm_get_version(p) || plhm_read_bits(p)
+        || plhm_get_stations(p))
+        return 1;
+    apply_stations(p, disabled);
+    if (plhm_set_hemisphere(p) || plhm_set_units(p, PLHM_UNITS_METRIC)
+        || plhm_set_rate(p, rate) || plhm_set_data_fields(p, fields)
+        || plhm_binary_mode(p) || plhm_data_request_continuous(p))
+        return 1;
+    return 0;
+}
+
+static void stop_device(plhm_t *p)
+{
+    plhm_data_request(p);
+    plhm_read_until_timeout(p, 500);
+    plhm_text_mode(p);
+    plhm_close_device(p);
+}
+
+static void *acquire(void *arg)
+{
+    t_plhm_pd *x = arg;
+    char device[256];
+    int fields, rate, disabled;
+    plhm_t p;
+    frame_t f;
+
+    memset(&p, 0, sizeof(p));
+    while (1)
+    {
+        pthread_mutex_lock(&x->lock);
+        while (!x->run && !x->quit)
+            pthread_cond_wait(&x->wake, &x->lock);
+        if (x->quit) {
+            pthread_mutex_unlock(&x->lock);
+            break;
+        }
+        strcpy(device, x->device);
+        fields = x->fields;
+        rate = x->rate;
+        disabled = x->disabled;
+        x->changed = 0;
+        pthread_mutex_unlock(&x->lock);
+
+        if (start_device(&p, device, fields, rate, disabled)) {
+            plhm_close_device(&p);
+            sleep(1);
+            continue;
+        }
+        set_state(x, 1, &p);
+
+        while (running(x))
+        {
+            for (f.n = 0; f.n < p.stations && f.n < MAX_STATIONS; f.n++)
+                if (plhm_read_data_record(&p, &f.recs[f.n]))
+                    break;
+            if (f.n < p.stations)
+                break;
+            push_frame(x, &f);
+            if (apply_changes(x, &p, &fields, &rate, &disabled))
+                break;
+            set_state(x, 1, &p);
+        }
+
+        stop_device(&p);
+        set_state(x, 0, &p);
+    }
+    return 0;
+}
+
+static void output_record(t_plhm_pd *x, const plhm_record_t *r)
+{
+    t_atom a[8];
+    int n = 0;
+
+    SETFLOAT(&a[n], r->station); n++;
+    if (r->fields & PLHM_DATA_POSITION) {
+        SETFLOAT(&a[n], r->position[0]); n++;
+        SETFLOAT(&a[n], r->position[1]); n++;
+        SETFLOAT(&a[n], r->position[2]); n++;
+    }
+    if (r->fields & PLHM_DATA_EULER) {
+        SETFLOAT(&a[n], r->euler[0]); n++;
+        SETFLOAT(&a[n], r->euler[1]); n++;
+        SETFLOAT(&a[n], r->euler[2]); n++;
+    }
+    if (r->fields & PLHM_DATA_TIMESTAMP) {
+        SETFLOAT(&a[n], r->timestamp); n++;
+    }
+    outlet_list(x->data_out, &s_list, n, a);
+}
+
+static void output_status(t_plhm_pd *x, const char *what, t_float v)
+{
+    t_atom a;
+    SETFLOAT(&a, v);
+    outlet_anything(x->status_out, gensym(what), 1, &a);
+}
+
+/* Once per DSP tick: output the frames read since the last one. */
+static void tick(t_plhm_pd *x)
+{
+    frame_t frames[QUEUE_FRAMES];
+    int i, j, n, open, stations;
+    unsigned long dropped;
+
+    pthread_mutex_lock(&x->lock);
+    for (n = 0; n < x->count; n++)
+        frames[n] = x->queue[(x->head + n) % QUEUE_FRAMES];
+    x->head = (x->head + n) % QUEUE_FRAMES;
+    x->count = 0;
+    open = x->open;
+    stations = x->stations;
+    dropped = x->dropped;
+    pthread_mutex_unlock(&x->lock);
+
+    if (open != x->reported_open)
+        output_status(x, "open", x->reported_open = open);
+    if (stations != x->reported_stations)
+        output_status(x, "stations", x->reported_stations = stations);
+    if (dropped != x->reported_dropped)
+        output_status(x, "dropped", x->reported_dropped = dropped);
+
+    for (i = 0; i < n; i++)
+        for (j = 0; j < frames[i].n; j++)
+            output_record(x, &frames[i].recs[j]);
+
+    clock_delay(x->clock, DEFDACBLKSIZE);
+}
+
+static void request(t_plhm_pd *x, int run)
+{
+    pthread_mutex_lock(&x->lock);
+    x->run = run;
+    pthread_cond_signal(&x->wake);
+    pthread_mutex_unlock(&x->lock);
+}
+
+static void plhm_pd_open(t_plhm_pd *x, t_symbol *device)
+{
+    if (*device->s_name) {
+        pthread_mutex_lock(&x->lock);
+        strncpy(x->device, device->s_name, sizeof(x->device) - 1);
+        pthread_mutex_unlock(&x->lock);
+    }
+    request(x, 1);
+}
+
+static void plhm_pd_close(t_plhm_pd *x)
+{
+    request(x, 0);
+}
+
+static void plhm_pd_fields(t_plhm_pd *x, t_symbol *s)
+{
+    int f = parse_fields(s->s_name);
+    if (f <= 0) {
+        pd_error(x, "plhm: unknown fields '%s'", s->s_name);
+        return;
+    }
+    pthread_mutex_lock(&x->lock);
+    x->fields = f;
+    x->changed = 1;
+    pthread_mutex_unlock(&x->lock);
+}
+
+static void plhm_pd_rate(t_plhm_pd *x, t_floatarg f)
+{
+    if (f != 120 && f != 240) {
+        pd_error(x, "plhm: rate must be 120 or 240");
+        return;
+    }
+    pthread_mutex_lock(&x->lock);
+    x->rate = f == 120 ? PLHM_RATE_120 : PLHM_RATE_240;
+    x->changed = 1;
+    pthread_mutex_unlock(&x->lock);
+}
+
+static void plhm_pd_station(t_plhm_pd *x, t_floatarg station, t_floatarg on)
+{
+    int s = (int)station - 1, bit;
+    if (s < 0 || s >= MAX_STATIONS) {
+        pd_error(x, "plhm: no station %d", (int)station);
+        return;
+    }
+    bit = 1 << s;
+    // once stations are known, only those with a sensor count, and the
+    // last active one stays on, as in the daemon
+    pthread_mutex_lock(&x->lock);
+    if (x->detected && !(x->detected & bit))
+        pd_error(x, "plhm: no sensor at station %d", s + 1);
+    else if (on) {
+        x->disabled &= ~bit;
+        x->changed = 1;
+    }
+    else if (x->detected && !(x->detected & ~(x->disabled | bit)))
+        pd_error(x, "plhm: station %d is the last active, not disabled",
+                 s + 1);
+    else {
+        x->disabled |= bit;
+        x->changed = 1;
+    }
+    pthread_mutex_unlock(&x->lock);
+}
+
+static void *plhm_pd_new(t_symbol *s, int argc, t_atom *argv)
+{
+    t_plhm_pd *x = (t_plhm_pd*)pd_new(plhm_class);
+
+    pthread_mutex_init(&x->lock, 0);
+    pthread_cond_init(&x->wake, 0);
+    strcpy(x->device, "/dev/ttyUSB0");
+    x->fields = PLHM_DATA_POSITION | PLHM_DATA_EULER;
+    x->rate = PLHM_RATE_240;
+
+    if (argc > 0 && argv[0].a_type == A_SYMBOL)
+        strncpy(x->device, atom_getsymbol(&argv[0])->s_name,
+                sizeof(x->device) - 1);
+    if (argc > 1 && argv[1].a_type == A_SYMBOL)
+        plhm_pd_fields(x, atom_getsymbol(&argv[1]));
+
+    x->data_out = outlet_new(&x->obj, &s_list);
+    x->status_out = outlet_new(&x->obj, &s_anything);
+
+    x->clock = clock_new(x, (t_method)tick);
+    clock_setunit(x->clock, 1, 1);
+    clock_delay(x->clock, DEFDACBLKSIZE);
+
+    // the device is only opened by the thread, so there is none to
+    // close if it does not start
+    if (pthread_create(&x->thread, 0, acquire, x)) {
+        pd_error(x, "plhm: could not start the acquisition thread");
+        pd_free((t_pd*)x);
+        return 0;
+    }
+    x->started = 1;
+    return x;
+}
+
+static void plhm_pd_free(t_plhm_pd *x)
+{
+    // the thread closes the device as it quits
+    if (x->started) {
+        pthread_mutex_lock(&x->lock);
+        x->quit = 1;
+        pthread_cond_signal(&x->wake);
+        pthread_mutex_unlock(&x->lock);
+        pthread_join(x->thread, 0);
+    }
+
+    clock_free(x->clock);
+    pthread_cond_destroy(&x->wake);
+    pthread_mutex_destroy(&x->lock);
+}
+
+void plhm_setup(void)
+{
+    plhm_class = class_new(gensym("plhm"), (t_newmethod)plhm_pd_new,
+                           (t_method)plhm_pd_free, sizeof(t_plhm_pd),
+                           CLASS_DEFAULT, A_GIMME, 0);
+    class_addmethod(plhm_class, (t_method)plhm_pd_open, gensym("open"),
+                    A_DEFSYM, 0);
+    class_addmethod(plhm_class, (t_method)plhm_pd_close, gensym("close"), 0);
+    class_addmethod(plhm_class, (t_method)plhm_pd_fields, gensym("fields"),
+                    A_SYMBOL, 0);
+    class_addmethod(plhm_class, (t_method)plhm_pd_rate, gensym("rate"),
+                    A_FLOAT, 0);
+    class_addmethod(plhm_class, (t_method)plhm_pd_station, gensym("station"),
+                    A_FLOAT, A_FLOAT, 0);
+}
@@ -0,0 +1,135 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* An example output plugin: each frame as one UDP datagram of text,
+ * a line per station of
+ *
+ *   station x y z azimuth elevation roll timestamp readtime_ms
+ *
+ * with the fields the tracker sends.  Load it with
+ *
+ *   plhm -x udp:<host>:<port> ... */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+
+#include <plhm_plugin.h>
+
+typedef struct _udp
+{
+    int fd;
+    struct sockaddr_storage sa;
+    socklen_t salen;
+    char buf[8192];
+} udp_t;
+
+static void *udp_open(const char *args)
+{
+    char host[256];
+    const char *port = strrchr(args, ':');
+    struct addrinfo hints, *ai;
+    udp_t *u;
+
+    if (!port || port == args || port - args >= (int)sizeof(host)) {
+        printf("[udp] Expected <host>:<port>, got '%s'.\n", args);
+        return 0;
+    }
+    snprintf(host, sizeof(host), "%.*s", (int)(port - args), args);
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, port + 1, &hints, &ai)) {
+        printf("[udp] Couldn't resolve %s.\n", args);
+        return 0;
+    }
+
+    u = calloc(1, sizeof(udp_t));
+    u->fd = socket(ai->ai_family, SOCK_DGRAM, 0);
+    memcpy(&u->sa, ai->ai_addr, ai->ai_addrlen);
+    u->salen = ai->ai_addrlen;
+    freeaddrinfo(ai);
+    if (u->fd < 0) {
+        perror("[udp] socket");
+        free(u);
+        return 0;
+    }
+    return u;
+}
+
+/* Append to the datagram, keeping *len within the buffer once full,
+ * so that a datagram too long is cut short. */
+static void append(udp_t *u, int *len, const char *fmt, ...)
+{
+    int room = sizeof(u->buf) - 1;
+    va_list ap;
+
+    if (*len >= room)
+        return;
+    va_start(ap, fmt);
+    *len += vsnprintf(u->buf + *len, room + 1 - *len, fmt, ap);
+    va_end(ap);
+    if (*len > room)
+        *len = room;
+}
+
+static void udp_write(void *state, const plhm_plugin_frame_t *f)
+{
+    udp_t *u = (udp_t*)state;
+    int i, len = 0;
+
+    for (i = 0; i < f->n; i++)
+    {
+        const plhm_record_t *r = &f->recs[i];
+        append(u, &len, "%d", r->station);
+        if (r->fields & PLHM_DATA_POSITION)
+            append(u, &len, " %g %g %g",
+                   r->position[0], r->position[1], r->position[2]);
+        if (r->fields & PLHM_DATA_EULER)
+            append(u, &len, " %g %g %g",
+                   r->euler[0], r->euler[1], r->euler[2]);
+        if (r->fields & PLHM_DATA_TIMESTAMP)
+            append(u, &len, " %u", r->timestamp);
+        append(u, &len, " %.3f\n", r->readtime.tv_sec * 1000.0
+               + r->readtime.tv_usec / 1000.0);
+    }
+
+    sendto(u->fd, u->buf, len, 0, (struct sockaddr*)&u->sa, u->salen);
+}
+
+static void udp_close(void *state)
+{
+    udp_t *u = (udp_t*)state;
+    close(u->fd);
+    free(u);
+}
+
+static const plhm_plugin_t udp_plugin = {
+    PLHM_PLUGIN_VERSION,
+    "udp",
+    0,                          // whatever fields are requested
+    0,                          // all stations
+    PLHM_PLUGIN_DROP_OLDEST,    // old frames are of no use to a receiver
+    udp_open,
+    udp_write,
+    udp_close,
+};
+
+const plhm_plugin_t *plhm_plugin_describe(void)
+{
+    return &udp_plugin;
+}
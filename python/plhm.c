@@ -0,0 +1,808 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* Python bindings for libplhm.
+ *
+ *   import plhm, numpy as np
+ *   with plhm.Tracker("/dev/ttyUSB0", "PET") as t:
+ *       b = t.read(240)                 # one second at 240 Hz
+ *       xyz = np.asarray(b.position)    # (240, stations, 3) float32
+ *
+ *   for b in plhm.Recording("session.plhm"):
+ *       ...
+ *
+ * Reads return a Batch of frames, whose fields are arrays exposed
+ * through the buffer protocol, so that numpy.asarray() or memoryview()
+ * use them without copying and without a Python object per value:
+ *
+ *   position, euler   float32 (frames, stations, 3)
+ *   timestamp         uint32  (frames, stations)
+ *   error             uint8   (frames, stations)
+ *   readtime          float64 (frames, stations), seconds since 1970
+ *   stations          tuple of the station numbers of the columns
+ *
+ * The GIL is released while waiting on the device and while decoding
+ * recordings. */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+
+#include <plhm.h>
+#include <plhm_recording.h>
+
+#define MAX_STATIONS 16
+
+/* Array: a block of memory with a shape, for the buffer protocol. */
+
+typedef struct {
+    PyObject_HEAD
+    char *data;
+    const char *format;
+    int ndim;
+    Py_ssize_t itemsize, len;
+    Py_ssize_t shape[3], strides[3];
+} ArrayObject;
+
+static void array_dealloc(ArrayObject *a)
+{
+    PyMem_Free(a->data);
+    Py_TYPE(a)->tp_free((PyObject*)a);
+}
+
+static int array_getbuffer(ArrayObject *a, Py_buffer *view, int flags)
+{
+    view->obj = (PyObject*)a;
+    Py_INCREF(a);
+    view->buf = a->data;
+    view->len = a->len;
+    view->readonly = 0;
+    view->itemsize = a->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? (char*)a->format : 0;
+    // without PyBUF_ND the consumer sees the bytes as one dimension
+    view->ndim = (flags & PyBUF_ND) ? a->ndim : 1;
+    view->shape = (flags & PyBUF_ND) ? a->shape : 0;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? a->strides : 0;
+    view->suboffsets = 0;
+    view->internal = 0;
+    return 0;
+}
+
+static Py_ssize_t array_length(ArrayObject *a)
+{
+    return a->shape[0];
+}
+
+static PyBufferProcs array_as_buffer = {
+    (getbufferproc)array_getbuffer,
+    0,
+};
+
+static PySequenceMethods array_as_sequence = {
+    (lenfunc)array_length,
+};
+
+static PyTypeObject ArrayType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "plhm.Array",
+    .tp_basicsize = sizeof(ArrayObject),
+    .tp_dealloc = (destructor)array_dealloc,
+    .tp_as_sequence = &array_as_sequence,
+    .tp_as_buffer = &array_as_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Values of a batch, for numpy.asarray() or memoryview().",
+};
+
+static ArrayObject *array_new(const char *format, Py_ssize_t itemsize,
+                              int ndim, Py_ssize_t d0, Py_ssize_t d1,
+                              Py_ssize_t d2)
+{
+    ArrayObject *a = PyObject_New(ArrayObject, &ArrayType);
+    int i;
+
+    if (!a)
+        return 0;
+    a->format = format;
+    a->itemsize = itemsize;
+    a->ndim = ndim;
+    a->shape[0] = d0;
+    a->shape[1] = d1;
+    a->shape[2] = d2;
+    a->len = itemsize;
+    for (i = ndim - 1; i >= 0; i--) {
+        a->strides[i] = a->len;
+        a->len *= a->shape[i];
+    }
+    // never a zero-length allocation
+    a->data = PyMem_Calloc(1, a->len ? a->len : 1);
+    if (!a->data) {
+        Py_DECREF(a);
+        return (ArrayObject*)PyErr_NoMemory();
+    }
+    return a;
+}
+
+/* Batch: frames of records from the same stations. */
+
+typedef struct {
+    PyObject_HEAD
+    Py_ssize_t frames;
+    int fields;
+    PyObject *stations;
+    ArrayObject *position, *euler, *timestamp, *error, *readtime;
+} BatchObject;
+
+static void batch_dealloc(BatchObject *b)
+{
+    Py_XDECREF(b->stations);
+    Py_XDECREF(b->position);
+    Py_XDECREF(b->euler);
+    Py_XDECREF(b->timestamp);
+    Py_XDECREF(b->error);
+    Py_XDECREF(b->readtime);
+    Py_TYPE(b)->tp_free((PyObject*)b);
+}
+
+static Py_ssize_t batch_length(BatchObject *b)
+{
+    return b->frames;
+}
+
+static PyMemberDef batch_members[] = {
+    {"frames", T_PYSSIZET, offsetof(BatchObject, frames), READONLY,
+     "number of frames"},
+    {"fields", T_INT, offsetof(BatchObject, fields), READONLY,
+     "PLHM_DATA_* bits of the fields read"},
+    {"stations", T_OBJECT, offsetof(BatchObject, stations), READONLY,
+     "station numbers of the columns"},
+    {"position", T_OBJECT, offsetof(BatchObject, position), READONLY,
+     "float32 (frames, stations, 3)"},
+    {"euler", T_OBJECT, offsetof(BatchObject, euler), READONLY,
+     "azimuth, elevation, roll; float32 (frames, stations, 3)"},
+    {"timestamp", T_OBJECT, offsetof(BatchObject, timestamp), READONLY,
+     "uint32 (frames, stations)"},
+    {"error", T_OBJECT, offsetof(BatchObject, error), READONLY,
+     "uint8 (frames, stations)"},
+    {"readtime", T_OBJECT, offsetof(BatchObject, readtime), READONLY,
+     "seconds since 1970; float64 (frames, stations)"},
+    {0}
+};
+
+static PySequenceMethods batch_as_sequence = {
+    (lenfunc)batch_length,
+};
+
+static PyTypeObject BatchType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "plhm.Batch",
+    .tp_basicsize = sizeof(BatchObject),
+    .tp_dealloc = (destructor)batch_dealloc,
+    .tp_as_sequence = &batch_as_sequence,
+    .tp_members = batch_members,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Frames of records; each field is an array.",
+};
+
+/* Make a batch of frames from records stored frame by frame, each
+ * frame holding the same n stations. */
+static PyObject *batch_from_records(const plhm_record_t *recs,
+                                    Py_ssize_t frames, int n)
+{
+    BatchObject *b = PyObject_New(BatchObject, &BatchType);
+    float *pos, *euler;
+    uint32_t *ts;
+    uint8_t *err;
+    double *rt;
+    Py_ssize_t i;
+    int s;
+
+    if (!b)
+        return 0;
+    b->frames = frames;
+    b->fields = n && frames ? recs[0].fields : 0;
+    b->stations = PyTuple_New(n);
+    b->position = array_new("f", 4, 3, frames, n, 3);
+    b->euler = array_new("f", 4, 3, frames, n, 3);
+    b->timestamp = array_new("I", 4, 2, frames, n, 1);
+    b->error = array_new("B", 1, 2, frames, n, 1);
+    b->readtime = array_new("d", 8, 2, frames, n, 1);
+    if (!b->stations || !b->position || !b->euler || !b->timestamp
+        || !b->error || !b->readtime)
+    {
+        Py_DECREF(b);
+        return 0;
+    }
+
+    for (s = 0; s < n; s++)
+        PyTuple_SET_ITEM(b->stations, s,
+                         PyLong_FromLong(frames ? recs[s].station : 0));
+
+    pos = (float*)b->position->data;
+    euler = (float*)b->euler->data;
+    ts = (uint32_t*)b->timestamp->data;
+    err = (uint8_t*)b->error->data;
+    rt = (double*)b->readtime->data;
+    for (i = 0; i < frames * n; i++)
+    {
+        const plhm_record_t *r = &recs[i];
+        memcpy(pos + i*3, r->position, sizeof(float) * 3);
+        memcpy(euler + i*3, r->euler, sizeof(float) * 3);
+        ts[i] = r->timestamp;
+        err[i] = (uint8_t)r->error;
+        rt[i] = r->readtime.tv_sec + r->readtime.tv_usec / 1e6;
+    }
+    return (PyObject*)b;
+}
+
+static int parse_fields(const char *s)
+{
+    int fields = 0;
+    for (; *s; s++) {
+        switch (*s) {
+        case 'P': case 'p': fields |= PLHM_DATA_POSITION; break;
+        case 'E': case 'e': fields |= PLHM_DATA_EULER; break;
+        case 'T': case 't': fields |= PLHM_DATA_TIMESTAMP; break;
+        default: return -1;
+        }
+    }
+    return fields;
+}
+
+static int parse_rate(int hz, plhm_rate *rate)
+{
+    if (hz == 120)
+        *rate = PLHM_RATE_120;
+    else if (hz == 240)
+        *rate = PLHM_RATE_240;
+    else {
+        PyErr_SetString(PyExc_ValueError, "rate must be 120 or 240");
+        return 1;
+    }
+    return 0;
+}
+
+/* Tracker: the device, streaming continuously. */
+
+typedef struct {
+    PyObject_HEAD
+    plhm_t p;
+    int busy;
+} TrackerObject;
+
+/* Open and configure the device, as the daemon does. */
+static int start_device(plhm_t *p, const char *device, int fields,
+                        plhm_rate rate)
+{
+    if (plhm_find_device(device) || plhm_open_device(p, device))
+        return 1;
+
+    plhm_data_request(p);
+    while (!plhm_read_until_timeout(p, 500)) {}
+    if (plhm_text_mode(p) || plhm_get_version(p) || plhm_read_bits(p)
+        || plhm_get_stations(p) || plhm_set_hemisphere(p)
+        || plhm_set_units(p, PLHM_UNITS_METRIC) || plhm_set_rate(p, rate)
+        || plhm_set_data_fields(p, fields) || plhm_binary_mode(p)
+        || plhm_data_request_continuous(p))
+    {
+        plhm_close_device(p);
+        return 1;
+    }
+    return 0;
+}
+
+static void stop_device(plhm_t *p)
+{
+    plhm_data_request(p);
+    plhm_read_until_timeout(p, 500);
+    plhm_text_mode(p);
+    plhm_close_device(p);
+}
+
+static int tracker_init(TrackerObject *t, PyObject *args, PyObject *kw)
+{
+    static char *names[] = {"device", "fields", "rate", "uring", 0};
+    const char *device = "/dev/ttyUSB0", *fields_str = "PE";
+    int hz = 240, uring = 0, fields, rc;
+    plhm_rate rate;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|ssip", names, &device,
+                                     &fields_str, &hz, &uring))
+        return -1;
+    if ((fields = parse_fields(fields_str)) <= 0) {
+        PyErr_Format(PyExc_ValueError, "unknown fields '%s'", fields_str);
+        return -1;
+    }
+    if (parse_rate(hz, &rate))
+        return -1;
+
+    if (t->p.device_open) {
+        PyErr_SetString(PyExc_RuntimeError, "tracker already open");
+        return -1;
+    }
+    plhm_set_input(&t->p, PLHM_INPUT_READ);
+    memset(&t->p, 0, sizeof(t->p));
+    if (uring)
+        plhm_set_input(&t->p, PLHM_INPUT_URING);
+
+    Py_BEGIN_ALLOW_THREADS
+    rc = start_device(&t->p, device, fields, rate);
+    Py_END_ALLOW_THREADS
+
+    if (rc) {
+        PyErr_Format(PyExc_OSError, "could not start the tracker on %s",
+                     device);
+        return -1;
+    }
+    return 0;
+}
+
+static void tracker_dealloc(TrackerObject *t)
+{
+    if (t->p.device_open)
+        stop_device(&t->p);
+    plhm_set_input(&t->p, PLHM_INPUT_READ);
+    Py_TYPE(t)->tp_free((PyObject*)t);
+}
+
+/* Claim the device for one call; it is not shared between threads. */
+static int tracker_claim(TrackerObject *t)
+{
+    if (!t->p.device_open) {
+        PyErr_SetString(PyExc_ValueError, "tracker is closed");
+        return 1;
+    }
+    if (t->busy) {
+        PyErr_SetString(PyExc_RuntimeError,
+                        "tracker is in use by another thread");
+        return 1;
+    }
+    t->busy = 1;
+    return 0;
+}
+
+static PyObject *tracker_read(TrackerObject *t, PyObject *args, PyObject *kw)
+{
+    static char *names[] = {"frames", 0};
+    Py_ssize_t frames = 1, f = 0;
+    plhm_record_t *recs;
+    PyObject *batch;
+    int n, s, rc = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|n", names, &frames))
+        return 0;
+    if (frames < 1) {
+        PyErr_SetString(PyExc_ValueError, "frames must be positive");
+        return 0;
+    }
+    if (tracker_claim(t))
+        return 0;
+
+    n = t->p.stations < MAX_STATIONS ? t->p.stations : MAX_STATIONS;
+    recs = PyMem_Malloc(sizeof(plhm_record_t) * frames * (n ? n : 1));
+    if (!recs) {
+        t->busy = 0;
+        return PyErr_NoMemory();
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (f = 0; f < frames && !rc; f++)
+        for (s = 0; s < n && !rc; s++)
+            rc = plhm_read_data_record(&t->p, &recs[f * n + s]);
+    Py_END_ALLOW_THREADS
+
+    t->busy = 0;
+    if (rc) {
+        PyMem_Free(recs);
+        PyErr_SetString(PyExc_OSError, "could not read from the tracker");
+        return 0;
+    }
+    batch = batch_from_records(recs, frames, n);
+    PyMem_Free(recs);
+    return batch;
+}
+
+/* Change the configuration between frames, as the daemon does. */
+static PyObject *reconfigure(TrackerObject *t, int fields, int rate,
+                             int station, int active)
+{
+    int rc;
+
+    if (tracker_claim(t))
+        return 0;
+    Py_BEGIN_ALLOW_THREADS
+    rc = plhm_pause_continuous(&t->p);
+    if (!rc && rate >= 0)
+        rc = plhm_set_rate(&t->p, rate);
+    if (!rc && fields > 0)
+        rc = plhm_set_data_fields(&t->p, fields);
+    if (!rc && station >= 0)
+        rc = plhm_set_station_active(&t->p, station, active);
+    if (!rc)
+        rc = plhm_resume_continuous(&t->p);
+    Py_END_ALLOW_THREADS
+    t->busy = 0;
+
+    if (rc) {
+        PyErr_SetString(PyExc_OSError, "could not configure the tracker");
+        return 0;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *tracker_set_fields(TrackerObject *t, PyObject *args)
+{
+    const char *s;
+    int fields;
+
+    if (!PyArg_ParseTuple(args, "s", &s))
+        return 0;
+    if ((fields = parse_fields(s)) <= 0) {
+        PyErr_Format(PyExc_ValueError, "unknown fields '%s'", s);
+        return 0;
+    }
+    return reconfigure(t, fields, -1, -1, 0);
+}
+
+static PyObject *tracker_set_rate(TrackerObject *t, PyObject *args)
+{
+    plhm_rate rate;
+    int hz;
+
+    if (!PyArg_ParseTuple(args, "i", &hz) || parse_rate(hz, &rate))
+        return 0;
+    return reconfigure(t, 0, rate, -1, 0);
+}
+
+static PyObject *tracker_set_station(TrackerObject *t, PyObject *args)
+{
+    int station, active;
+
+    if (!PyArg_ParseTuple(args, "ip", &station, &active))
+        return 0;
+    if (station < 1 || station > MAX_STATIONS) {
+        PyErr_Format(PyExc_ValueError, "no station %d", station);
+        return 0;
+    }
+    return reconfigure(t, 0, -1, station - 1, active);
+}
+
+static PyObject *tracker_close(TrackerObject *t, PyObject *unused)
+{
+    if (t->busy) {
+        PyErr_SetString(PyExc_RuntimeError,
+                        "tracker is in use by another thread");
+        return 0;
+    }
+    if (t->p.device_open) {
+        t->busy = 1;
+        Py_BEGIN_ALLOW_THREADS
+        stop_device(&t->p);
+        Py_END_ALLOW_THREADS
+        t->busy = 0;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *tracker_enter(PyObject *t, PyObject *unused)
+{
+    Py_INCREF(t);
+    return t;
+}
+
+static PyObject *tracker_exit(TrackerObject *t, PyObject *args)
+{
+    PyObject *r = tracker_close(t, 0);
+    if (!r)
+        return 0;
+    Py_DECREF(r);
+    Py_RETURN_FALSE;
+}
+
+static PyObject *tracker_get_stations(TrackerObject *t, void *closure)
+{
+    return PyLong_FromLong(t->p.stations);
+}
+
+static PyObject *tracker_get_station_mask(TrackerObject *t, void *closure)
+{
+    return PyLong_FromLong(t->p.station_mask);
+}
+
+static PyObject *tracker_get_fields(TrackerObject *t, void *closure)
+{
+    return PyLong_FromLong(t->p.fields);
+}
+
+static PyMethodDef tracker_methods[] = {
+    {"read", (PyCFunction)tracker_read, METH_VARARGS | METH_KEYWORDS,
+     "read(frames=1) -> Batch\n\nWait for the next frames."},
+    {"set_fields", (PyCFunction)tracker_set_fields, METH_VARARGS,
+     "set_fields('PET')"},
+    {"set_rate", (PyCFunction)tracker_set_rate, METH_VARARGS,
+     "set_rate(120 or 240)"},
+    {"set_station", (PyCFunction)tracker_set_station, METH_VARARGS,
+     "set_station(n, active)"},
+    {"close", (PyCFunction)tracker_close, METH_NOARGS,
+     "Stop acquisition and close the device."},
+    {"__enter__", (PyCFunction)tracker_enter, METH_NOARGS, 0},
+    {"__exit__", (PyCFunction)tracker_exit, METH_VARARGS, 0},
+    {0}
+};
+
+static PyGetSetDef tracker_getset[] = {
+    {"stations", (getter)tracker_get_stations, 0, "stations per frame", 0},
+    {"station_mask", (getter)tracker_get_station_mask, 0,
+     "bit n set for station n+1", 0},
+    {"fields", (getter)tracker_get_fields, 0, "PLHM_DATA_* bits", 0},
+    {0}
+};
+
+static PyTypeObject TrackerType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "plhm.Tracker",
+    .tp_basicsize = sizeof(TrackerObject),
+    .tp_dealloc = (destructor)tracker_dealloc,
+    .tp_methods = tracker_methods,
+    .tp_getset = tracker_getset,
+    .tp_init = (initproc)tracker_init,
+    .tp_new = PyType_GenericNew,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Tracker(device='/dev/ttyUSB0', fields='PE', rate=240, "
+              "uring=False)\n\n"
+              "Open and start the tracker, streaming the given fields:\n"
+              "any of P(osition), E(uler), T(imestamp).",
+};
+
+/* Recording: a compressed recording, read block by block. */
+
+typedef struct {
+    PyObject_HEAD
+    plhm_rec_reader_t reader;
+    int open;
+    plhm_record_t *recs;        // the current block, decoded
+    int n, pos;                 // records in it, and the next one
+    int stations, fields;       // per frame in it
+    Py_ssize_t damaged;         // blocks skipped
+} RecordingObject;
+
+static int recording_init(RecordingObject *r, PyObject *args, PyObject *kw)
+{
+    static char *names[] = {"path", 0};
+    PyObject *path;
+    int rc;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "O&", names,
+                                     PyUnicode_FSConverter, &path))
+        return -1;
+    if (r->open) {
+        PyErr_SetString(PyExc_RuntimeError, "recording already open");
+        Py_DECREF(path);
+        return -1;
+    }
+    r->recs = PyMem_Malloc(sizeof(plhm_record_t) * PLHM_REC_BLOCK_FRAMES
+                           * PLHM_REC_MAX_STATIONS);
+    if (!r->recs) {
+        Py_DECREF(path);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    rc = plhm_rec_reader_open(&r->reader, PyBytes_AS_STRING(path));
+    Py_END_ALLOW_THREADS
+
+    if (rc) {
+        PyErr_Format(PyExc_OSError, "could not read the recording %s",
+                     PyBytes_AS_STRING(path));
+        Py_DECREF(path);
+        return -1;
+    }
+    Py_DECREF(path);
+    r->open = 1;
+    r->n = r->pos = 0;
+    return 0;
+}
+
+static void recording_dealloc(RecordingObject *r)
+{
+    if (r->open)
+        plhm_rec_reader_close(&r->reader);
+    PyMem_Free(r->recs);
+    Py_TYPE(r)->tp_free((PyObject*)r);
+}
+
+/* Decode the next block, with the GIL released.  Returns 0 on success,
+ * 1 at the end. */
+static int next_block(RecordingObject *r)
+{
+    plhm_rec_block_t b;
+    int rc, n = -1;
+
+    Py_BEGIN_ALLOW_THREADS
+    while ((rc = plhm_rec_next_block(&r->reader, &b)) == 0)
+    {
+        if ((n = plhm_rec_decode_block(&b, r->recs)) > 0)
+            break;
+        r->damaged++;
+    }
+    Py_END_ALLOW_THREADS
+
+    if (rc)
+        return 1;
+    r->n = n;
+    r->pos = 0;
+    r->stations = n / b.frames;
+    r->fields = b.fields;
+    return 0;
+}
+
+static PyObject *recording_read(RecordingObject *r, PyObject *args,
+                                PyObject *kw)
+{
+    static char *names[] = {"frames", 0};
+    Py_ssize_t frames = -1, got = 0;
+    plhm_record_t *out = 0;
+    PyObject *batch;
+    int stations = 0, fields = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|n", names, &frames))
+        return 0;
+    if (!r->open) {
+        PyErr_SetString(PyExc_ValueError, "recording is closed");
+        return 0;
+    }
+
+    // frames up to the count, or to the next change of stations or
+    // fields; None at the end
+    while (frames < 0 || got < frames)
+    {
+        int take;
+        plhm_record_t *grown;
+
+        if (r->pos == r->n && next_block(r))
+            break;
+        if (got && (r->stations != stations || r->fields != fields))
+            break;
+        stations = r->stations;
+        fields = r->fields;
+
+        take = (r->n - r->pos) / stations;
+        if (frames >= 0 && take > frames - got)
+            take = frames - got;
+
+        grown = PyMem_Realloc(out, sizeof(plhm_record_t)
+                              * (got + take) * stations);
+        if (!grown) {
+            PyMem_Free(out);
+            return PyErr_NoMemory();
+        }
+        out = grown;
+        memcpy(out + got * stations, r->recs + r->pos,
+               sizeof(plhm_record_t) * take * stations);
+        r->pos += take * stations;
+        got += take;
+    }
+
+    if (!got) {
+        PyMem_Free(out);
+        Py_RETURN_NONE;
+    }
+    batch = batch_from_records(out, got, stations);
+    PyMem_Free(out);
+    return batch;
+}
+
+static PyObject *recording_iternext(RecordingObject *r)
+{
+    // one block at a time
+    PyObject *args, *b;
+
+    if (!r->open)
+        return 0;
+    if (r->pos == r->n && next_block(r))
+        return 0;
+    args = Py_BuildValue("(i)", (r->n - r->pos) / r->stations);
+    if (!args)
+        return 0;
+    b = recording_read(r, args, 0);
+    Py_DECREF(args);
+    if (b == Py_None) {
+        Py_DECREF(b);
+        return 0;
+    }
+    return b;
+}
+
+static PyObject *recording_close(RecordingObject *r, PyObject *unused)
+{
+    if (r->open)
+        plhm_rec_reader_close(&r->reader);
+    r->open = 0;
+    Py_RETURN_NONE;
+}
+
+static PyObject *recording_enter(PyObject *r, PyObject *unused)
+{
+    Py_INCREF(r);
+    return r;
+}
+
+static PyObject *recording_exit(RecordingObject *r, PyObject *args)
+{
+    Py_DECREF(recording_close(r, 0));
+    Py_RETURN_FALSE;
+}
+
+static PyMethodDef recording_methods[] = {
+    {"read", (PyCFunction)recording_read, METH_VARARGS | METH_KEYWORDS,
+     "read(frames=-1) -> Batch or None\n\n"
+     "Read frames, all of them if negative, stopping early where the\n"
+     "stations or fields change.  None at the end."},
+    {"close", (PyCFunction)recording_close, METH_NOARGS, 0},
+    {"__enter__", (PyCFunction)recording_enter, METH_NOARGS, 0},
+    {"__exit__", (PyCFunction)recording_exit, METH_VARARGS, 0},
+    {0}
+};
+
+static PyMemberDef recording_members[] = {
+    {"damaged", T_PYSSIZET, offsetof(RecordingObject, damaged), READONLY,
+     "damaged blocks skipped"},
+    {0}
+};
+
+static PyTypeObject RecordingType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "plhm.Recording",
+    .tp_basicsize = sizeof(RecordingObject),
+    .tp_dealloc = (destructor)recording_dealloc,
+    .tp_iter = PyObject_SelfIter,
+    .tp_iternext = (iternextfunc)recording_iternext,
+    .tp_methods = recording_methods,
+    .tp_members = recording_members,
+    .tp_init = (initproc)recording_init,
+    .tp_new = PyType_GenericNew,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Recording(path)\n\n"
+              "A compressed recording (plhm -z); iterating gives a Batch\n"
+              "per block.",
+};
+
+static struct PyModuleDef plhm_module = {
+    PyModuleDef_HEAD_INIT,
+    "plhm",
+    "Polhemus trackers and their recordings, through libplhm.",
+    -1,
+    0,
+};
+
+PyMODINIT_FUNC PyInit_plhm(void)
+{
+    PyObject *m;
+
+    if (PyType_Ready(&ArrayType) < 0 || PyType_Ready(&BatchType) < 0
+        || PyType_Ready(&TrackerType) < 0 || PyType_Ready(&RecordingType) < 0)
+        return 0;
+    if (!(m = PyModule_Create(&plhm_module)))
+        return 0;
+
+    Py_INCREF(&BatchType);
+    PyModule_AddObject(m, "Batch", (PyObject*)&BatchType);
+    Py_INCREF(&TrackerType);
+    PyModule_AddObject(m, "Tracker", (PyObject*)&TrackerType);
+    Py_INCREF(&RecordingType);
+    PyModule_AddObject(m, "Recording", (PyObject*)&RecordingType);
+
+    PyModule_AddIntConstant(m, "POSITION", PLHM_DATA_POSITION);
+    PyModule_AddIntConstant(m, "EULER", PLHM_DATA_EULER);
+    PyModule_AddIntConstant(m, "TIMESTAMP", PLHM_DATA_TIMESTAMP);
+    return m;
+}
@@ -0,0 +1,331 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "plhm_distortion.h"
+
+#define NODE_FLOATS 8
+#define BRICK_NODES 64
+
+static inline const float *node_at(const plhm_grid_t *g, int x, int y, int z)
+{
+    int b = ((z >> 2) * g->bricks[1] + (y >> 2)) * g->bricks[0] + (x >> 2);
+    int n = (b * BRICK_NODES) + ((z & 3) << 4) + ((y & 3) << 2) + (x & 3);
+    return g->nodes + n * NODE_FLOATS;
+}
+
+int plhm_grid_init(plhm_grid_t *g, const int dims[3], const float min[3],
+                   const float max[3], const plhm_grid_node_t *nodes)
+{
+    int i, x, y, z;
+    size_t count;
+
+    memset(g, 0, sizeof(plhm_grid_t));
+    for (i = 0; i < 3; i++) {
+        if (dims[i] < 2 || dims[i] > 4096 || !(max[i] > min[i])) {
+            printf("Invalid grid dimensions.\n");
+            return 1;
+        }
+        g->dims[i] = dims[i];
+        g->min[i] = min[i];
+        g->max[i] = max[i];
+        g->scale[i] = (dims[i] - 1) / (max[i] - min[i]);
+        g->bricks[i] = (dims[i] + 3) / 4;
+    }
+
+    count = (size_t)g->bricks[0] * g->bricks[1] * g->bricks[2] * BRICK_NODES;
+    if (posix_memalign((void**)&g->nodes, 32,
+                       count * NODE_FLOATS * sizeof(float)))
+    {
+        g->nodes = 0;
+        printf("Could not allocate distortion grid.\n");
+        return 1;
+    }
+    memset(g->nodes, 0, count * NODE_FLOATS * sizeof(float));
+
+    for (z = 0; z < dims[2]; z++)
+        for (y = 0; y < dims[1]; y++)
+            for (x = 0; x < dims[0]; x++)
+            {
+                const plhm_grid_node_t *src =
+                    &nodes[(z * dims[1] + y) * dims[0] + x];
+                float *dst = (float*)node_at(g, x, y, z);
+                memcpy(dst, src->offset, sizeof(src->offset));
+                memcpy(dst + 3, src->rotation, sizeof(src->rotation));
+            }
+
+    return 0;
+}
+
+void plhm_grid_free(plhm_grid_t *g)
+{
+    free(g->nodes);
+    g->nodes = 0;
+}
+
+static int read_le32(FILE *f, void *out, int n)
+{
+    unsigned char b[4];
+    uint32_t *u = (uint32_t*)out;
+    int i;
+    for (i = 0; i < n; i++) {
+        if (fread(b, 4, 1, f) != 1)
+            return 1;
+        u[i] = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+    }
+    return 0;
+}
+
+static int write_le32(FILE *f, const void *in, int n)
+{
+    unsigned char b[4];
+    const uint32_t *u = (const uint32_t*)in;
+    int i;
+    for (i = 0; i < n; i++) {
+        b[0] = u[i] & 0xFF;
+        b[1] = (u[i] >> 8) & 0xFF;
+        b[2] = (u[i] >> 16) & 0xFF;
+        b[3] = (u[i] >> 24) & 0xFF;
+        if (fwrite(b, 4, 1, f) != 1)
+            return 1;
+    }
+    return 0;
+}
+
+int plhm_grid_load(plhm_grid_t *g, const char *path)
+{
+    char magic[8];
+    int32_t version, dims[3];
+    float min[3], max[3];
+    plhm_grid_node_t *nodes;
+    size_t i, count;
+    int rc;
+    FILE *f = fopen(path, "rb");
+
+    if (!f) {
+        printf("Could not open grid file %s.\n", path);
+        return 1;
+    }
+
+    if (fread(magic, 8, 1, f) != 1
+        || memcmp(magic, PLHM_GRID_MAGIC, 8)
+        || read_le32(f, &version, 1) || version != PLHM_GRID_VERSION
+        || read_le32(f, dims, 3) || read_le32(f, min, 3)
+        || read_le32(f, max, 3)
+        || dims[0] < 2 || dims[1] < 2 || dims[2] < 2
+        || dims[0] > 4096 || dims[1] > 4096 || dims[2] > 4096)
+    {
+        printf("%s is not a valid grid file.\n", path);
+        fclose(f);
+        return 1;
+    }
+
+    count = (size_t)dims[0] * dims[1] * dims[2];
+    nodes = malloc(count * sizeof(plhm_grid_node_t));
+    if (!nodes) {
+        fclose(f);
+        return 1;
+    }
+
+    for (i = 0; i < count; i++)
+        if (read_le32(f, &nodes[i], 7)) {
+            printf("Grid file %s is truncated.\n", path);
+            free(nodes);
+            fclose(f);
+            return 1;
+        }
+    fclose(f);
+
+    rc = plhm_grid_init(g, dims, min, max, nodes);
+    free(nodes);
+    return rc;
+}
+
+int plhm_grid_save(const char *path, const int dims[3], const float min[3],
+                   const float max[3], const plhm_grid_node_t *nodes)
+{
+    int32_t version = PLHM_GRID_VERSION;
+    size_t i, count = (size_t)dims[0] * dims[1] * dims[2];
+    FILE *f = fopen(path, "wb");
+    int rc = 0;
+
+    if (!f) {
+        printf("Could not open grid file %s for writing.\n", path);
+        return 1;
+    }
+
+    rc |= fwrite(PLHM_GRID_MAGIC, 8, 1, f) != 1;
+    rc |= write_le32(f, &version, 1);
+    rc |= write_le32(f, dims, 3);
+    rc |= write_le32(f, min, 3);
+    rc |= write_le32(f, max, 3);
+    for (i = 0; i < count && !rc; i++)
+        rc |= write_le32(f, &nodes[i], 7);
+
+    if (fclose(f) || rc) {
+        printf("Error writing grid file %s.\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+/* Blend the eight nodes around a position.  out receives the offset
+ * in [0..2] and the (unnormalized) rotation in [3..6]. */
+static void interpolate(const plhm_grid_t *g, const float p[3],
+                        float out[NODE_FLOATS])
+{
+    int c[3], i;
+    float t[3];
+
+    for (i = 0; i < 3; i++) {
+        float u = (p[i] - g->min[i]) * g->scale[i];
+        if (!(u > 0.0f)) u = 0.0f;
+        if (u > g->dims[i] - 1) u = g->dims[i] - 1;
+        c[i] = (int)u;
+        if (c[i] > g->dims[i] - 2)
+            c[i] = g->dims[i] - 2;
+        t[i] = u - c[i];
+        if (t[i] > 1.0f) t[i] = 1.0f;
+    }
+
+    float w[8];
+    w[0] = (1 - t[0]) * (1 - t[1]) * (1 - t[2]);
+    w[1] = t[0] * (1 - t[1]) * (1 - t[2]);
+    w[2] = (1 - t[0]) * t[1] * (1 - t[2]);
+    w[3] = t[0] * t[1] * (1 - t[2]);
+    w[4] = (1 - t[0]) * (1 - t[1]) * t[2];
+    w[5] = t[0] * (1 - t[1]) * t[2];
+    w[6] = (1 - t[0]) * t[1] * t[2];
+    w[7] = t[0] * t[1] * t[2];
+
+#ifdef __SSE__
+    __m128 lo = _mm_setzero_ps(), hi = _mm_setzero_ps();
+    for (i = 0; i < 8; i++) {
+        const float *n = node_at(g, c[0] + (i & 1), c[1] + ((i >> 1) & 1),
+                                 c[2] + (i >> 2));
+        __m128 wi = _mm_set1_ps(w[i]);
+        lo = _mm_add_ps(lo, _mm_mul_ps(wi, _mm_load_ps(n)));
+        hi = _mm_add_ps(hi, _mm_mul_ps(wi, _mm_load_ps(n + 4)));
+    }
+    _mm_storeu_ps(out, lo);
+    _mm_storeu_ps(out + 4, hi);
+#else
+    int j;
+    memset(out, 0, NODE_FLOATS * sizeof(float));
+    for (i = 0; i < 8; i++) {
+        const float *n = node_at(g, c[0] + (i & 1), c[1] + ((i >> 1) & 1),
+                                 c[2] + (i >> 2));
+        for (j = 0; j < 7; j++)
+            out[j] += w[i] * n[j];
+    }
+#endif
+}
+
+static inline void normalize_quat(float *q)
+{
+    float n = q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3];
+    if (n > 0.0f) {
+        n = 1.0f / sqrtf(n);
+        q[0] *= n; q[1] *= n; q[2] *= n; q[3] *= n;
+    } else {
+        q[0] = 1.0f; q[1] = q[2] = q[3] = 0.0f;
+    }
+}
+
+/* q = r * q */
+static inline void rotate_quat(const float *r, float *q)
+{
+    float w = q[0], x = q[1], y = q[2], z = q[3];
+    q[0] = r[0] * w - r[1] * x - r[2] * y - r[3] * z;
+    q[1] = r[0] * x + r[1] * w + r[2] * z - r[3] * y;
+    q[2] = r[0] * y - r[1] * z + r[2] * w + r[3] * x;
+    q[3] = r[0] * z + r[1] * y - r[2] * x + r[3] * w;
+}
+
+void plhm_grid_lookup(const plhm_grid_t *g, const float position[3],
+                      plhm_grid_node_t *out)
+{
+    float v[NODE_FLOATS];
+    interpolate(g, position, v);
+    memcpy(out->offset, v, sizeof(out->offset));
+    memcpy(out->rotation, v + 3, sizeof(out->rotation));
+    normalize_quat(out->rotation);
+}
+
+void plhm_grid_apply_record(const plhm_grid_t *g, plhm_record_t *r)
+{
+    float v[NODE_FLOATS], q[4];
+
+    // corrections are indexed by measured position
+    if (!(r->fields & PLHM_DATA_POSITION))
+        return;
+
+    interpolate(g, r->position, v);
+    r->position[0] += v[0];
+    r->position[1] += v[1];
+    r->position[2] += v[2];
+
+    if (r->fields & PLHM_DATA_EULER) {
+        normalize_quat(v + 3);
+        plhm_euler_to_quat(r->euler, q);
+        rotate_quat(v + 3, q);
+        plhm_quat_to_euler(q, r->euler);
+    }
+}
+
+void plhm_grid_apply_frame(const plhm_grid_t *g, plhm_frame_t *f)
+{
+    float v[NODE_FLOATS], p[3], q[4];
+    int i;
+
+    if (!(f->fields & PLHM_DATA_POSITION))
+        return;
+
+    for (i = 0; i < f->lanes; i++)
+    {
+        if (!(f->station_mask & (1 << i)))
+            continue;
+
+        p[0] = f->px[i];
+        p[1] = f->py[i];
+        p[2] = f->pz[i];
+        interpolate(g, p, v);
+        f->px[i] += v[0];
+        f->py[i] += v[1];
+        f->pz[i] += v[2];
+
+        if (f->fields & PLHM_DATA_EULER) {
+            normalize_quat(v + 3);
+            q[0] = f->qw[i];
+            q[1] = f->qx[i];
+            q[2] = f->qy[i];
+            q[3] = f->qz[i];
+            rotate_quat(v + 3, q);
+            f->qw[i] = q[0];
+            f->qx[i] = q[1];
+            f->qy[i] = q[2];
+            f->qz[i] = q[3];
+        }
+    }
+
+    if (f->fields & PLHM_DATA_EULER)
+        plhm_frame_update_euler(f);
+}
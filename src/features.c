@@ -0,0 +1,352 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "plhm_features.h"
+
+#define N PLHM_FRAME_STATIONS
+#define ALIGN PLHM_FRAME_ALIGN
+
+// samples further apart than this (ms) restart the derivatives
+#define MAX_GAP 1000.0
+
+// weight of each new interval in the average sample interval
+#define PERIOD_SMOOTHING 0.02
+
+#define POSITION_FEATURES (PLHM_FEATURE_VELOCITY | PLHM_FEATURE_ACCELERATION \
+                           | PLHM_FEATURE_JERK | PLHM_FEATURE_SPEED        \
+                           | PLHM_FEATURE_DISTANCE)
+
+void plhm_features_init(plhm_features_t *fe, int features)
+{
+    int i;
+    memset(fe, 0, sizeof(plhm_features_t));
+    fe->features = features;
+    for (i = 0; i < N; i++)
+        fe->qw[i] = 1.0f;
+}
+
+void plhm_features_reset(plhm_features_t *fe)
+{
+    memset(fe->samples, 0, sizeof(fe->samples));
+}
+
+int plhm_features_letter(char c)
+{
+    switch (c) {
+    case 'v': case 'V': return PLHM_FEATURE_VELOCITY;
+    case 'a': case 'A': return PLHM_FEATURE_ACCELERATION;
+    case 'j': case 'J': return PLHM_FEATURE_JERK;
+    case 's': case 'S': return PLHM_FEATURE_SPEED;
+    case 'w': case 'W': return PLHM_FEATURE_ANGULAR_VELOCITY;
+    case 'd': case 'D': return PLHM_FEATURE_DISTANCE;
+    }
+    return 0;
+}
+
+int plhm_features_parse(const char *letters)
+{
+    int f = 0, b;
+    for (; *letters; letters++) {
+        if (!(b = plhm_features_letter(*letters)))
+            return -1;
+        f |= b;
+    }
+    return f;
+}
+
+/* Per-lane derivative outputs, before transposing into the result. */
+typedef struct {
+    float vx[N] ALIGN, vy[N] ALIGN, vz[N] ALIGN;
+    float ax[N] ALIGN, ay[N] ALIGN, az[N] ALIGN;
+    float jx[N] ALIGN, jy[N] ALIGN, jz[N] ALIGN;
+    float speed[N] ALIGN;
+    float wx[N] ALIGN, wy[N] ALIGN, wz[N] ALIGN;
+    float row[N] ALIGN;
+} lanes_t;
+
+#ifdef __SSE__
+#define LD(a) _mm_load_ps(&(a)[i])
+#define ST(a,v) _mm_store_ps(&(a)[i], (v))
+#define ADD _mm_add_ps
+#define SUB _mm_sub_ps
+#define MUL _mm_mul_ps
+#define SEL(m,a,b) _mm_or_ps(_mm_and_ps((m), (a)), _mm_andnot_ps((m), (b)))
+
+/* Differentiate position three times.  idt is 1/dt, or 0 for lanes
+ * without a previous sample, which makes their derivatives 0.  Only
+ * lanes in mask update the history. */
+static void derivatives(plhm_features_t *fe, const plhm_frame_t *fr,
+                        const float *idt, const uint32_t *mask,
+                        lanes_t *l)
+{
+    int i;
+    for (i = 0; i < fr->lanes; i += 4)
+    {
+        __m128 m = _mm_load_ps((const float*)&mask[i]), k = LD(idt);
+        __m128 x = LD(fr->px), y = LD(fr->py), z = LD(fr->pz);
+        __m128 vx = MUL(SUB(x, LD(fe->px)), k);
+        __m128 vy = MUL(SUB(y, LD(fe->py)), k);
+        __m128 vz = MUL(SUB(z, LD(fe->pz)), k);
+        __m128 ax = MUL(SUB(vx, LD(fe->vx)), k);
+        __m128 ay = MUL(SUB(vy, LD(fe->vy)), k);
+        __m128 az = MUL(SUB(vz, LD(fe->vz)), k);
+        ST(l->jx, MUL(SUB(ax, LD(fe->ax)), k));
+        ST(l->jy, MUL(SUB(ay, LD(fe->ay)), k));
+        ST(l->jz, MUL(SUB(az, LD(fe->az)), k));
+        ST(l->vx, vx); ST(l->vy, vy); ST(l->vz, vz);
+        ST(l->ax, ax); ST(l->ay, ay); ST(l->az, az);
+        ST(l->speed, _mm_sqrt_ps(ADD(ADD(MUL(vx, vx), MUL(vy, vy)),
+                                     MUL(vz, vz))));
+
+        ST(fe->px, SEL(m, x, LD(fe->px)));
+        ST(fe->py, SEL(m, y, LD(fe->py)));
+        ST(fe->pz, SEL(m, z, LD(fe->pz)));
+        ST(fe->vx, SEL(m, vx, LD(fe->vx)));
+        ST(fe->vy, SEL(m, vy, LD(fe->vy)));
+        ST(fe->vz, SEL(m, vz, LD(fe->vz)));
+        ST(fe->ax, SEL(m, ax, LD(fe->ax)));
+        ST(fe->ay, SEL(m, ay, LD(fe->ay)));
+        ST(fe->az, SEL(m, az, LD(fe->az)));
+    }
+}
+
+/* Angular velocity from the rotation between successive samples,
+ * dq = q * conj(q_prev), as 2 * vec(dq) / dt.  dq is taken with a
+ * non-negative w so the shorter rotation is used. */
+static void angular(plhm_features_t *fe, const plhm_frame_t *fr,
+                    const float *idt, const uint32_t *mask, lanes_t *l)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f), two = _mm_set1_ps(2.0f);
+    int i;
+    for (i = 0; i < fr->lanes; i += 4)
+    {
+        __m128 m = _mm_load_ps((const float*)&mask[i]);
+        __m128 w = LD(fr->qw), x = LD(fr->qx), y = LD(fr->qy), z = LD(fr->qz);
+        __m128 pw = LD(fe->qw), px = LD(fe->qx);
+        __m128 py = LD(fe->qy), pz = LD(fe->qz);
+        __m128 dw = ADD(ADD(MUL(w, pw), MUL(x, px)),
+                        ADD(MUL(y, py), MUL(z, pz)));
+        __m128 s = _mm_or_ps(_mm_and_ps(sign, dw), two);   // +-2
+        __m128 k = MUL(s, LD(idt));
+        ST(l->wx, MUL(k, ADD(SUB(MUL(x, pw), MUL(w, px)),
+                             SUB(MUL(z, py), MUL(y, pz)))));
+        ST(l->wy, MUL(k, ADD(SUB(MUL(y, pw), MUL(w, py)),
+                             SUB(MUL(x, pz), MUL(z, px)))));
+        ST(l->wz, MUL(k, ADD(SUB(MUL(z, pw), MUL(w, pz)),
+                             SUB(MUL(y, px), MUL(x, py)))));
+        ST(fe->qw, SEL(m, w, pw));
+        ST(fe->qx, SEL(m, x, px));
+        ST(fe->qy, SEL(m, y, py));
+        ST(fe->qz, SEL(m, z, pz));
+    }
+}
+
+/* Distances from station s to every lane. */
+static void distance_row(const plhm_frame_t *fr, int s, lanes_t *l)
+{
+    __m128 x = _mm_set1_ps(fr->px[s]), y = _mm_set1_ps(fr->py[s]);
+    __m128 z = _mm_set1_ps(fr->pz[s]);
+    int i;
+    for (i = 0; i < fr->lanes; i += 4)
+    {
+        __m128 dx = SUB(LD(fr->px), x), dy = SUB(LD(fr->py), y);
+        __m128 dz = SUB(LD(fr->pz), z);
+        ST(l->row, _mm_sqrt_ps(ADD(ADD(MUL(dx, dx), MUL(dy, dy)),
+                                   MUL(dz, dz))));
+    }
+}
+
+#undef LD
+#undef ST
+#undef ADD
+#undef SUB
+#undef MUL
+#undef SEL
+#else
+static void derivatives(plhm_features_t *fe, const plhm_frame_t *fr,
+                        const float *idt, const uint32_t *mask,
+                        lanes_t *l)
+{
+    int i;
+    for (i = 0; i < fr->lanes; i++)
+    {
+        float k = idt[i];
+        l->vx[i] = (fr->px[i] - fe->px[i]) * k;
+        l->vy[i] = (fr->py[i] - fe->py[i]) * k;
+        l->vz[i] = (fr->pz[i] - fe->pz[i]) * k;
+        l->ax[i] = (l->vx[i] - fe->vx[i]) * k;
+        l->ay[i] = (l->vy[i] - fe->vy[i]) * k;
+        l->az[i] = (l->vz[i] - fe->vz[i]) * k;
+        l->jx[i] = (l->ax[i] - fe->ax[i]) * k;
+        l->jy[i] = (l->ay[i] - fe->ay[i]) * k;
+        l->jz[i] = (l->az[i] - fe->az[i]) * k;
+        l->speed[i] = sqrtf(l->vx[i] * l->vx[i] + l->vy[i] * l->vy[i]
+                            + l->vz[i] * l->vz[i]);
+        if (!mask[i])
+            continue;
+        fe->px[i] = fr->px[i];
+        fe->py[i] = fr->py[i];
+        fe->pz[i] = fr->pz[i];
+        fe->vx[i] = l->vx[i];
+        fe->vy[i] = l->vy[i];
+        fe->vz[i] = l->vz[i];
+        fe->ax[i] = l->ax[i];
+        fe->ay[i] = l->ay[i];
+        fe->az[i] = l->az[i];
+    }
+}
+
+static void angular(plhm_features_t *fe, const plhm_frame_t *fr,
+                    const float *idt, const uint32_t *mask, lanes_t *l)
+{
+    int i;
+    for (i = 0; i < fr->lanes; i++)
+    {
+        float w = fr->qw[i], x = fr->qx[i], y = fr->qy[i], z = fr->qz[i];
+        float pw = fe->qw[i], px = fe->qx[i], py = fe->qy[i], pz = fe->qz[i];
+        float dw = w * pw + x * px + y * py + z * pz;
+        float k = (dw < 0 ? -2.0f : 2.0f) * idt[i];
+        l->wx[i] = k * (x * pw - w * px + z * py - y * pz);
+        l->wy[i] = k * (y * pw - w * py + x * pz - z * px);
+        l->wz[i] = k * (z * pw - w * pz + y * px - x * py);
+        if (!mask[i])
+            continue;
+        fe->qw[i] = w;
+        fe->qx[i] = x;
+        fe->qy[i] = y;
+        fe->qz[i] = z;
+    }
+}
+
+static void distance_row(const plhm_frame_t *fr, int s, lanes_t *l)
+{
+    int i;
+    for (i = 0; i < fr->lanes; i++)
+    {
+        float dx = fr->px[i] - fr->px[s], dy = fr->py[i] - fr->py[s];
+        float dz = fr->pz[i] - fr->pz[s];
+        l->row[i] = sqrtf(dx * dx + dy * dy + dz * dz);
+    }
+}
+#endif
+
+static void copy3(float out[N][3], uint32_t valid, const float *x,
+                  const float *y, const float *z)
+{
+    int i;
+    for (i = 0; i < N; i++)
+        if (valid & (1 << i)) {
+            out[i][0] = x[i];
+            out[i][1] = y[i];
+            out[i][2] = z[i];
+        }
+}
+
+void plhm_features_compute(plhm_features_t *fe, const plhm_frame_t *fr,
+                           plhm_feature_values_t *out)
+{
+    float idt[N] ALIGN;
+    uint32_t mask[N] ALIGN;
+    lanes_t l;
+    int i, j, feats = fe->features;
+
+    out->features = 0;
+    out->station_mask = fr->station_mask;
+    out->velocity_mask = out->acceleration_mask = out->jerk_mask = 0;
+
+    if (!(fr->fields & PLHM_DATA_POSITION))
+        feats &= ~POSITION_FEATURES;
+    if (!(fr->fields & PLHM_DATA_EULER))
+        feats &= ~PLHM_FEATURE_ANGULAR_VELOCITY;
+    if (!feats)
+        return;
+
+    if (fr->fields != fe->fields) {
+        fe->fields = fr->fields;
+        plhm_features_reset(fe);
+    }
+
+    for (i = 0; i < fr->lanes; i++)
+    {
+        double gap = fr->readtime[i] - fe->last[i];
+        uint32_t bit = 1 << i;
+
+        idt[i] = 0.0f;
+        mask[i] = 0;
+        if (!(fr->station_mask & bit))
+            continue;
+
+        mask[i] = ~0u;
+        fe->last[i] = fr->readtime[i];
+        if (!(gap > 0) || gap > MAX_GAP)
+            fe->samples[i] = 0;
+        else if (fe->samples[i] == 1)
+            fe->period[i] = gap;
+        else
+            fe->period[i] += PERIOD_SMOOTHING * (gap - fe->period[i]);
+
+        if (fe->samples[i] > 0) {
+            idt[i] = (float)(1000.0 / fe->period[i]);
+            out->velocity_mask |= bit;
+        }
+        if (fe->samples[i] > 1)
+            out->acceleration_mask |= bit;
+        if (fe->samples[i] > 2)
+            out->jerk_mask |= bit;
+        if (fe->samples[i] < 3)
+            fe->samples[i]++;
+    }
+
+    out->features = feats;
+
+    if (feats & (PLHM_FEATURE_VELOCITY | PLHM_FEATURE_ACCELERATION
+                 | PLHM_FEATURE_JERK | PLHM_FEATURE_SPEED))
+    {
+        derivatives(fe, fr, idt, mask, &l);
+        if (feats & PLHM_FEATURE_VELOCITY)
+            copy3(out->velocity, out->velocity_mask, l.vx, l.vy, l.vz);
+        if (feats & PLHM_FEATURE_ACCELERATION)
+            copy3(out->acceleration, out->acceleration_mask,
+                  l.ax, l.ay, l.az);
+        if (feats & PLHM_FEATURE_JERK)
+            copy3(out->jerk, out->jerk_mask, l.jx, l.jy, l.jz);
+        if (feats & PLHM_FEATURE_SPEED)
+            memcpy(out->speed, l.speed, fr->lanes * sizeof(float));
+    }
+
+    if (feats & PLHM_FEATURE_ANGULAR_VELOCITY)
+    {
+        angular(fe, fr, idt, mask, &l);
+        copy3(out->angular_velocity, out->velocity_mask, l.wx, l.wy, l.wz);
+    }
+
+    if (feats & PLHM_FEATURE_DISTANCE)
+    {
+        for (i = 0; i < fr->lanes; i++)
+        {
+            if (!mask[i])
+                continue;
+            distance_row(fr, i, &l);
+            for (j = i + 1; j < fr->lanes; j++)
+                if (mask[j])
+                    out->distance[PLHM_FEATURE_PAIR(i, j)] = l.row[j];
+        }
+    }
+}
@@ -0,0 +1,403 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "plhm_filter.h"
+
+#define TWO_PI ((float)(2.0 * M_PI))
+
+// samples further apart than this (s) restart the filter
+#define MAX_GAP 1.0
+
+// initial velocity variance, relative to the measurement variance
+#define INITIAL_VELOCITY_VAR 1e4f
+
+static void init(plhm_filter_t *f, plhm_filter_type type)
+{
+    memset(f, 0, sizeof(plhm_filter_t));
+    f->type = type;
+}
+
+void plhm_filter_init_one_euro(plhm_filter_t *f, float min_cutoff,
+                               float beta, float d_cutoff)
+{
+    init(f, PLHM_FILTER_ONE_EURO);
+    f->min_cutoff = min_cutoff;
+    f->beta = beta;
+    f->d_cutoff = d_cutoff;
+}
+
+void plhm_filter_init_kalman(plhm_filter_t *f, float process_noise,
+                             float measurement_noise)
+{
+    init(f, PLHM_FILTER_KALMAN);
+    f->process_noise = process_noise;
+    f->measurement_noise = measurement_noise;
+}
+
+void plhm_filter_set_prediction(plhm_filter_t *f, float lead)
+{
+    f->lead = lead / 1000.0f;
+}
+
+void plhm_filter_reset(plhm_filter_t *f)
+{
+    f->primed = 0;
+}
+
+int plhm_filter_parse(plhm_filter_t *f, const char *spec)
+{
+    float a[3];
+    int n = 0;
+    const char *c = strchr(spec, ':');
+    size_t len = c ? (size_t)(c - spec) : strlen(spec);
+
+    if (c) {
+        char *end;
+        c++;
+        while (n < 3) {
+            a[n] = strtof(c, &end);
+            if (end == c)
+                return 1;
+            n++;
+            c = end;
+            if (*c != ',')
+                break;
+            c++;
+        }
+        if (*c)
+            return 1;
+    }
+
+    if (len == 4 && !strncmp(spec, "euro", 4)) {
+        plhm_filter_init_one_euro(f, n > 0 ? a[0] : 1.0f,
+                                  n > 1 ? a[1] : 0.01f,
+                                  n > 2 ? a[2] : 1.0f);
+        return !(f->min_cutoff > 0 && f->d_cutoff > 0 && f->beta >= 0);
+    }
+    if (len == 6 && !strncmp(spec, "kalman", 6) && n < 3) {
+        plhm_filter_init_kalman(f, n > 0 ? a[0] : 1000.0f,
+                                n > 1 ? a[1] : 0.001f);
+        return !(f->process_noise > 0 && f->measurement_noise > 0);
+    }
+    return 1;
+}
+
+static void channels(plhm_frame_t *fr, float *ch[PLHM_FILTER_CHANNELS])
+{
+    ch[0] = fr->px;
+    ch[1] = fr->py;
+    ch[2] = fr->pz;
+    ch[3] = fr->qw;
+    ch[4] = fr->qx;
+    ch[5] = fr->qy;
+    ch[6] = fr->qz;
+}
+
+/* Work out the time step of each lane and which lanes are filtered.
+ * Lanes seen for the first time, or after a gap, are restarted from
+ * the measurement and left unchanged.  The quaternion is flipped into
+ * the hemisphere of the filter state so that q and -q, which are the
+ * same orientation, do not average towards zero.  The one-euro
+ * derivative smoothing factor depends only on the time step, so it is
+ * also computed here.  Returns 0 if there is nothing to filter. */
+static int prepare(plhm_filter_t *f, plhm_frame_t *fr,
+                   float *ch[PLHM_FILTER_CHANNELS], int *c0, int *c1,
+                   float dt[PLHM_FRAME_STATIONS],
+                   float ad[PLHM_FRAME_STATIONS],
+                   uint32_t mask[PLHM_FRAME_STATIONS])
+{
+    int i, c;
+
+    if (f->type == PLHM_FILTER_NONE)
+        return 0;
+
+    *c0 = (fr->fields & PLHM_DATA_POSITION) ? 0 : 3;
+    *c1 = (fr->fields & PLHM_DATA_EULER) ? 7 : 3;
+    if (*c0 == *c1)
+        return 0;
+
+    if (fr->fields != f->fields) {
+        f->fields = fr->fields;
+        f->primed = 0;
+    }
+
+    channels(fr, ch);
+
+    for (i = 0; i < fr->lanes; i++)
+    {
+        uint32_t bit = 1 << i;
+        double gap;
+
+        mask[i] = 0;
+        dt[i] = 1.0f;
+        ad[i] = 0.0f;
+
+        if (!(fr->station_mask & bit))
+            continue;
+
+        gap = (fr->readtime[i] - f->last[i]) / 1000.0;
+        f->last[i] = fr->readtime[i];
+
+        if (!(f->primed & bit) || !(gap > 0) || gap > MAX_GAP)
+        {
+            for (c = *c0; c < *c1; c++) {
+                f->x[c][i] = ch[c][i];
+                f->v[c][i] = 0.0f;
+                f->p00[c][i] = f->measurement_noise;
+                f->p01[c][i] = 0.0f;
+                f->p11[c][i] = f->measurement_noise * INITIAL_VELOCITY_VAR;
+            }
+            f->primed |= bit;
+            continue;
+        }
+
+        if (*c1 == 7
+            && (ch[3][i] * f->x[3][i] + ch[4][i] * f->x[4][i]
+                + ch[5][i] * f->x[5][i] + ch[6][i] * f->x[6][i]) < 0)
+        {
+            for (c = 3; c < 7; c++)
+                ch[c][i] = -ch[c][i];
+        }
+
+        mask[i] = ~0u;
+        dt[i] = (float)gap;
+        ad[i] = TWO_PI * f->d_cutoff * dt[i];
+        ad[i] = ad[i] / (1.0f + ad[i]);
+    }
+
+    return 1;
+}
+
+static void normalize_scalar(plhm_frame_t *fr)
+{
+    int i;
+    for (i = 0; i < fr->lanes; i++)
+    {
+        float n = (fr->qw[i] * fr->qw[i] + fr->qx[i] * fr->qx[i]
+                   + fr->qy[i] * fr->qy[i] + fr->qz[i] * fr->qz[i]);
+        if (!(n > 0.0f))
+            continue;
+        n = 1.0f / sqrtf(n);
+        fr->qw[i] *= n;
+        fr->qx[i] *= n;
+        fr->qy[i] *= n;
+        fr->qz[i] *= n;
+    }
+}
+
+void plhm_filter_apply_scalar(plhm_filter_t *f, plhm_frame_t *fr)
+{
+    float *ch[PLHM_FILTER_CHANNELS];
+    float dt[PLHM_FRAME_STATIONS], ad[PLHM_FRAME_STATIONS];
+    uint32_t mask[PLHM_FRAME_STATIONS];
+    int c, c0, c1, i;
+
+    if (!prepare(f, fr, ch, &c0, &c1, dt, ad, mask))
+        return;
+
+    for (c = c0; c < c1; c++)
+    {
+        float *z = ch[c], *x = f->x[c], *v = f->v[c];
+
+        for (i = 0; i < fr->lanes; i++)
+        {
+            if (!mask[i])
+                continue;
+
+            if (f->type == PLHM_FILTER_ONE_EURO)
+            {
+                float dx = (z[i] - x[i]) / dt[i];
+                float edx = v[i] + ad[i] * (dx - v[i]);
+                float r = (TWO_PI * (f->min_cutoff + f->beta * fabsf(edx))
+                           * dt[i]);
+                x[i] += (r / (1.0f + r)) * (z[i] - x[i]);
+                v[i] = edx;
+            }
+            else
+            {
+                float *p00 = f->p00[c], *p01 = f->p01[c], *p11 = f->p11[c];
+                float q = f->process_noise, d = dt[i];
+                float s, k0, k1, y;
+
+                // predict
+                x[i] += v[i] * d;
+                p00[i] += d * (2.0f * p01[i] + d * p11[i])
+                    + q * d * d * d / 3.0f;
+                p01[i] += d * p11[i] + q * d * d / 2.0f;
+                p11[i] += q * d;
+
+                // correct
+                s = p00[i] + f->measurement_noise;
+                k0 = p00[i] / s;
+                k1 = p01[i] / s;
+                y = z[i] - x[i];
+                x[i] += k0 * y;
+                v[i] += k1 * y;
+                p11[i] -= k1 * p01[i];
+                p01[i] *= 1.0f - k0;
+                p00[i] *= 1.0f - k0;
+            }
+
+            z[i] = x[i] + v[i] * f->lead;
+        }
+    }
+
+    if (c1 == 7) {
+        normalize_scalar(fr);
+        plhm_frame_update_euler(fr);
+    }
+}
+
+#ifdef __SSE__
+#define LD(a) _mm_load_ps(&(a)[i])
+#define ST(a,v) _mm_store_ps(&(a)[i], (v))
+#define ADD _mm_add_ps
+#define SUB _mm_sub_ps
+#define MUL _mm_mul_ps
+#define DIV _mm_div_ps
+#define SET _mm_set1_ps
+// select a where m is set, otherwise b
+#define SEL(m,a,b) _mm_or_ps(_mm_and_ps((m), (a)), _mm_andnot_ps((m), (b)))
+
+static void one_euro(plhm_filter_t *f, float *z, int c, int lanes,
+                     const float *dt, const float *ad, const uint32_t *mask)
+{
+    float *x = f->x[c], *v = f->v[c];
+    const __m128 one = SET(1.0f), sign = SET(-0.0f);
+    const __m128 min_cutoff = SET(TWO_PI * f->min_cutoff);
+    const __m128 beta = SET(TWO_PI * f->beta);
+    const __m128 lead = SET(f->lead);
+    int i;
+
+    for (i = 0; i < lanes; i += 4)
+    {
+        __m128 m = _mm_load_ps((const float*)&mask[i]);
+        __m128 d = LD(dt), zi = LD(z), xi = LD(x), vi = LD(v);
+        __m128 err = SUB(zi, xi);
+        __m128 edx = ADD(vi, MUL(LD(ad), SUB(DIV(err, d), vi)));
+        __m128 r = MUL(ADD(min_cutoff, MUL(beta, _mm_andnot_ps(sign, edx))),
+                       d);
+        __m128 xn = ADD(xi, MUL(DIV(r, ADD(one, r)), err));
+        ST(x, SEL(m, xn, xi));
+        ST(v, SEL(m, edx, vi));
+        ST(z, SEL(m, ADD(xn, MUL(edx, lead)), zi));
+    }
+}
+
+static void kalman(plhm_filter_t *f, float *z, int c, int lanes,
+                   const float *dt, const uint32_t *mask)
+{
+    float *x = f->x[c], *v = f->v[c];
+    float *p00 = f->p00[c], *p01 = f->p01[c], *p11 = f->p11[c];
+    const __m128 one = SET(1.0f), two = SET(2.0f);
+    const __m128 q = SET(f->process_noise);
+    const __m128 q3 = SET(f->process_noise / 3.0f);
+    const __m128 q2 = SET(f->process_noise / 2.0f);
+    const __m128 r = SET(f->measurement_noise);
+    const __m128 lead = SET(f->lead);
+    int i;
+
+    for (i = 0; i < lanes; i += 4)
+    {
+        __m128 m = _mm_load_ps((const float*)&mask[i]);
+        __m128 d = LD(dt), d2 = MUL(d, d);
+        __m128 xi = LD(x), vi = LD(v), zi = LD(z);
+        __m128 a00 = LD(p00), a01 = LD(p01), a11 = LD(p11);
+
+        // predict
+        __m128 xp = ADD(xi, MUL(vi, d));
+        __m128 b00 = ADD(ADD(a00, MUL(d, ADD(MUL(two, a01), MUL(d, a11)))),
+                         MUL(q3, MUL(d2, d)));
+        __m128 b01 = ADD(ADD(a01, MUL(d, a11)), MUL(q2, d2));
+        __m128 b11 = ADD(a11, MUL(q, d));
+
+        // correct
+        __m128 s = ADD(b00, r);
+        __m128 k0 = DIV(b00, s), k1 = DIV(b01, s);
+        __m128 y = SUB(zi, xp);
+        __m128 xn = ADD(xp, MUL(k0, y));
+        __m128 vn = ADD(vi, MUL(k1, y));
+        __m128 nk0 = SUB(one, k0);
+
+        ST(p11, SEL(m, SUB(b11, MUL(k1, b01)), a11));
+        ST(p01, SEL(m, MUL(nk0, b01), a01));
+        ST(p00, SEL(m, MUL(nk0, b00), a00));
+        ST(x, SEL(m, xn, xi));
+        ST(v, SEL(m, vn, vi));
+        ST(z, SEL(m, ADD(xn, MUL(vn, lead)), zi));
+    }
+}
+
+static void normalize(plhm_frame_t *fr)
+{
+    int i;
+    for (i = 0; i < fr->lanes; i += 4)
+    {
+        __m128 w = LD(fr->qw), x = LD(fr->qx), y = LD(fr->qy), z = LD(fr->qz);
+        __m128 n = ADD(ADD(MUL(w, w), MUL(x, x)), ADD(MUL(y, y), MUL(z, z)));
+        __m128 m = _mm_cmpgt_ps(n, _mm_setzero_ps());
+        __m128 k = SEL(m, DIV(SET(1.0f), _mm_sqrt_ps(n)), SET(1.0f));
+        ST(fr->qw, MUL(w, k));
+        ST(fr->qx, MUL(x, k));
+        ST(fr->qy, MUL(y, k));
+        ST(fr->qz, MUL(z, k));
+    }
+}
+
+void plhm_filter_apply(plhm_filter_t *f, plhm_frame_t *fr)
+{
+    float *ch[PLHM_FILTER_CHANNELS];
+    float dt[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    float ad[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    uint32_t mask[PLHM_FRAME_STATIONS] PLHM_FRAME_ALIGN;
+    int c, c0, c1;
+
+    if (!prepare(f, fr, ch, &c0, &c1, dt, ad, mask))
+        return;
+
+    for (c = c0; c < c1; c++)
+    {
+        if (f->type == PLHM_FILTER_ONE_EURO)
+            one_euro(f, ch[c], c, fr->lanes, dt, ad, mask);
+        else
+            kalman(f, ch[c], c, fr->lanes, dt, mask);
+    }
+
+    if (c1 == 7) {
+        normalize(fr);
+        plhm_frame_update_euler(fr);
+    }
+}
+
+#undef LD
+#undef ST
+#undef ADD
+#undef SUB
+#undef MUL
+#undef DIV
+#undef SET
+#undef SEL
+#else
+void plhm_filter_apply(plhm_filter_t *f, plhm_frame_t *fr)
+{
+    plhm_filter_apply_scalar(f, fr);
+}
+#endif
@@ -0,0 +1,333 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "plhm_frame.h"
+
+#define DEG2RAD(x) ((x) * (float)(M_PI / 180.0))
+#define RAD2DEG(x) ((x) * (float)(180.0 / M_PI))
+
+void plhm_frame_clear(plhm_frame_t *f)
+{
+    int i;
+    memset(f, 0, sizeof(plhm_frame_t));
+    for (i = 0; i < PLHM_FRAME_STATIONS; i++)
+        f->qw[i] = 1.0f;
+}
+
+/* Liberty angles are azimuth about z, then elevation about y, then
+ * roll about x. */
+void plhm_euler_to_quat(const float euler[3], float q[4])
+{
+    float cy = cosf(DEG2RAD(euler[0]) * 0.5f);
+    float sy = sinf(DEG2RAD(euler[0]) * 0.5f);
+    float cp = cosf(DEG2RAD(euler[1]) * 0.5f);
+    float sp = sinf(DEG2RAD(euler[1]) * 0.5f);
+    float cr = cosf(DEG2RAD(euler[2]) * 0.5f);
+    float sr = sinf(DEG2RAD(euler[2]) * 0.5f);
+
+    q[0] = cr * cp * cy + sr * sp * sy;
+    q[1] = sr * cp * cy - cr * sp * sy;
+    q[2] = cr * sp * cy + sr * cp * sy;
+    q[3] = cr * cp * sy - sr * sp * cy;
+}
+
+void plhm_quat_to_euler(const float q[4], float euler[3])
+{
+    float w = q[0], x = q[1], y = q[2], z = q[3];
+    float sp = 2.0f * (w * y - z * x);
+    if (sp > 1.0f) sp = 1.0f;
+    if (sp < -1.0f) sp = -1.0f;
+
+    euler[0] = RAD2DEG(atan2f(2.0f * (w * z + x * y),
+                              1.0f - 2.0f * (y * y + z * z)));
+    euler[1] = RAD2DEG(asinf(sp));
+    euler[2] = RAD2DEG(atan2f(2.0f * (w * x + y * z),
+                              1.0f - 2.0f * (x * x + y * y)));
+}
+
+int plhm_frame_from_records(plhm_frame_t *f, const plhm_record_t *recs, int n)
+{
+    int i, s, top = 0;
+    float q[4];
+
+    f->station_mask = 0;
+    f->fields = 0;
+    for (i = 0; i < n; i++)
+    {
+        const plhm_record_t *r = &recs[i];
+        s = r->station - 1;
+        if (s < 0 || s >= PLHM_FRAME_STATIONS)
+            continue;
+
+        f->fields = r->fields;
+        f->station_mask |= 1 << s;
+        if (s >= top)
+            top = s + 1;
+
+        if (r->fields & PLHM_DATA_POSITION) {
+            f->px[s] = r->position[0];
+            f->py[s] = r->position[1];
+            f->pz[s] = r->position[2];
+        }
+
+        if (r->fields & PLHM_DATA_EULER) {
+            f->azimuth[s] = r->euler[0];
+            f->elevation[s] = r->euler[1];
+            f->roll[s] = r->euler[2];
+            plhm_euler_to_quat(r->euler, q);
+            f->qw[s] = q[0];
+            f->qx[s] = q[1];
+            f->qy[s] = q[2];
+            f->qz[s] = q[3];
+        }
+
+        f->timestamp[s] = r->timestamp;
+        f->readtime[s] = (r->readtime.tv_sec * 1000.0)
+            + (r->readtime.tv_usec / 1000.0);
+        f->error[s] = r->error;
+    }
+
+    f->lanes = (top + 3) & ~3;
+    return 0;
+}
+
+int plhm_frame_to_records(const plhm_frame_t *f, plhm_record_t *recs)
+{
+    int s, n = 0;
+
+    for (s = 0; s < PLHM_FRAME_STATIONS; s++)
+    {
+        plhm_record_t *r = &recs[n];
+        if (!(f->station_mask & (1 << s)))
+            continue;
+
+        r->fields = f->fields;
+        r->station = s + 1;
+        r->error = f->error[s];
+        r->position[0] = f->px[s];
+        r->position[1] = f->py[s];
+        r->position[2] = f->pz[s];
+        r->euler[0] = f->azimuth[s];
+        r->euler[1] = f->elevation[s];
+        r->euler[2] = f->roll[s];
+        r->timestamp = f->timestamp[s];
+        r->readtime.tv_sec = (time_t)(f->readtime[s] / 1000.0);
+        r->readtime.tv_usec = (suseconds_t)
+            ((f->readtime[s] - r->readtime.tv_sec * 1000.0) * 1000.0);
+        n++;
+    }
+    return n;
+}
+
+void plhm_frame_update_euler(plhm_frame_t *f)
+{
+    float q[4], e[3];
+    int i;
+    for (i = 0; i < f->lanes; i++)
+    {
+        q[0] = f->qw[i];
+        q[1] = f->qx[i];
+        q[2] = f->qy[i];
+        q[3] = f->qz[i];
+        plhm_quat_to_euler(q, e);
+        f->azimuth[i] = e[0];
+        f->elevation[i] = e[1];
+        f->roll[i] = e[2];
+    }
+}
+
+void plhm_transform_identity(plhm_transform_t *t)
+{
+    int i, r, c;
+    memset(t, 0, sizeof(plhm_transform_t));
+    for (i = 0; i < PLHM_FRAME_STATIONS; i++) {
+        for (r = 0; r < 3; r++)
+            for (c = 0; c < 4; c++)
+                t->m[r][c][i] = (r == c) ? 1.0f : 0.0f;
+        t->qw[i] = 1.0f;
+    }
+}
+
+int plhm_transform_set_quat(plhm_transform_t *t, int station,
+                            const float q[4], const float translation[3],
+                            float scale)
+{
+    int i = station - 1;
+    float w = q[0], x = q[1], y = q[2], z = q[3];
+    float norm = sqrtf(w*w + x*x + y*y + z*z);
+
+    if (i < 0 || i >= PLHM_FRAME_STATIONS || norm == 0.0f)
+        return 1;
+
+    w /= norm; x /= norm; y /= norm; z /= norm;
+    t->qw[i] = w;
+    t->qx[i] = x;
+    t->qy[i] = y;
+    t->qz[i] = z;
+
+    t->m[0][0][i] = scale * (1 - 2*(y*y + z*z));
+    t->m[0][1][i] = scale * (2*(x*y - w*z));
+    t->m[0][2][i] = scale * (2*(x*z + w*y));
+    t->m[1][0][i] = scale * (2*(x*y + w*z));
+    t->m[1][1][i] = scale * (1 - 2*(x*x + z*z));
+    t->m[1][2][i] = scale * (2*(y*z - w*x));
+    t->m[2][0][i] = scale * (2*(x*z - w*y));
+    t->m[2][1][i] = scale * (2*(y*z + w*x));
+    t->m[2][2][i] = scale * (1 - 2*(x*x + y*y));
+
+    t->m[0][3][i] = translation[0];
+    t->m[1][3][i] = translation[1];
+    t->m[2][3][i] = translation[2];
+    return 0;
+}
+
+int plhm_transform_set_matrix(plhm_transform_t *t, int station,
+                              const float m[16])
+{
+    float r[3][3], q[4], tr, s;
+    float scale = sqrtf(m[0]*m[0] + m[4]*m[4] + m[8]*m[8]);
+    float translation[3] = { m[3], m[7], m[11] };
+    int i, j;
+
+    if (scale == 0.0f)
+        return 1;
+
+    for (i = 0; i < 3; i++)
+        for (j = 0; j < 3; j++)
+            r[i][j] = m[i*4 + j] / scale;
+
+    // rotation matrix to quaternion
+    tr = r[0][0] + r[1][1] + r[2][2];
+    if (tr > 0) {
+        s = sqrtf(tr + 1.0f) * 2;
+        q[0] = 0.25f * s;
+        q[1] = (r[2][1] - r[1][2]) / s;
+        q[2] = (r[0][2] - r[2][0]) / s;
+        q[3] = (r[1][0] - r[0][1]) / s;
+    } else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+        s = sqrtf(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2;
+        q[0] = (r[2][1] - r[1][2]) / s;
+        q[1] = 0.25f * s;
+        q[2] = (r[0][1] + r[1][0]) / s;
+        q[3] = (r[0][2] + r[2][0]) / s;
+    } else if (r[1][1] > r[2][2]) {
+        s = sqrtf(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2;
+        q[0] = (r[0][2] - r[2][0]) / s;
+        q[1] = (r[0][1] + r[1][0]) / s;
+        q[2] = 0.25f * s;
+        q[3] = (r[1][2] + r[2][1]) / s;
+    } else {
+        s = sqrtf(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2;
+        q[0] = (r[1][0] - r[0][1]) / s;
+        q[1] = (r[0][2] + r[2][0]) / s;
+        q[2] = (r[1][2] + r[2][1]) / s;
+        q[3] = 0.25f * s;
+    }
+
+    return plhm_transform_set_quat(t, station, q, translation, scale);
+}
+
+void plhm_frame_transform_scalar(plhm_frame_t *f, const plhm_transform_t *t)
+{
+    int i;
+
+    if (f->fields & PLHM_DATA_POSITION)
+    {
+        for (i = 0; i < f->lanes; i++)
+        {
+            float x = f->px[i], y = f->py[i], z = f->pz[i];
+            f->px[i] = (t->m[0][0][i] * x + t->m[0][1][i] * y
+                        + t->m[0][2][i] * z + t->m[0][3][i]);
+            f->py[i] = (t->m[1][0][i] * x + t->m[1][1][i] * y
+                        + t->m[1][2][i] * z + t->m[1][3][i]);
+            f->pz[i] = (t->m[2][0][i] * x + t->m[2][1][i] * y
+                        + t->m[2][2][i] * z + t->m[2][3][i]);
+        }
+    }
+
+    if (f->fields & PLHM_DATA_EULER)
+    {
+        for (i = 0; i < f->lanes; i++)
+        {
+            float w = f->qw[i], x = f->qx[i], y = f->qy[i], z = f->qz[i];
+            float rw = t->qw[i], rx = t->qx[i], ry = t->qy[i], rz = t->qz[i];
+            f->qw[i] = rw * w - rx * x - ry * y - rz * z;
+            f->qx[i] = rw * x + rx * w + ry * z - rz * y;
+            f->qy[i] = rw * y - rx * z + ry * w + rz * x;
+            f->qz[i] = rw * z + rx * y - ry * x + rz * w;
+        }
+    }
+}
+
+#ifdef __SSE__
+#define LD(a) _mm_load_ps(&(a)[i])
+#define ST(a,v) _mm_store_ps(&(a)[i], (v))
+#define ADD _mm_add_ps
+#define SUB _mm_sub_ps
+#define MUL _mm_mul_ps
+
+void plhm_frame_transform(plhm_frame_t *f, const plhm_transform_t *t)
+{
+    int i;
+
+    if (f->fields & PLHM_DATA_POSITION)
+    {
+        for (i = 0; i < f->lanes; i += 4)
+        {
+            __m128 x = LD(f->px), y = LD(f->py), z = LD(f->pz);
+            ST(f->px, ADD(ADD(MUL(LD(t->m[0][0]), x), MUL(LD(t->m[0][1]), y)),
+                          ADD(MUL(LD(t->m[0][2]), z), LD(t->m[0][3]))));
+            ST(f->py, ADD(ADD(MUL(LD(t->m[1][0]), x), MUL(LD(t->m[1][1]), y)),
+                          ADD(MUL(LD(t->m[1][2]), z), LD(t->m[1][3]))));
+            ST(f->pz, ADD(ADD(MUL(LD(t->m[2][0]), x), MUL(LD(t->m[2][1]), y)),
+                          ADD(MUL(LD(t->m[2][2]), z), LD(t->m[2][3]))));
+        }
+    }
+
+    if (f->fields & PLHM_DATA_EULER)
+    {
+        for (i = 0; i < f->lanes; i += 4)
+        {
+            __m128 w = LD(f->qw), x = LD(f->qx), y = LD(f->qy), z = LD(f->qz);
+            __m128 rw = LD(t->qw), rx = LD(t->qx);
+            __m128 ry = LD(t->qy), rz = LD(t->qz);
+            ST(f->qw, SUB(SUB(MUL(rw, w), MUL(rx, x)),
+                          ADD(MUL(ry, y), MUL(rz, z))));
+            ST(f->qx, ADD(ADD(MUL(rw, x), MUL(rx, w)),
+                          SUB(MUL(ry, z), MUL(rz, y))));
+            ST(f->qy, ADD(SUB(MUL(rw, y), MUL(rx, z)),
+                          ADD(MUL(ry, w), MUL(rz, x))));
+            ST(f->qz, ADD(ADD(MUL(rw, z), MUL(rx, y)),
+                          SUB(MUL(rz, w), MUL(ry, x))));
+        }
+    }
+}
+
+#undef LD
+#undef ST
+#undef ADD
+#undef SUB
+#undef MUL
+#else
+void plhm_frame_transform(plhm_frame_t *f, const plhm_transform_t *t)
+{
+    plhm_frame_transform_scalar(f, t);
+}
+#endif
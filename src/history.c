@@ -0,0 +1,313 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "plhm_history.h"
+#include "segment.h"
+
+static size_t history_size(uint32_t capacity)
+{
+    return sizeof(plhm_history_header_t)
+        + (size_t)PLHM_HISTORY_STATIONS * capacity
+          * sizeof(plhm_history_sample_t);
+}
+
+static int map(plhm_history_t *h, int prot, int flags)
+{
+    h->header = mmap(0, h->size, prot, flags, h->fd, 0);
+    if (h->header == MAP_FAILED) {
+        h->header = 0;
+        return 1;
+    }
+    h->samples = (plhm_history_sample_t*)(h->header + 1);
+    return 0;
+}
+
+int plhm_history_create(plhm_history_t *h, const char *name, int capacity)
+{
+    uint32_t cap = 1;
+
+    memset(h, 0, sizeof(plhm_history_t));
+    h->fd = -1;
+    if (capacity < 2 || capacity > (1 << 24))
+        return 1;
+    while (cap < (uint32_t)capacity)
+        cap <<= 1;
+    h->size = history_size(cap);
+
+    if (!name) {
+        if (map(h, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS)) {
+            perror("mmap");
+            return 1;
+        }
+    }
+    else {
+        strncpy(h->name, name, sizeof(h->name)-1);
+        h->fd = plhm_segment_create(h->name);
+        if (h->fd == -1) {
+            if (errno == EBUSY)
+                printf("Shared memory %s is in use by another plhm.\n",
+                       h->name);
+            else {
+                printf("Could not create shared memory %s.\n", h->name);
+                perror("shm_open");
+            }
+            return 1;
+        }
+        if (ftruncate(h->fd, h->size)
+            || map(h, PROT_READ | PROT_WRITE, MAP_SHARED))
+        {
+            perror("plhm_history_create");
+            close(h->fd);
+            shm_unlink(h->name);
+            return 1;
+        }
+        memset(h->header, 0, sizeof(plhm_history_header_t));
+    }
+
+    h->header->version = PLHM_HISTORY_VERSION;
+    h->header->capacity = cap;
+    __atomic_store_n(&h->header->magic, PLHM_HISTORY_MAGIC, __ATOMIC_RELEASE);
+    h->writer = 1;
+    return 0;
+}
+
+void plhm_history_add(plhm_history_t *h, const plhm_record_t *recs, int n)
+{
+    plhm_history_header_t *hd = h->header;
+    uint32_t mask = hd->capacity - 1;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        const plhm_record_t *r = &recs[i];
+        plhm_history_sample_t *base, *s;
+        uint64_t w;
+        double t;
+
+        if (r->station < 1 || r->station > PLHM_HISTORY_STATIONS)
+            continue;
+        base = h->samples + (size_t)(r->station - 1) * hd->capacity;
+        w = hd->written[r->station - 1];
+
+        // keep the ring sorted for the binary search
+        t = r->readtime.tv_sec * 1000.0 + r->readtime.tv_usec / 1000.0;
+        if (w > 0 && t < base[(w - 1) & mask].time)
+            t = base[(w - 1) & mask].time;
+
+        s = &base[w & mask];
+        s->time = t;
+        memcpy(s->position, r->position, sizeof(s->position));
+        memcpy(s->euler, r->euler, sizeof(s->euler));
+        s->timestamp = r->timestamp;
+        s->error = r->error;
+        hd->fields = r->fields;
+
+        __atomic_store_n(&hd->written[r->station - 1], w + 1,
+                         __ATOMIC_RELEASE);
+        // and before the next slot is replaced, or a reader could see it
+        // change while the count still says it is kept
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+}
+
+int plhm_history_open(plhm_history_t *h, const char *name)
+{
+    plhm_history_header_t *hd;
+    struct stat st;
+
+    memset(h, 0, sizeof(plhm_history_t));
+    strncpy(h->name, name ? name : PLHM_HISTORY_DEFAULT_NAME,
+            sizeof(h->name)-1);
+
+    h->fd = shm_open(h->name, O_RDONLY, 0);
+    if (h->fd == -1)
+        return 1;
+
+    if (fstat(h->fd, &st)
+        || st.st_size < (off_t)sizeof(plhm_history_header_t))
+    {
+        plhm_history_close(h);
+        return 1;
+    }
+    h->size = st.st_size;
+    if (map(h, PROT_READ, MAP_SHARED)) {
+        plhm_history_close(h);
+        return 1;
+    }
+
+    hd = h->header;
+    if (__atomic_load_n(&hd->magic, __ATOMIC_ACQUIRE) != PLHM_HISTORY_MAGIC
+        || hd->version != PLHM_HISTORY_VERSION
+        || history_size(hd->capacity) != h->size)
+    {
+        printf("Shared memory %s is not a plhm history.\n", h->name);
+        plhm_history_close(h);
+        return 2;
+    }
+    return 0;
+}
+
+/* Samples i with oldest <= i < written are intact, so long as written
+ * has not moved on.  The slot of written - capacity may be being
+ * replaced at this moment, so it is not counted. */
+static uint64_t oldest_kept(uint64_t written, uint32_t capacity)
+{
+    return written >= capacity ? written - capacity + 1 : 0;
+}
+
+int plhm_history_bounds(const plhm_history_t *h, int station,
+                        double *oldest, double *newest)
+{
+    plhm_history_sample_t s[1];
+    uint64_t i, w;
+    int n = 0;
+
+    if (station < 1 || station > PLHM_HISTORY_STATIONS)
+        return 0;
+
+    w = __atomic_load_n(&h->header->written[station - 1], __ATOMIC_ACQUIRE);
+    i = oldest_kept(w, h->header->capacity);
+    if (i < w && oldest && plhm_history_read(h, station, &i, s, 1) == 1)
+        *oldest = s->time;
+
+    i = w > 0 ? w - 1 : 0;
+    if (w > 0 && plhm_history_read(h, station, &i, s, 1) == 1) {
+        if (newest)
+            *newest = s->time;
+        n = w - oldest_kept(w, h->header->capacity);
+    }
+    return n;
+}
+
+/* The first sample at or after time, or after it if strict. */
+static uint64_t search(const plhm_history_t *h, int station, double time,
+                       int strict)
+{
+    const plhm_history_sample_t *base;
+    uint32_t mask = h->header->capacity - 1;
+    uint64_t lo, hi, mid;
+
+    if (station < 1 || station > PLHM_HISTORY_STATIONS)
+        return 0;
+    base = h->samples + (size_t)(station - 1) * h->header->capacity;
+
+    hi = __atomic_load_n(&h->header->written[station - 1], __ATOMIC_ACQUIRE);
+    lo = oldest_kept(hi, h->header->capacity);
+
+    // first sample at or after time; a sample replaced during the
+    // search can only misplace the result, which the read then checks
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (base[mid & mask].time < time
+            || (strict && base[mid & mask].time == time))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+uint64_t plhm_history_seek(const plhm_history_t *h, int station,
+                           double time)
+{
+    return search(h, station, time, 0);
+}
+
+int plhm_history_read(const plhm_history_t *h, int station,
+                      uint64_t *index, plhm_history_sample_t *out, int max)
+{
+    const plhm_history_sample_t *base;
+    uint32_t cap = h->header->capacity, mask = cap - 1;
+    uint64_t w, first, i;
+    int n, lost;
+
+    if (station < 1 || station > PLHM_HISTORY_STATIONS)
+        return -1;
+    if (max < 1)
+        return 0;
+    base = h->samples + (size_t)(station - 1) * cap;
+
+    w = __atomic_load_n(&h->header->written[station - 1], __ATOMIC_ACQUIRE);
+    first = *index;
+    if (first < oldest_kept(w, cap))
+        first = oldest_kept(w, cap);
+    if (first > w)
+        first = w;
+    n = w - first < (uint64_t)max ? (int)(w - first) : max;
+
+    // in at most two pieces around the end of the ring
+    i = first & mask;
+    if (i + n <= cap)
+        memcpy(out, &base[i], n * sizeof(plhm_history_sample_t));
+    else {
+        memcpy(out, &base[i], (cap - i) * sizeof(plhm_history_sample_t));
+        memcpy(out + cap - i, base,
+               (n - (cap - i)) * sizeof(plhm_history_sample_t));
+    }
+
+    // drop whatever the writer replaced while we copied
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    w = __atomic_load_n(&h->header->written[station - 1], __ATOMIC_RELAXED);
+    if (first < oldest_kept(w, cap)) {
+        lost = oldest_kept(w, cap) - first;
+        if (lost > n)
+            lost = n;
+        memmove(out, out + lost, (n - lost) * sizeof(plhm_history_sample_t));
+        first += lost;
+        n -= lost;
+    }
+
+    *index = first + n;
+    return n;
+}
+
+int plhm_history_range(const plhm_history_t *h, int station,
+                       double from, double to,
+                       plhm_history_sample_t *out, int max)
+{
+    uint64_t i = search(h, station, from, 0);
+    uint64_t end = search(h, station, to, 1);
+    int n;
+
+    if (end <= i)
+        return station < 1 || station > PLHM_HISTORY_STATIONS ? -1 : 0;
+    if (end - i < (uint64_t)max)
+        max = end - i;
+    n = plhm_history_read(h, station, &i, out, max);
+
+    // the start may have moved on if the writer replaced it
+    while (n > 0 && out[n-1].time > to)
+        n--;
+    return n;
+}
+
+int plhm_history_close(plhm_history_t *h)
+{
+    if (h->header)
+        munmap(h->header, h->size);
+    if (h->fd >= 0)
+        close(h->fd);
+    if (h->writer && h->fd >= 0)
+        shm_unlink(h->name);
+    h->header = 0;
+    h->samples = 0;
+    h->fd = -1;
+    return 0;
+}
@@ -18,8 +18,42 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <ctype.h>
+#include <poll.h>
+#include <time.h>
+#include <stdarg.h>
 
 #include "plhm.h"
+#include "uring.h"
+
+static void command(plhm_t *p, const char *cmd);
+
+/* Print an error about the data, at most once a second so that a
+ * faulty sensor cannot flood the output or slow acquisition. */
+static void report(plhm_t *p, const char *fmt, ...)
+{
+    time_t now = time(0);
+    va_list ap;
+
+    if (now == p->error_time) {
+        p->errors_held++;
+        return;
+    }
+    if (p->errors_held)
+        printf("(%lu more errors)\n", p->errors_held);
+    p->error_time = now;
+    p->errors_held = 0;
+
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+}
+
+static unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
 
 #ifdef DEBUG
 static void traceit(const char* str, const char* prefix)
@@ -115,6 +149,7 @@ int plhm_read_until_timeout(plhm_t *p, int ms)
     // TODO: check if anything is in p->buffer
 
     int rc, count=0, pos=0;
+    plhm_uring_stop(p);
     while (count++ < (ms/5))
     {
         rc = read(p->rd, p->response+pos, plhm_rsp_max);
@@ -148,12 +183,64 @@ int plhm_read_until_timeout(plhm_t *p, int ms)
     return 1;
 }
 
+/* Append whatever input is available to p->buffer, waiting up to ms
+ * for some to arrive.  Returns the number of bytes added, 0 on
+ * timeout, or -1 on error. */
+static int fill_buffer(plhm_t *p, int ms)
+{
+    struct pollfd pfd;
+    int rc, tries;
+
+    if (p->uring)
+        return plhm_uring_fill(p, ms);
+
+    for (tries = 0; tries < 2; tries++)
+    {
+        p->input_calls++;
+        rc = read(p->rd, &p->buffer[p->pos], plhm_rsp_max - 1 - p->pos);
+        if (rc > 0) {
+            p->pos += rc;
+            return rc;
+        }
+        if (rc < 0 && errno != EAGAIN) {
+            printf("[error %d] ", errno);
+            fflush(stdout);
+            perror("read");
+            return -1;
+        }
+        if (tries)
+            break;
+
+        pfd.fd = p->rd;
+        pfd.events = POLLIN;
+        p->input_calls++;
+        rc = poll(&pfd, 1, ms);
+        if (rc == 0)
+            break;
+        if (rc < 0 && errno != EINTR) {
+            perror("poll");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int plhm_wait_input(plhm_t *p, int ms)
+{
+    int rc;
+
+    if (p->pos > 0)
+        return 1;
+    rc = fill_buffer(p, ms);
+    return rc < 0 ? -1 : rc > 0;
+}
+
 static int read_bytes(plhm_t *p, int bytes)
 {
     int rc;
     int count=0;
 
-    while (count++ < 5)
+    while (count < 5)
     {
         if (p->pos > 0) {
             if (p->pos >= bytes) {
@@ -175,25 +262,179 @@ static int read_bytes(plhm_t *p, int bytes)
             }
         }
 
-        rc = read(p->rd, &p->buffer[p->pos], plhm_rsp_max - p->pos);
-        if (rc >= 0) {
-            p->pos += rc;
-            continue;
+        // wait for input rather than sleeping, so that a record is
+        // returned as soon as it is complete
+        rc = fill_buffer(p, 100);
+        if (rc < 0)
+            return 2;
+        if (rc == 0)
+            count++;
+    }
+    p->stats.timeouts++;
+    report(p, "Timed out while reading.  Expected %d bytes, got %d.\n",
+           bytes, p->pos);
+    return 1;
+}
+
+/* Place the next line of ASCII output in p->response, without the
+ * line terminator.  Unlike read_oneline(), this waits for input
+ * so a record is returned as soon as its last byte arrives. */
+static int read_text_line(plhm_t *p, int ms)
+{
+    int rc, len;
+    char *c;
+
+    while (1)
+    {
+        c = p->pos > 0 ? memchr(p->buffer, '\n', p->pos) : 0;
+        if (c) {
+            len = c - p->buffer;
+            p->response_length = len;
+            if (len > 0 && p->buffer[len-1] == '\r')
+                p->response_length--;
+            memcpy(p->response, p->buffer, p->response_length);
+            p->response[p->response_length] = 0;
+            p->pos -= len + 1;
+            memmove(p->buffer, c + 1, p->pos);
+            tracersp(p->response);
+            return 0;
         }
-        if (errno == EAGAIN) {
-            usleep(100000);
-            continue;
+
+        if (p->pos >= plhm_rsp_max - 1) {
+            // no terminator in a full buffer, lost sync
+            trace("discarding %d bytes of unterminated text\n", p->pos);
+            p->stats.resyncs++;
+            p->pos = 0;
         }
-        else {
-            printf("[error %d] ", errno);
-            fflush(stdout);
-            perror("read");
+
+        rc = fill_buffer(p, ms);
+        if (rc < 0)
             return 2;
+        if (rc == 0) {
+            trace("Timed out while reading a text record.\n");
+            p->stats.timeouts++;
+            return 1;
         }
     }
-    printf("Timed out while reading.  Expected %d bytes, got %d.\n",
-           bytes, p->pos);
-    return 1;
+}
+
+static const double neg_pow10[] = {
+    1e0, 1e-1, 1e-2, 1e-3, 1e-4, 1e-5, 1e-6, 1e-7, 1e-8, 1e-9,
+    1e-10, 1e-11, 1e-12, 1e-13, 1e-14, 1e-15, 1e-16, 1e-17, 1e-18, 1e-19,
+};
+
+/* Parse one number from a column of ASCII output.  Columns are fixed
+ * width but may run together when the sign of the next value takes
+ * the place of the separating space, so a sign after the first digit
+ * ends the number.  Independent of locale.  Returns a pointer past
+ * the number, or null if there was none. */
+static const char *parse_number(const char *c, double *value)
+{
+    unsigned long long mantissa = 0;
+    int digits = 0, frac = 0, neg = 0, exp = 0, exp_neg = 0;
+    double v;
+
+    while (*c == ' ' || *c == '\t')
+        c++;
+
+    if (*c == '-' || *c == '+')
+        neg = (*c++ == '-');
+
+    for (; *c >= '0' && *c <= '9'; c++, digits++)
+        if (digits < 19)
+            mantissa = mantissa * 10 + (*c - '0');
+        else
+            exp++;
+
+    if (*c == '.') {
+        for (c++; *c >= '0' && *c <= '9'; c++, digits++)
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*c - '0');
+                frac++;
+            }
+    }
+
+    if (!digits)
+        return 0;
+
+    if (*c == 'e' || *c == 'E') {
+        int e = 0;
+        c++;
+        if (*c == '-' || *c == '+')
+            exp_neg = (*c++ == '-');
+        for (; *c >= '0' && *c <= '9'; c++)
+            e = e * 10 + (*c - '0');
+        exp += exp_neg ? -e : e;
+    }
+
+    v = mantissa * neg_pow10[frac];
+    for (; exp > 0; exp--)
+        v *= 10.0;
+    for (; exp < 0; exp++)
+        v *= 0.1;
+
+    *value = neg ? -v : v;
+    return c;
+}
+
+static const char *parse_floats(const char *c, float *f, int n)
+{
+    double v;
+    int i;
+    for (i = 0; i < n && c; i++) {
+        c = parse_number(c, &v);
+        f[i] = (float)v;
+    }
+    return c;
+}
+
+/* An ASCII record is a header of station number, initiating command
+ * and error indicator, followed by the requested fields in the same
+ * order as in binary mode. */
+static int parse_text_record(plhm_t *p, plhm_record_t *r)
+{
+    const char *c;
+    double v;
+
+    r->fields = p->fields;
+
+    c = p->response;
+    while (*c == ' ')
+        c++;
+    if (*c < '0' || *c > '9') {
+        trace("text record expected, got: %s\n", p->response);
+        return 1;
+    }
+    for (r->station = 0; *c >= '0' && *c <= '9'; c++)
+        r->station = r->station * 10 + (*c - '0');
+
+    // skip initiating command
+    if (*c)
+        c++;
+
+    r->error = *c ? *c++ : ' ';
+    if (r->error != ' ') {
+        p->stats.station_errors++;
+        report(p, "error %d ('%c') detected for station %d.\n",
+               r->error, r->error, r->station);
+    }
+
+    if (c && (p->fields & PLHM_DATA_POSITION))
+        c = parse_floats(c, r->position, 3);
+
+    if (c && (p->fields & PLHM_DATA_EULER))
+        c = parse_floats(c, r->euler, 3);
+
+    if (c && (p->fields & PLHM_DATA_TIMESTAMP)) {
+        c = parse_number(c, &v);
+        r->timestamp = (unsigned int)v;
+    }
+
+    if (!c) {
+        trace("text record for station %d is missing fields\n", r->station);
+        return 1;
+    }
+    return 0;
 }
 
 int plhm_open_device(plhm_t *p, const char *device)
@@ -234,6 +475,9 @@ int plhm_open_device(plhm_t *p, const char *device)
     }
 
     p->device_open = 1;
+
+    if (p->input == PLHM_INPUT_URING)
+        plhm_set_input(p, PLHM_INPUT_URING);
     return 0;
 }
 
@@ -242,6 +486,8 @@ int plhm_close_device(plhm_t *p)
     if (!p->device_open)
         return 0;
 
+    plhm_uring_free(p);
+
     // restore the original attributes
     tcsetattr(p->rd, TCSANOW, &p->initialAtt);
 
@@ -252,6 +498,34 @@ int plhm_close_device(plhm_t *p)
     return 0;
 }
 
+plhm_t *plhm_new(void)
+{
+    return calloc(1, sizeof(plhm_t));
+}
+
+void plhm_delete(plhm_t *p)
+{
+    if (!p)
+        return;
+    plhm_close_device(p);
+    free(p);
+}
+
+int plhm_set_input(plhm_t *p, plhm_input input)
+{
+    if (input == PLHM_INPUT_URING) {
+        if (plhm_uring_start(p)) {
+            printf("io_uring is not available, reading with read().\n");
+            p->input = PLHM_INPUT_READ;
+            return 1;
+        }
+    }
+    else
+        plhm_uring_free(p);
+    p->input = input;
+    return 0;
+}
+
 int plhm_is_initialized(plhm_t *p)
 {
     return p->device_open;
@@ -274,7 +548,7 @@ int plhm_find_device(const char *device)
     return 0;
 }
 
-void command(plhm_t *p, const char *cmd)
+static void command(plhm_t *p, const char *cmd)
 {
     tracecmd(cmd);
     write(p->wr, cmd, strlen(cmd));
@@ -310,88 +584,158 @@ typedef union {
     const unsigned char *uc;
 } multiptr;
 
-int plhm_read_data_record(plhm_t *p, plhm_record_t *r)
+/* Bytes of a binary record with the given fields: the header, which
+ * the Liberty always sends, and each field. */
+static int record_bytes(int fields)
+{
+    int bytes = 8;
+    if (fields & PLHM_DATA_POSITION)
+        bytes += 12;
+    if (fields & PLHM_DATA_EULER)
+        bytes += 12;
+    if (fields & PLHM_DATA_TIMESTAMP)
+        bytes += 4;
+    if (fields & PLHM_DATA_CRLF)
+        bytes += 2;
+    return bytes;
+}
+
+/* After a record that does not start with a header, put back what
+ * follows it from the next "LY", so that reading continues at a
+ * record boundary instead of failing on every record after it. */
+static void resync(plhm_t *p, const char *record)
+{
+    const char *c = record + 1, *end = p->response + p->response_length;
+    int keep;
+
+    while (c < end && !(c[0] == 'L' && (c + 1 == end || c[1] == 'Y')))
+        c++;
+    keep = end - c;
+    if (p->pos + keep >= plhm_rsp_max - 1)
+        keep = 0;
+    memmove(p->buffer + keep, p->buffer, p->pos);
+    memcpy(p->buffer, c, keep);
+    p->pos += keep;
+    p->stats.resyncs++;
+}
+
+/* Check the header of a binary record.  Returns 1 if it is not one. */
+static int check_record(plhm_t *p, const char *c, int bytes)
+{
+    short size;
+
+    if (strncmp(c, "LY", 2)) {
+        report(p, "LY expected, got %c%c.\n", c[0], c[1]);
+        resync(p, c);
+        return 1;
+    }
+    trace("station %d\n", c[2]);
+
+    // c[3] is the initiating command
+    if (c[4] != ' ') {
+        p->stats.station_errors++;
+        report(p, "error %d ('%c') detected for station %d.\n",
+               c[4], c[4], c[2]);
+    }
+
+    // c[5] is reserved
+    memcpy(&size, c + 6, sizeof(size));
+    trace("size: %d\n", size);
+    if (size != (bytes - 8))
+        report(p, "error: size of record is %d, expected %d.\n",
+               size, bytes - 8);
+    return 0;
+}
+
+static int decode_record(plhm_t *p, plhm_record_t *r)
 {
-    int rc, bytes;
     multiptr data;
 
-    if (p->binary) {
-        bytes = 0;
-        if (p->fields & PLHM_DATA_POSITION)
-            bytes += 20;
-        if (p->fields & PLHM_DATA_EULER)
-            bytes += 12;
-        if (p->fields & PLHM_DATA_TIMESTAMP)
-            bytes += 4;
-        if (p->fields & PLHM_DATA_CRLF)
-            bytes += 2;
+    r->fields = p->fields;
+    data.c = p->response;
 
-        rc = read_bytes(p, bytes);
-        if (rc) return rc;
+    if (check_record(p, data.c, p->response_length))
+        return 1;
+    r->station = data.c[2];
+    r->error = data.c[4];
+    data.c += 8;
 
-        gettimeofday(&r->readtime, NULL);
+    if (p->fields & PLHM_DATA_POSITION) {
+        r->position[0] = *data.f++;
+        r->position[1] = *data.f++;
+        r->position[2] = *data.f++;
+    }
 
-        r->fields = p->fields;
-        data.c = p->response;
+    if (p->fields & PLHM_DATA_EULER) {
+        r->euler[0] = *data.f++;
+        r->euler[1] = *data.f++;
+        r->euler[2] = *data.f++;
+    }
 
-        if (p->response_length != bytes) {
-            trace("response not the expected length.  got %d bytes, "
-                  "but expected %d\n", p->response_length, bytes);
-            return 1;
-        }
+    if (p->fields & PLHM_DATA_TIMESTAMP) {
+        r->timestamp = *data.ui++;
+    }
 
-        if (strncmp(data.c, "LY", 2)) {
-            printf("LY expected, got %c%c.\n",
-                   ((*data.s >> 0) & 0xFF),
-                   ((*data.s >> 8) & 0xFF));
-            return 1;
-        }
-        data.c += 2;
-
-        r->station = *data.c;
-        trace("station %d\n", r->station);
-        data.c += 1;
-
-        // skip initiating command
-        data.c += 1;
-
-        r->error = *data.c;
-        if (r->error != ' ')
-            printf("error %d ('%c') detected for station %d.\n",
-                   r->error, r->error, r->station);
-        data.c += 1;
-
-        // skip reserved byte
-        data.c += 1;
-
-        int size = *data.s;
-        trace("size: %d\n", size);
-        if (size != (bytes - 8))
-            printf("error: size of record is %d, expected %d.\n",
-                   size, bytes - 8);
-        data.s += 1;
-
-        if (p->fields & PLHM_DATA_POSITION) {
-            r->position[0] = *data.f++;
-            r->position[1] = *data.f++;
-            r->position[2] = *data.f++;
-        }
+    // cr/lf follows
+    return 0;
+}
 
-        if (p->fields & PLHM_DATA_EULER) {
-            r->euler[0] = *data.f++;
-            r->euler[1] = *data.f++;
-            r->euler[2] = *data.f++;
-        }
+int plhm_read_data_record(plhm_t *p, plhm_record_t *r)
+{
+    unsigned long long start;
+    int rc;
+
+    if (p->binary)
+        rc = read_bytes(p, record_bytes(p->fields));
+    else {
+        do {
+            rc = read_text_line(p, 100);
+        } while (!rc && p->response_length == 0);
+    }
+    if (rc) return rc;
+
+    gettimeofday(&r->readtime, NULL);
+
+    start = now_ns();
+    rc = p->binary ? decode_record(p, r) : parse_text_record(p, r);
+    p->stats.decode_ns += now_ns() - start;
+
+    if (rc)
+        p->stats.parse_errors++;
+    else
+        p->stats.records++;
+    // text lines also carried cr/lf
+    p->stats.bytes += p->response_length + (p->binary ? 0 : 2);
+    return rc;
+}
+
+int plhm_read_raw_records(plhm_t *p, int n, const char **data,
+                          struct timeval *readtime)
+{
+    unsigned long long start;
+    int rc, i, bytes = record_bytes(p->fields);
+
+    if (!p->binary || n < 1 || n * bytes >= plhm_rsp_max)
+        return 1;
+
+    rc = read_bytes(p, n * bytes);
+    if (rc) return rc;
 
-        if (p->fields & PLHM_DATA_TIMESTAMP) {
-            r->timestamp = *data.ui++;
+    if (readtime)
+        gettimeofday(readtime, NULL);
+
+    start = now_ns();
+    for (i = 0; i < n; i++)
+        if (check_record(p, p->response + i * bytes, bytes)) {
+            p->stats.parse_errors++;
+            p->stats.decode_ns += now_ns() - start;
+            return 1;
         }
+    p->stats.records += n;
+    p->stats.bytes += n * bytes;
+    p->stats.decode_ns += now_ns() - start;
 
-        // skip cr/lf
-        if (p->fields & PLHM_DATA_CRLF)
-            data.c += 2;
-    } else
-        return plhm_read_until_timeout(p, 100);
+    *data = p->response;
     return 0;
 }
 
@@ -408,24 +752,102 @@ int plhm_data_request_continuous(plhm_t *p)
     return 0;
 }
 
+int plhm_pause_continuous(plhm_t *p)
+{
+    int rc, quiet=0, count=0;
+
+    // 'P' ends continuous output; records already in flight are
+    // discarded so that the next read starts on a record boundary.
+    command(p, "P");
+    plhm_uring_stop(p);
+    p->pos = 0;
+    while (quiet < 4 && count++ < 100)
+    {
+        rc = read(p->rd, p->buffer, plhm_rsp_max);
+        if (rc > 0) {
+            quiet = 0;
+            continue;
+        }
+        if (rc < 0 && errno != EAGAIN) {
+            perror("read");
+            return 2;
+        }
+        quiet++;
+        usleep(5000);
+    }
+    return 0;
+}
+
+int plhm_resume_continuous(plhm_t *p)
+{
+    p->pos = 0;
+    command(p, "C\r");
+    return 0;
+}
+
 int plhm_get_stations(plhm_t *p)
 {
-    // check which stations are plugged in for now, we'll assume
-    // stations are plugged in from left to right, and that there
-    // are only 8 max stations.
-    for (p->stations=0; p->stations<8; p->stations++) {
-        int rc = plhm_get_station_info(p, p->stations);
-        if (rc < 0)
+    int station, rc;
+
+    // Sensors may be plugged into any of the 16 ports of a Liberty,
+    // so ask about each.  Units with 8 ports do not answer for port 9
+    // at all, and there is no need to wait for the rest; a unit that
+    // answers for it answers for every port.
+    p->stations = 0;
+    p->station_mask = 0;
+    for (station = 0; station < 16; station++) {
+        rc = plhm_get_station_info(p, station);
+        if (rc > 0 && station == 8)
             break;
         else if (rc > 0)
             return rc;
+        else if (rc == 0) {
+            p->station_mask |= 1 << station;
+            p->stations++;
+        }
     }
+    p->detected_mask = p->station_mask;
     if (p->stations == 0) {
         printf("No stations detected.\n");
         return 1;
     }
     else
-        trace("%d station%s detected.\n", p->stations, p->stations>1?"s":"");
+        trace("%d station%s detected, mask 0x%x.\n", p->stations,
+              p->stations>1?"s":"", p->station_mask);
+    return 0;
+}
+
+int plhm_set_station_active(plhm_t *p, int station, int active)
+{
+    char cmd[50];
+    if (station < 0 || station >= 16) {
+        printf("Invalid station %d.\n", station+1);
+        return 1;
+    }
+    // the record count per frame follows the active stations, so only
+    // those with a sensor can be switched on, and one must stay on
+    if (active && !(p->detected_mask & (1 << station))) {
+        printf("No sensor at station %d.\n", station+1);
+        return 1;
+    }
+    if (!active && p->station_mask == (1 << station)) {
+        printf("Station %d is the last active.\n", station+1);
+        return 1;
+    }
+    sprintf(cmd, "\x15%d,%d\r", station+1, active ? 1 : 0);
+    command(p, cmd);
+    // no response
+
+    if (active)
+        p->station_mask |= 1 << station;
+    else
+        p->station_mask &= ~(1 << station);
+
+    // records arrive only for active stations
+    p->stations = 0;
+    for (station=0; station<16; station++)
+        if (p->station_mask & (1 << station))
+            p->stations++;
     return 0;
 }
 
@@ -493,9 +915,99 @@ int plhm_set_rate(plhm_t *p, plhm_rate rate)
         break;
     default:
         printf("Unknown rate specified.\n");
-        break;
+        return 1;
     }
     // no response
+    p->rate_hz = plhm_rate_hz(rate);
+    return 0;
+}
+
+int plhm_rate_hz(plhm_rate rate)
+{
+    switch (rate)
+    {
+    case PLHM_RATE_120: return 120;
+    case PLHM_RATE_240: return 240;
+    default: return 0;
+    }
+}
+
+int plhm_get_link(const plhm_t *p, plhm_link_t *l)
+{
+    *l = p->link;
+    l->stations = p->stations;
+    l->station_mask = p->station_mask;
+    // the Liberty starts at 240 Hz
+    l->rate_hz = p->rate_hz ? p->rate_hz : 240;
+
+    if (p->binary)
+        l->record_bytes = record_bytes(p->fields);
+    else {
+        // a header of about 5 characters, values of about 9, cr/lf
+        l->record_bytes = 7;
+        if (p->fields & PLHM_DATA_POSITION)
+            l->record_bytes += 27;
+        if (p->fields & PLHM_DATA_EULER)
+            l->record_bytes += 27;
+        if (p->fields & PLHM_DATA_TIMESTAMP)
+            l->record_bytes += 11;
+    }
+    l->required = (double)l->record_bytes * l->stations * l->rate_hz;
+    return 0;
+}
+
+int plhm_measure_link(plhm_t *p, int ms, plhm_link_t *l)
+{
+    plhm_record_t r;
+    plhm_stats_t before;
+    unsigned long long start, elapsed;
+    int rc, errors = 0;
+
+    plhm_get_link(p, l);
+    if (plhm_data_request_continuous(p))
+        return 1;
+
+    // time from the first record, once the stream has started
+    rc = plhm_read_data_record(p, &r);
+    before = p->stats;
+    start = now_ns();
+    do {
+        if (rc && ++errors > 10)
+            break;
+        rc = plhm_read_data_record(p, &r);
+        elapsed = now_ns() - start;
+    } while (elapsed < ms * 1000000ULL);
+
+    if (plhm_pause_continuous(p))
+        return 1;
+    if (errors > 10) {
+        printf("Too many errors measuring the link.\n");
+        return 1;
+    }
+
+    l->measured = (p->stats.bytes - before.bytes) * 1e9 / elapsed;
+    l->records_per_s = (p->stats.records - before.records) * 1e9 / elapsed;
+    p->link = *l;
+    return 0;
+}
+
+int plhm_choose_rate(plhm_t *p, int ms, plhm_rate *rate, plhm_link_t *l)
+{
+    static const plhm_rate rates[] = { PLHM_RATE_240, PLHM_RATE_120 };
+    int i, n = sizeof(rates) / sizeof(rates[0]);
+
+    for (i = 0; i < n; i++) {
+        if (plhm_set_rate(p, rates[i]) || plhm_measure_link(p, ms, l))
+            return 1;
+        *rate = rates[i];
+        trace("%d Hz: %.0f of %.0f bytes/s\n", l->rate_hz, l->measured,
+              l->required);
+        // a little short for the timing of the measurement
+        if (l->records_per_s >= 0.95 * l->rate_hz * l->stations)
+            return 0;
+    }
+    printf("The link carries %.0f of the %.0f bytes/s needed at %d Hz.\n",
+           l->measured, l->required, l->rate_hz);
     return 0;
 }
 
@@ -0,0 +1,311 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include "plhm_merge.h"
+
+// length of a window for tracking the device clock offset, us
+#define CLOCK_WINDOW 2000000
+
+static int64_t tv_us(const struct timeval *t)
+{
+    return (int64_t)t->tv_sec * 1000000 + t->tv_usec;
+}
+
+static void us_tv(int64_t us, struct timeval *t)
+{
+    t->tv_sec = us / 1000000;
+    t->tv_usec = us % 1000000;
+}
+
+void plhm_merge_init(plhm_merge_t *m, float window_ms)
+{
+    memset(m, 0, sizeof(plhm_merge_t));
+    m->window = (int64_t)(window_ms * 1000);
+}
+
+int plhm_merge_add_source(plhm_merge_t *m, int station_offset)
+{
+    plhm_merge_source_t *s;
+    if (m->n_sources == PLHM_MERGE_MAX_SOURCES) {
+        printf("Too many sources to merge, at most %d.\n",
+               PLHM_MERGE_MAX_SOURCES);
+        return -1;
+    }
+    s = &m->sources[m->n_sources];
+    memset(s, 0, sizeof(plhm_merge_source_t));
+    s->station_offset = station_offset;
+    s->timestamp_us = 1000;
+    return m->n_sources++;
+}
+
+void plhm_merge_set_time_offset(plhm_merge_t *m, int source, float ms)
+{
+    m->sources[source].time_offset = (int64_t)(ms * 1000);
+}
+
+void plhm_merge_set_timestamp_unit(plhm_merge_t *m, int source, int us)
+{
+    m->sources[source].timestamp_us = us;
+}
+
+void plhm_merge_set_clock(plhm_merge_t *m, float rate_hz)
+{
+    m->period = rate_hz > 0 ? (int64_t)(1e6 / rate_hz + 0.5) : 0;
+}
+
+void plhm_merge_end_source(plhm_merge_t *m, int source)
+{
+    m->sources[source].ended = 1;
+}
+
+/* Time of a record on the host clock. */
+static int64_t place(plhm_merge_source_t *s, const plhm_record_t *r)
+{
+    int64_t t = tv_us(&r->readtime) + s->time_offset, device, d;
+
+    if (!(r->fields & PLHM_DATA_TIMESTAMP))
+        return t;
+
+    if (s->synced)
+        s->ticks += (int32_t)(r->timestamp - s->last_timestamp);
+    else
+        s->ticks = r->timestamp;
+    s->last_timestamp = r->timestamp;
+    device = s->ticks * s->timestamp_us;
+    d = t - device;
+
+    if (!s->synced) {
+        s->synced = 1;
+        s->window_min = s->previous_min = d;
+        s->window_start = t;
+        s->first_clock = d;
+        s->first_time = t;
+    }
+    else if (t - s->window_start > CLOCK_WINDOW) {
+        s->previous_min = s->window_min;
+        s->window_min = d;
+        s->window_start = t;
+    }
+    else if (d < s->window_min)
+        s->window_min = d;
+
+    s->clock = (s->window_min < s->previous_min
+                ? s->window_min : s->previous_min);
+    s->last_time = t;
+
+    // how long the record took to reach us
+    d = t - (device + s->clock);
+    s->latency_sum += d;
+    s->latency_n++;
+    if (d > s->latency_max)
+        s->latency_max = d;
+
+    // a lower offset found later must not move the source backwards
+    t = device + s->clock;
+    return (s->records && t < s->latest) ? s->latest : t;
+}
+
+int plhm_merge_push(plhm_merge_t *m, int source,
+                    const plhm_record_t *recs, int n)
+{
+    plhm_merge_source_t *s = &m->sources[source];
+    int i, accepted = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        const plhm_record_t *r = &recs[i];
+        int station = r->station + s->station_offset;
+        int64_t t = place(s, r);
+        int j;
+
+        if (station < 1 || station > PLHM_FRAME_STATIONS) {
+            s->overflow++;
+            continue;
+        }
+        if (m->started && (t < m->released
+                           || (m->period && t <= m->released))) {
+            s->late++;
+            continue;
+        }
+        if (s->count == PLHM_MERGE_QUEUE) {
+            s->head = (s->head + 1) % PLHM_MERGE_QUEUE;
+            s->count--;
+            s->overflow++;
+        }
+
+        // usually in order already, so insertion from the back
+        for (j = s->count; j > 0; j--) {
+            int a = (s->head + j - 1) % PLHM_MERGE_QUEUE;
+            int b = (s->head + j) % PLHM_MERGE_QUEUE;
+            if (s->times[a] <= t)
+                break;
+            s->times[b] = s->times[a];
+            s->queue[b] = s->queue[a];
+        }
+        j = (s->head + j) % PLHM_MERGE_QUEUE;
+        s->times[j] = t;
+        s->queue[j] = *r;
+        s->queue[j].station = station;
+        us_tv(t, &s->queue[j].readtime);
+        s->count++;
+
+        if (!s->records || t > s->latest)
+            s->latest = t;
+        if (t > m->newest)
+            m->newest = t;
+        s->records++;
+        accepted++;
+    }
+    return accepted;
+}
+
+/* Records up to this time may be released. */
+static int64_t release_bound(const plhm_merge_t *m, const struct timeval *now)
+{
+    int64_t reached = INT64_MAX, wall = INT64_MIN;
+    int i;
+
+    for (i = 0; i < m->n_sources; i++) {
+        const plhm_merge_source_t *s = &m->sources[i];
+        if (s->ended)
+            continue;
+        if (!s->records)
+            reached = INT64_MIN;
+        else if (s->latest < reached)
+            reached = s->latest;
+    }
+    if (now)
+        wall = tv_us(now) - m->window;
+    return reached > wall ? reached : wall;
+}
+
+/* The source with the oldest queued record; with a handful of sources,
+ * a scan is cheaper than keeping a heap. */
+static int oldest(const plhm_merge_t *m, int64_t *t)
+{
+    int i, best = -1;
+    for (i = 0; i < m->n_sources; i++) {
+        const plhm_merge_source_t *s = &m->sources[i];
+        if (s->count && (best < 0 || s->times[s->head] < *t)) {
+            best = i;
+            *t = s->times[s->head];
+        }
+    }
+    return best;
+}
+
+static const plhm_record_t *take(plhm_merge_t *m, int source, int64_t t,
+                                 const struct timeval *now)
+{
+    plhm_merge_source_t *s = &m->sources[source];
+    const plhm_record_t *r = &s->queue[s->head];
+
+    s->head = (s->head + 1) % PLHM_MERGE_QUEUE;
+    s->count--;
+
+    if (now) {
+        double d = tv_us(now) - t;
+        s->delay_sum += d;
+        s->delay_n++;
+        if (d > s->delay_max)
+            s->delay_max = d;
+    }
+    return r;
+}
+
+int plhm_merge_pop(plhm_merge_t *m, plhm_record_t *out, int max,
+                   const struct timeval *now)
+{
+    int64_t bound = release_bound(m, now), t = 0;
+    int n = 0, i;
+
+    if (!m->period)
+    {
+        while (n < max && (i = oldest(m, &t)) >= 0 && t <= bound) {
+            out[n++] = *take(m, i, t, now);
+            m->released = t;
+            m->started = 1;
+        }
+        return n;
+    }
+
+    // a tick is only complete once time has moved past it, as more
+    // records of the same time may follow; and none beyond the data
+    if (bound != INT64_MAX && bound != INT64_MIN)
+        bound--;
+    if (bound > m->newest)
+        bound = m->newest;
+
+    if (!m->started) {
+        if (oldest(m, &t) < 0)
+            return 0;
+        // ticks fall on multiples of the period
+        m->next_tick = (t + m->period - 1) / m->period * m->period;
+        m->started = 1;
+    }
+
+    while (!n && m->next_tick <= bound)
+    {
+        while ((i = oldest(m, &t)) >= 0 && t <= m->next_tick) {
+            const plhm_record_t *r = take(m, i, t, now);
+            int st = r->station - 1;
+            m->held[st] = *r;
+            m->held_time[st] = t;
+            m->held_mask |= 1 << st;
+        }
+
+        for (i = 0; i < PLHM_FRAME_STATIONS && n < max; i++) {
+            if (!(m->held_mask & (1 << i)))
+                continue;
+            // a station that stopped is dropped after the window
+            if (m->next_tick - m->held_time[i] > m->window) {
+                m->held_mask &= ~(1 << i);
+                continue;
+            }
+            out[n] = m->held[i];
+            us_tv(m->next_tick, &out[n].readtime);
+            n++;
+        }
+
+        m->released = m->next_tick;
+        m->next_tick += m->period;
+    }
+    return n;
+}
+
+void plhm_merge_get_stats(const plhm_merge_t *m, int source,
+                          plhm_merge_stats_t *st)
+{
+    const plhm_merge_source_t *s = &m->sources[source];
+
+    memset(st, 0, sizeof(plhm_merge_stats_t));
+    st->records = s->records;
+    st->late = s->late;
+    st->overflow = s->overflow;
+    if (s->latency_n) {
+        st->latency_mean = s->latency_sum / s->latency_n / 1000.0;
+        st->latency_max = s->latency_max / 1000.0;
+    }
+    if (s->delay_n) {
+        st->delay_mean = s->delay_sum / s->delay_n / 1000.0;
+        st->delay_max = s->delay_max / 1000.0;
+    }
+    if (s->synced) {
+        st->offset = s->clock / 1000.0;
+        if (s->last_time > s->first_time)
+            st->skew = ((double)(s->first_clock - s->clock)
+                        / (s->last_time - s->first_time) * 1e6);
+    }
+}
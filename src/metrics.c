@@ -0,0 +1,62 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <time.h>
+
+#include "metrics.h"
+
+void histogram_add(histogram_t *h, double us)
+{
+    unsigned long v = us < 0 ? 0 : (unsigned long)us;
+    int b = 0;
+
+    while (v && b < HISTOGRAM_BUCKETS - 1) {
+        v >>= 1;
+        b++;
+    }
+    h->bucket[b]++;
+    h->count++;
+    h->sum += us;
+    if (us > h->max)
+        h->max = us;
+}
+
+double histogram_quantile(const histogram_t *h, double q)
+{
+    unsigned long n = 0, rank = (unsigned long)(q * h->count);
+    int b;
+
+    if (!h->count)
+        return 0;
+    for (b = 0; b < HISTOGRAM_BUCKETS - 1; b++) {
+        n += h->bucket[b];
+        if (n > rank)
+            break;
+    }
+    return (double)(1UL << b) < h->max ? (double)(1UL << b) : h->max;
+}
+
+void histogram_json(FILE *f, const histogram_t *h)
+{
+    fprintf(f, "{ \"count\": %lu, \"mean_us\": %.1f, \"p50_us\": %.0f, "
+            "\"p99_us\": %.0f, \"max_us\": %.0f }", h->count,
+            h->count ? h->sum / h->count : 0.0,
+            histogram_quantile(h, 0.5), histogram_quantile(h, 0.99),
+            h->max);
+}
+
+double monotonic_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
@@ -0,0 +1,41 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stdio.h>
+
+// bucket 0 holds times under 1 us, bucket i those under 2^i us
+#define HISTOGRAM_BUCKETS 24
+
+/* Times in microseconds, kept as counts in power-of-two buckets so
+ * that adding one costs a few instructions. */
+typedef struct _histogram
+{
+    unsigned long count;
+    double sum, max;
+    unsigned long bucket[HISTOGRAM_BUCKETS];
+} histogram_t;
+
+void histogram_add(histogram_t *h, double us);
+
+/* The upper bound of the bucket holding the quantile q, at most the
+ * largest time seen. */
+double histogram_quantile(const histogram_t *h, double q);
+
+/* {"count": n, "mean_us": .., "p50_us": .., "p99_us": .., "max_us": ..} */
+void histogram_json(FILE *f, const histogram_t *h);
+
+double monotonic_us();
+
+#endif // _METRICS_H_
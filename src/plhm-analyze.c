@@ -0,0 +1,960 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* Summarize a recording made by plhm -o, either the text output or a
+ * compressed recording (-z).
+ *
+ * The file is mapped and split into one chunk per thread: text files
+ * at line boundaries, compressed ones at block boundaries.  Each
+ * thread gathers per-station statistics, a histogram of the interval
+ * between records, candidate gaps, and optionally the records inside
+ * a time range for export.  The chunks are then merged in order,
+ * accounting for the interval that straddles each boundary. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "config.h"
+
+#include <plhm.h>
+#include <plhm_recording.h>
+
+#define STATIONS PLHM_REC_MAX_STATIONS
+#define CHANNELS 6
+
+// intervals between records of a station, in 50 us bins up to 100 ms
+#define HIST_BIN_US 50
+#define HIST_BINS 2000
+
+// gaps listed per station unless --verbose
+#define GAPS_SHOWN 10
+
+// recent intervals kept to follow a change of rate
+#define RATE_WINDOW 8
+
+typedef struct {
+    int64_t time;       // start of the gap, us
+    int64_t length;     // us
+    int station;
+} gap_t;
+
+typedef struct {
+    unsigned long long n, errors;
+    int64_t first, last;
+    // sums are kept relative to the first value to avoid cancellation
+    double shift[CHANNELS], s1[CHANNELS], s2[CHANNELS];
+    float min[CHANNELS], max[CHANNELS];
+    double mean_dt;     // running estimate, for spotting gaps
+    int64_t recent[RATE_WINDOW];    // the last intervals, and how many
+    int above;                      // in a row were candidate gaps
+    unsigned int hist[HIST_BINS + 1];
+} station_t;
+
+typedef struct {
+    pthread_t thread;
+
+    // input: a range of text, or a range of blocks
+    const char *begin, *end;
+    const size_t *blocks;
+    int n_blocks;
+
+    station_t station[STATIONS];
+    int fields;
+    gap_t *gaps;
+    int n_gaps, max_gaps;
+    unsigned long long records, bad_lines;
+
+    // records between from and to, in the export format
+    FILE *export;
+    char *export_data;
+    size_t export_size;
+    plhm_rec_writer_t writer;
+    plhm_record_t frame[STATIONS];
+    int frame_n;
+} chunk_t;
+
+/* Options */
+static int text_fields = 0;
+static int hex_flag = 0;
+static int verbose_flag = 0;
+static double gap_factor = 1.5;
+static int64_t range_from = 0, range_to = INT64_MAX;   // us, relative
+static const char *export_name = 0;
+static int export_compressed = -1;      // default: same as input
+
+/* The recording */
+static const char *data;
+static size_t size;
+static int compressed;
+static int64_t start_time;              // us, first record
+static int64_t from_time, to_time;      // us, absolute
+
+static const char *channel_names[CHANNELS] = {
+    "x", "y", "z", "azimuth", "elevation", "roll"
+};
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int64_t record_time(const plhm_record_t *r)
+{
+    return (int64_t)r->readtime.tv_sec * 1000000 + r->readtime.tv_usec;
+}
+
+/* Text input */
+
+/* Parse a decimal as written by plhm's "%.4f"; anything unusual is
+ * left to strtod. */
+static const char *parse_float(const char *c, const char *end, float *f)
+{
+    static const double scale[] = { 1, 1e-1, 1e-2, 1e-3, 1e-4, 1e-5,
+                                    1e-6, 1e-7, 1e-8, 1e-9 };
+    const char *s = c;
+    uint64_t v = 0;
+    int neg = 0, digits = 0, frac = 0;
+
+    while (c < end && (*c == ' ' || *c == ','))
+        c++;
+
+    if (hex_flag) {
+        // bytes of the float in memory order
+        char *e;
+        uint32_t u = (uint32_t)strtoul(c, &e, 16);
+        if (e == c)
+            return 0;
+        u = __builtin_bswap32(u);
+        memcpy(f, &u, 4);
+        return e;
+    }
+
+    s = c;
+    if (c < end && *c == '-') {
+        neg = 1;
+        c++;
+    }
+    while (c < end && *c >= '0' && *c <= '9') {
+        v = v * 10 + (*c++ - '0');
+        digits++;
+    }
+    if (c < end && *c == '.') {
+        c++;
+        while (c < end && *c >= '0' && *c <= '9' && frac < 9) {
+            v = v * 10 + (*c++ - '0');
+            frac++;
+        }
+    }
+    digits += frac;
+    if (!digits || digits > 18
+        || (c < end && ((*c >= '0' && *c <= '9') || *c == 'e'
+                        || *c == 'E' || *c == 'n' || *c == 'i')))
+    {
+        char *e;
+        *f = strtof(s, &e);
+        return (e == s) ? 0 : e;
+    }
+
+    *f = (float)(neg ? -(v * scale[frac]) : (v * scale[frac]));
+    return c;
+}
+
+/* Read time, written by plhm as milliseconds with "%f". */
+static const char *parse_time(const char *c, const char *end, int64_t *us)
+{
+    int64_t ms = 0, frac = 0;
+    int digits = 0, n = 0;
+
+    while (c < end && (*c == ' ' || *c == ','))
+        c++;
+    while (c < end && *c >= '0' && *c <= '9') {
+        ms = ms * 10 + (*c++ - '0');
+        digits++;
+    }
+    if (c < end && *c == '.') {
+        c++;
+        while (c < end && *c >= '0' && *c <= '9') {
+            if (n < 3)
+                frac = frac * 10 + (*c - '0');
+            else if (n == 3 && *c >= '5')
+                frac++;
+            c++;
+            n++;
+        }
+    }
+    if (!digits)
+        return 0;
+    while (n++ < 3)
+        frac *= 10;
+    *us = ms * 1000 + frac;
+    return c;
+}
+
+static const char *parse_uint(const char *c, const char *end, unsigned int *u)
+{
+    unsigned int v = 0;
+    int digits = 0;
+    while (c < end && (*c == ' ' || *c == ','))
+        c++;
+    while (c < end && *c >= '0' && *c <= '9') {
+        v = v * 10 + (*c++ - '0');
+        digits++;
+    }
+    *u = v;
+    return digits ? c : 0;
+}
+
+/* Parse one line in the layout given by text_fields.  Returns 0 on
+ * success. */
+static int parse_line(const char *c, const char *end, plhm_record_t *r)
+{
+    unsigned int station;
+    int64_t t;
+
+    if (!(c = parse_uint(c, end, &station)) || station < 1
+        || station > STATIONS)
+        return 1;
+    r->station = station;
+    r->fields = text_fields;
+    r->error = ' ';
+
+    if (text_fields & PLHM_DATA_POSITION) {
+        if (!(c = parse_float(c, end, &r->position[0]))
+            || !(c = parse_float(c, end, &r->position[1]))
+            || !(c = parse_float(c, end, &r->position[2])))
+            return 1;
+    }
+    else
+        r->position[0] = r->position[1] = r->position[2] = 0;
+
+    if (text_fields & PLHM_DATA_EULER) {
+        if (!(c = parse_float(c, end, &r->euler[0]))
+            || !(c = parse_float(c, end, &r->euler[1]))
+            || !(c = parse_float(c, end, &r->euler[2])))
+            return 1;
+    }
+    else
+        r->euler[0] = r->euler[1] = r->euler[2] = 0;
+
+    r->timestamp = 0;
+    if ((text_fields & PLHM_DATA_TIMESTAMP)
+        && !(c = parse_uint(c, end, &r->timestamp)))
+        return 1;
+
+    // any gesture features follow the time and are ignored
+    if (!(c = parse_time(c, end, &t)))
+        return 1;
+    r->readtime.tv_sec = t / 1000000;
+    r->readtime.tv_usec = t % 1000000;
+    return 0;
+}
+
+/* Per-chunk work */
+
+static void add_gap(chunk_t *k, int station, int64_t time, int64_t length)
+{
+    if (k->n_gaps == k->max_gaps) {
+        k->max_gaps = k->max_gaps ? k->max_gaps * 2 : 256;
+        k->gaps = realloc(k->gaps, k->max_gaps * sizeof(gap_t));
+        if (!k->gaps) {
+            printf("Out of memory.\n");
+            exit(1);
+        }
+    }
+    k->gaps[k->n_gaps].station = station;
+    k->gaps[k->n_gaps].time = time;
+    k->gaps[k->n_gaps].length = length;
+    k->n_gaps++;
+}
+
+static void add_interval(station_t *s, int64_t dt)
+{
+    int64_t bin = dt / HIST_BIN_US;
+    s->hist[(bin < 0 || bin > HIST_BINS) ? HIST_BINS : bin]++;
+}
+
+static void flush_frame(chunk_t *k)
+{
+    if (k->frame_n)
+        plhm_rec_write(&k->writer, k->frame, k->frame_n);
+    k->frame_n = 0;
+}
+
+static void export_record(chunk_t *k, const plhm_record_t *r,
+                          const char *line, const char *eol)
+{
+    if (!export_compressed) {
+        if (line) {
+            // the last line of the input may have no newline
+            fwrite(line, eol - line, 1, k->export);
+            if (eol < k->end)
+                fputc('\n', k->export);
+            return;
+        }
+        fprintf(k->export, "%d", r->station);
+        if (r->fields & PLHM_DATA_POSITION)
+            fprintf(k->export, ", %.4f, %.4f, %.4f", r->position[0],
+                    r->position[1], r->position[2]);
+        if (r->fields & PLHM_DATA_EULER)
+            fprintf(k->export, ", %.4f, %.4f, %.4f", r->euler[0],
+                    r->euler[1], r->euler[2]);
+        if (r->fields & PLHM_DATA_TIMESTAMP)
+            fprintf(k->export, ", %u", r->timestamp);
+        fprintf(k->export, ", %f\n", r->readtime.tv_sec * 1000.0
+                + r->readtime.tv_usec / 1000.0);
+        return;
+    }
+
+    // records read together form a frame
+    if (k->frame_n && (record_time(r) != record_time(&k->frame[0])
+                       || r->station <= k->frame[k->frame_n-1].station))
+        flush_frame(k);
+    k->frame[k->frame_n++] = *r;
+}
+
+static void add_record(chunk_t *k, const plhm_record_t *r,
+                       const char *line, const char *eol)
+{
+    station_t *s = &k->station[r->station - 1];
+    int64_t t = record_time(r);
+    float v[CHANNELS];
+    int i;
+
+    memcpy(v, r->position, sizeof(r->position));
+    memcpy(v + 3, r->euler, sizeof(r->euler));
+
+    if (!s->n) {
+        s->first = t;
+        for (i = 0; i < CHANNELS; i++) {
+            s->shift[i] = v[i];
+            s->min[i] = s->max[i] = v[i];
+        }
+    }
+    else {
+        int64_t dt = t - s->last;
+        add_interval(s, dt);
+
+        // keep anything well above the running interval as a candidate
+        // gap; the final threshold is applied once the median is known
+        s->recent[s->n % RATE_WINDOW] = dt;
+        if (s->mean_dt > 0 && dt > 0.9 * gap_factor * s->mean_dt) {
+            add_gap(k, r->station - 1, s->last, dt);
+
+            // a window of nothing but gaps means the rate dropped:
+            // start again from the recent intervals
+            if (++s->above == RATE_WINDOW) {
+                int64_t sum = 0;
+                for (i = 0; i < RATE_WINDOW; i++)
+                    sum += s->recent[i];
+                s->mean_dt = (double)sum / RATE_WINDOW;
+                s->above = 0;
+            }
+        }
+        else if (dt > 0) {
+            s->mean_dt = s->mean_dt ? 0.95 * s->mean_dt + 0.05 * dt : dt;
+            s->above = 0;
+        }
+    }
+    s->last = t;
+    s->n++;
+    if (r->error != ' ')
+        s->errors++;
+
+    for (i = 0; i < CHANNELS; i++) {
+        double d = v[i] - s->shift[i];
+        s->s1[i] += d;
+        s->s2[i] += d * d;
+        if (v[i] < s->min[i]) s->min[i] = v[i];
+        if (v[i] > s->max[i]) s->max[i] = v[i];
+    }
+
+    k->fields |= r->fields;
+    k->records++;
+
+    if (k->export && t >= from_time && t < to_time)
+        export_record(k, r, line, eol);
+}
+
+static void *analyze_chunk(void *arg)
+{
+    chunk_t *k = (chunk_t*)arg;
+    int i;
+
+    if (!compressed) {
+        const char *c = k->begin;
+        while (c < k->end)
+        {
+            plhm_record_t r;
+            const char *eol = memchr(c, '\n', k->end - c);
+            if (!eol)
+                eol = k->end;
+            if (eol > c && *c != '#') {
+                if (parse_line(c, eol, &r))
+                    k->bad_lines++;
+                else
+                    add_record(k, &r, c, eol);
+            }
+            c = eol + 1;
+        }
+    }
+    else {
+        plhm_record_t *recs = malloc(sizeof(plhm_record_t)
+                                     * PLHM_REC_BLOCK_FRAMES * STATIONS);
+        if (!recs) {
+            printf("Out of memory.\n");
+            exit(1);
+        }
+        for (i = 0; i < k->n_blocks; i++)
+        {
+            plhm_rec_reader_t r;
+            plhm_rec_block_t b;
+            int j, n;
+
+            // each block is read on its own, from its offset
+            r.data = (const uint8_t*)data;
+            r.size = size;
+            r.pos = k->blocks[i];
+            r.fd = -1;
+            if (plhm_rec_next_block(&r, &b)
+                || (n = plhm_rec_decode_block(&b, recs)) < 0)
+            {
+                k->bad_lines++;
+                continue;
+            }
+            for (j = 0; j < n; j++)
+                add_record(k, &recs[j], 0, 0);
+        }
+        free(recs);
+    }
+
+    if (k->export && export_compressed) {
+        flush_frame(k);
+        plhm_rec_writer_close(&k->writer);
+    }
+    return 0;
+}
+
+/* Merging */
+
+static void merge_station(station_t *a, const station_t *b,
+                          chunk_t *total, int station)
+{
+    int i;
+
+    if (!b->n)
+        return;
+    if (!a->n) {
+        *a = *b;
+        return;
+    }
+
+    // the interval across the chunk boundary
+    {
+        int64_t dt = b->first - a->last;
+        add_interval(a, dt);
+        add_gap(total, station, a->last, dt);
+    }
+
+    for (i = 0; i < CHANNELS; i++) {
+        // move b's sums to a's shift
+        double d = b->shift[i] - a->shift[i];
+        a->s2[i] += b->s2[i] + 2 * d * b->s1[i] + b->n * d * d;
+        a->s1[i] += b->s1[i] + b->n * d;
+        if (b->min[i] < a->min[i]) a->min[i] = b->min[i];
+        if (b->max[i] > a->max[i]) a->max[i] = b->max[i];
+    }
+    for (i = 0; i <= HIST_BINS; i++)
+        a->hist[i] += b->hist[i];
+    a->n += b->n;
+    a->errors += b->errors;
+    a->last = b->last;
+}
+
+/* Median interval in us, from the histogram. */
+static double median_interval(const station_t *s)
+{
+    unsigned long long count = 0, half = 0;
+    int i;
+    for (i = 0; i <= HIST_BINS; i++)
+        count += s->hist[i];
+    if (!count)
+        return 0;
+    for (i = 0; i < HIST_BINS; i++) {
+        half += s->hist[i];
+        if (half * 2 >= count)
+            return (i + 0.5) * HIST_BIN_US;
+    }
+    return HIST_BINS * HIST_BIN_US;
+}
+
+static int compare_gaps(const void *a, const void *b)
+{
+    const gap_t *x = (const gap_t*)a, *y = (const gap_t*)b;
+    if (x->station != y->station)
+        return x->station - y->station;
+    return (x->time > y->time) - (x->time < y->time);
+}
+
+static void print_rates(const station_t *s)
+{
+    // instantaneous rate in 10 Hz bins, from the interval histogram
+    unsigned long long rate[51];
+    unsigned long long most = 0;
+    int i;
+
+    memset(rate, 0, sizeof(rate));
+    for (i = 0; i <= HIST_BINS; i++) {
+        double hz = (i < HIST_BINS) ? 1e6 / ((i + 0.5) * HIST_BIN_US) : 0;
+        int bin = (int)(hz / 10);
+        rate[bin > 50 ? 50 : bin] += s->hist[i];
+    }
+    for (i = 0; i <= 50; i++)
+        if (rate[i] > most)
+            most = rate[i];
+
+    printf("  rate histogram:\n");
+    for (i = 0; i <= 50; i++)
+    {
+        int bar;
+        if (!rate[i])
+            continue;
+        bar = (int)((rate[i] * 40 + most - 1) / most);
+        if (i < 50)
+            printf("    %3d-%3d Hz %10llu  ", i * 10, i * 10 + 10, rate[i]);
+        else
+            printf("    >= 500 Hz %10llu  ", rate[i]);
+        while (bar--)
+            putchar('#');
+        putchar('\n');
+    }
+}
+
+/* Offsets of all blocks of a compressed recording. */
+static size_t *index_blocks(int *n)
+{
+    plhm_rec_reader_t r;
+    plhm_rec_block_t b;
+    size_t *blocks = 0, pos;
+    int max = 0, rc;
+
+    *n = 0;
+    if (plhm_rec_reader_init(&r, data, size))
+        return 0;
+    for (pos = r.pos; (rc = plhm_rec_next_block(&r, &b)) == 0; pos = r.pos) {
+        if (*n == max) {
+            max = max ? max * 2 : 1024;
+            blocks = realloc(blocks, max * sizeof(size_t));
+            if (!blocks)
+                return 0;
+        }
+        blocks[(*n)++] = pos;
+    }
+    if (rc < 0)
+        printf("[plhm-analyze] Recording is damaged after %d blocks, "
+               "reading up to there.\n", *n);
+    return blocks;
+}
+
+static int find_start_time()
+{
+    if (compressed) {
+        plhm_rec_reader_t r;
+        plhm_rec_block_t b;
+        static plhm_record_t recs[PLHM_REC_BLOCK_FRAMES * STATIONS];
+        if (plhm_rec_reader_init(&r, data, size)
+            || plhm_rec_next_block(&r, &b)
+            || plhm_rec_decode_block(&b, recs) <= 0)
+            return 1;
+        start_time = record_time(&recs[0]);
+        return 0;
+    }
+    else {
+        const char *c = data, *end = data + size;
+        while (c < end) {
+            plhm_record_t r;
+            const char *eol = memchr(c, '\n', end - c);
+            if (!eol)
+                eol = end;
+            if (eol > c && *c != '#' && !parse_line(c, eol, &r)) {
+                start_time = record_time(&r);
+                return 0;
+            }
+            c = eol + 1;
+        }
+        return 1;
+    }
+}
+
+static int parse_range(const char *str)
+{
+    char *end;
+    double from = strtod(str, &end), to;
+    if (end == str || (*end && *end != ','))
+        return 1;
+    str = *end ? end + 1 : end;
+    to = *str ? strtod(str, &end) : 0;
+    if (*str && (end == str || *end))
+        return 1;
+    range_from = (int64_t)(from * 1e6);
+    if (*str)
+        range_to = (int64_t)(to * 1e6);
+    return range_to <= range_from;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option long_options[] =
+    {
+        {"position", no_argument,       0, 'P'},
+        {"euler",    no_argument,       0, 'E'},
+        {"timestamp",no_argument,       0, 'T'},
+        {"hex",      no_argument,       0, 'H'},
+        {"threads",  required_argument, 0, 'j'},
+        {"gap",      required_argument, 0, 'G'},
+        {"range",    required_argument, 0, 'r'},
+        {"export",   required_argument, 0, 'x'},
+        {"compress", no_argument,       0, 'z'},
+        {"text",     no_argument,       0, 't'},
+        {"verbose",  no_argument,       0, 'v'},
+        {"help",     no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    chunk_t *chunks, total;
+    size_t *blocks = 0;
+    int n_blocks = 0, i, j, fd;
+    struct stat st;
+    double started, elapsed;
+    FILE *export = 0;
+
+    while (1)
+    {
+        int c = getopt_long(argc, argv, "PETHj:G:r:x:ztvh", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+        case 'P': text_fields |= PLHM_DATA_POSITION; break;
+        case 'E': text_fields |= PLHM_DATA_EULER; break;
+        case 'T': text_fields |= PLHM_DATA_TIMESTAMP; break;
+        case 'H': hex_flag = 1; break;
+        case 'v': verbose_flag = 1; break;
+        case 'z': export_compressed = 1; break;
+        case 't': export_compressed = 0; break;
+
+        case 'j':
+            threads = atoi(optarg);
+            break;
+
+        case 'G':
+            gap_factor = atof(optarg);
+            if (gap_factor <= 1) {
+                printf("[plhm-analyze] --gap expects a factor above 1.\n");
+                exit(1);
+            }
+            break;
+
+        case 'r':
+            if (parse_range(optarg)) {
+                printf("[plhm-analyze] --range expects from[,to] "
+                       "in seconds.\n");
+                exit(1);
+            }
+            break;
+
+        case 'x':
+            export_name = optarg;
+            break;
+
+        default:
+            printf("Usage: %s [options] <recording>\n"
+"  Summarize a recording made by plhm -o, as text or compressed (-z).\n"
+"  For text, give the same data options as were given to plhm:\n"
+"  -P --position         lines have position data\n"
+"  -E --euler            lines have euler angle data\n"
+"  -T --timestamp        lines have timestamp data\n"
+"  -H --hex              float values are hexadecimal\n"
+"  Analysis:\n"
+"  -j --threads=<n>      threads to use (default: all cores)\n"
+"  -G --gap=<factor>     report intervals longer than factor times\n"
+"                        the median interval as gaps (default 1.5)\n"
+"  -v --verbose          list every gap\n"
+"  Export:\n"
+"  -r --range=<from>[,to]\n"
+"                        seconds from the first record to export\n"
+"  -x --export=<path>    write the records within the range\n"
+"  -z --compress         export as a compressed recording\n"
+"  -t --text             export as text\n"
+"                        (default: the format of the input)\n"
+"  -h --help             show this help\n"
+                   , argv[0]);
+            exit(c != 'h');
+        }
+    }
+
+    if (optind != argc - 1) {
+        printf("[plhm-analyze] Expected one recording.  "
+               "Try option '-h' for help.\n");
+        exit(1);
+    }
+    if (threads < 1)
+        threads = 1;
+
+    fd = open(argv[optind], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st)) {
+        printf("[plhm-analyze] Could not open %s\n", argv[optind]);
+        exit(1);
+    }
+    size = st.st_size;
+    if (!size) {
+        printf("[plhm-analyze] %s is empty.\n", argv[optind]);
+        exit(1);
+    }
+    data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        printf("[plhm-analyze] Could not map %s\n", argv[optind]);
+        exit(1);
+    }
+    madvise((void*)data, size, MADV_SEQUENTIAL);
+
+    compressed = plhm_rec_is_recording(data, size);
+    if (!compressed && !text_fields) {
+        printf("[plhm-analyze] For text recordings, give the data options "
+               "(-P, -E, -T) used when recording.\n");
+        exit(1);
+    }
+    if (export_compressed < 0)
+        export_compressed = compressed;
+
+    started = now();
+
+    if (find_start_time()) {
+        printf("[plhm-analyze] No records in %s\n", argv[optind]);
+        exit(1);
+    }
+    from_time = start_time + range_from;
+    to_time = (range_to == INT64_MAX) ? INT64_MAX : start_time + range_to;
+
+    if (compressed) {
+        blocks = index_blocks(&n_blocks);
+        if (!blocks) {
+            printf("[plhm-analyze] No blocks in %s\n", argv[optind]);
+            exit(1);
+        }
+        if (threads > n_blocks)
+            threads = n_blocks;
+    }
+    else if ((size_t)threads > size / 4096 + 1)
+        threads = size / 4096 + 1;
+
+    chunks = calloc(threads, sizeof(chunk_t));
+    if (!chunks) {
+        printf("Out of memory.\n");
+        exit(1);
+    }
+
+    for (i = 0; i < threads; i++)
+    {
+        chunk_t *k = &chunks[i];
+        if (compressed) {
+            // divide by bytes rather than blocks, as blocks vary in size
+            int first = 0, last = n_blocks;
+            size_t lo = (size_t)((double)size * i / threads);
+            size_t hi = (size_t)((double)size * (i + 1) / threads);
+            while (first < n_blocks && blocks[first] < lo)
+                first++;
+            while (last > first && blocks[last - 1] >= hi)
+                last--;
+            if (i == threads - 1)
+                last = n_blocks;
+            k->blocks = blocks + first;
+            k->n_blocks = last - first;
+        }
+        else {
+            const char *lo = data + (size_t)((double)size * i / threads);
+            const char *hi = data + (size_t)((double)size * (i + 1)
+                                             / threads);
+            // each chunk starts after a line break
+            if (i > 0) {
+                const char *nl = memchr(lo - 1, '\n', data + size - lo + 1);
+                lo = nl ? nl + 1 : data + size;
+            }
+            if (i < threads - 1) {
+                const char *nl = memchr(hi - 1, '\n', data + size - hi + 1);
+                hi = nl ? nl + 1 : data + size;
+            }
+            else
+                hi = data + size;
+            k->begin = lo;
+            k->end = hi > lo ? hi : lo;
+        }
+
+        if (export_name) {
+            k->export = open_memstream(&k->export_data, &k->export_size);
+            if (!k->export
+                || (export_compressed
+                    && plhm_rec_writer_open(&k->writer, k->export)))
+            {
+                printf("[plhm-analyze] Could not start the export.\n");
+                exit(1);
+            }
+        }
+
+        if (pthread_create(&k->thread, 0, analyze_chunk, k)) {
+            printf("[plhm-analyze] Could not start a thread.\n");
+            exit(1);
+        }
+    }
+
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < threads; i++)
+    {
+        chunk_t *k = &chunks[i];
+        pthread_join(k->thread, 0);
+
+        for (j = 0; j < STATIONS; j++)
+            merge_station(&total.station[j], &k->station[j], &total, j);
+        for (j = 0; j < k->n_gaps; j++)
+            add_gap(&total, k->gaps[j].station, k->gaps[j].time,
+                    k->gaps[j].length);
+        total.records += k->records;
+        total.bad_lines += k->bad_lines;
+        total.fields |= k->fields;
+        free(k->gaps);
+    }
+
+    elapsed = now() - started;
+
+    if (export_name)
+    {
+        unsigned long long bytes = 0;
+        export = fopen(export_name, "w");
+        if (!export) {
+            printf("[plhm-analyze] Could not open %s\n", export_name);
+            exit(1);
+        }
+        for (i = 0; i < threads; i++) {
+            chunk_t *k = &chunks[i];
+            fclose(k->export);
+            // chunks of a compressed export are joined under one header
+            size_t skip = (export_compressed && i > 0)
+                ? PLHM_REC_HEADER_BYTES : 0;
+            if (k->export_size > skip
+                && fwrite(k->export_data + skip, k->export_size - skip, 1,
+                          export) != 1)
+            {
+                printf("[plhm-analyze] Error writing %s\n", export_name);
+                exit(1);
+            }
+            bytes += k->export_size - skip;
+            free(k->export_data);
+        }
+        fclose(export);
+        printf("[plhm-analyze] wrote %llu bytes to %s\n", bytes, export_name);
+    }
+
+    printf("%s: %s, %.1f MB, %llu records\n", argv[optind],
+           compressed ? "compressed" : "text", size / 1e6, total.records);
+    printf("analyzed in %.3f s on %d threads, %.0f MB/s\n",
+           elapsed, threads, size / elapsed / 1e6);
+    if (total.bad_lines)
+        printf("%llu %s could not be read\n", total.bad_lines,
+               compressed ? "blocks" : "lines");
+
+    qsort(total.gaps, total.n_gaps, sizeof(gap_t), compare_gaps);
+
+    for (j = 0; j < STATIONS; j++)
+    {
+        station_t *s = &total.station[j];
+        double median = median_interval(s);
+        double duration = (s->last - s->first) / 1e6;
+        int64_t missing = 0, longest = 0;
+        int n_gaps = 0, shown = 0;
+
+        if (!s->n)
+            continue;
+
+        printf("\nstation %d: %llu records over %.3f s from %.3f s, ",
+               j + 1, s->n, duration, (s->first - start_time) / 1e6);
+        if (median > 0)
+            printf("%.1f Hz median", 1e6 / median);
+        if (compressed)
+            printf(", %llu errors", s->errors);
+        printf("\n");
+
+        if (total.fields & (PLHM_DATA_POSITION | PLHM_DATA_EULER)) {
+            printf("  %-10s %12s %12s %12s %12s\n", "",
+                   "mean", "std", "min", "max");
+            for (i = 0; i < CHANNELS; i++) {
+                double mean = s->shift[i] + s->s1[i] / s->n;
+                double var = (s->s2[i] - s->s1[i] * s->s1[i] / s->n) / s->n;
+                if (!(total.fields & (i < 3 ? PLHM_DATA_POSITION
+                                            : PLHM_DATA_EULER)))
+                    continue;
+                printf("  %-10s %12.4f %12.4f %12.4f %12.4f\n",
+                       channel_names[i], mean, var > 0 ? sqrt(var) : 0,
+                       s->min[i], s->max[i]);
+            }
+        }
+
+        for (i = 0; i < total.n_gaps; i++) {
+            gap_t *g = &total.gaps[i];
+            if (g->station != j || g->length <= gap_factor * median)
+                continue;
+            n_gaps++;
+            missing += (int64_t)(g->length / median + 0.5) - 1;
+            if (g->length > longest)
+                longest = g->length;
+        }
+        printf("  gaps: %d, about %lld frames missing", n_gaps,
+               (long long)missing);
+        if (n_gaps)
+            printf(", longest %.1f ms", longest / 1e3);
+        printf("\n");
+        for (i = 0; i < total.n_gaps; i++) {
+            gap_t *g = &total.gaps[i];
+            if (g->station != j || g->length <= gap_factor * median)
+                continue;
+            if (!verbose_flag && shown == GAPS_SHOWN) {
+                printf("    ... (-v to list all)\n");
+                break;
+            }
+            printf("    at %.3f s, %.1f ms\n",
+                   (g->time - start_time) / 1e6, g->length / 1e3);
+            shown++;
+        }
+
+        if (s->n > 1)
+            print_rates(s);
+    }
+
+    free(total.gaps);
+    free(chunks);
+    free(blocks);
+    munmap((void*)data, size);
+    close(fd);
+    return 0;
+}
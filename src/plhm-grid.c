@@ -0,0 +1,411 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* Build a distortion compensation grid from calibration samples.
+ *
+ * Each input line holds a measured and a true position, optionally
+ * followed by the measured and true orientation:
+ *
+ *   mx my mz  tx ty tz  [maz mel mroll  taz tel troll]
+ *
+ * separated by spaces or commas.  Each sample is spread over the
+ * eight surrounding grid nodes with trilinear weights; nodes that no
+ * sample reaches are filled from their neighbours. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <math.h>
+
+#include "config.h"
+
+#include <plhm.h>
+#include <plhm_frame.h>
+#include <plhm_distortion.h>
+
+typedef struct {
+    float measured[3], truth[3];
+    float rotation[4];
+    int has_rotation;
+} sample_t;
+
+static sample_t *samples = 0;
+static int n_samples = 0, max_samples = 0;
+
+static float dot4(const float *a, const float *b)
+{
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+}
+
+/* to unit length, or the identity if the sum cancelled out */
+static void normalize4(float *q)
+{
+    float norm = sqrtf(dot4(q, q));
+    int k;
+    if (norm < 1e-6f) {
+        q[0] = 1;
+        q[1] = q[2] = q[3] = 0;
+        return;
+    }
+    for (k = 0; k < 4; k++)
+        q[k] /= norm;
+}
+
+static int read_samples(FILE *f, const char *name)
+{
+    char line[1024];
+    int lineno = 0;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        float v[12], qm[4], qt[4];
+        char *c = line, *end;
+        int n = 0;
+        lineno++;
+
+        while (n < 12) {
+            while (*c == ' ' || *c == '\t' || *c == ',')
+                c++;
+            v[n] = strtof(c, &end);
+            if (end == c)
+                break;
+            c = end;
+            n++;
+        }
+
+        if (n == 0 || line[0] == '#')
+            continue;
+        if (n != 6 && n != 12) {
+            printf("%s:%d: expected 6 or 12 values, got %d\n",
+                   name, lineno, n);
+            return 1;
+        }
+
+        if (n_samples == max_samples) {
+            max_samples = max_samples ? max_samples * 2 : 1024;
+            samples = realloc(samples, max_samples * sizeof(sample_t));
+            if (!samples) {
+                printf("Out of memory.\n");
+                return 1;
+            }
+        }
+
+        sample_t *s = &samples[n_samples++];
+        memcpy(s->measured, v, sizeof(s->measured));
+        memcpy(s->truth, v + 3, sizeof(s->truth));
+        s->has_rotation = (n == 12);
+        if (s->has_rotation)
+        {
+            // correction = true * conj(measured)
+            plhm_euler_to_quat(v + 6, qm);
+            plhm_euler_to_quat(v + 9, qt);
+            qm[1] = -qm[1]; qm[2] = -qm[2]; qm[3] = -qm[3];
+            s->rotation[0] = qt[0]*qm[0] - qt[1]*qm[1] - qt[2]*qm[2] - qt[3]*qm[3];
+            s->rotation[1] = qt[0]*qm[1] + qt[1]*qm[0] + qt[2]*qm[3] - qt[3]*qm[2];
+            s->rotation[2] = qt[0]*qm[2] - qt[1]*qm[3] + qt[2]*qm[0] + qt[3]*qm[1];
+            s->rotation[3] = qt[0]*qm[3] + qt[1]*qm[2] - qt[2]*qm[1] + qt[3]*qm[0];
+            // keep all corrections in the same hemisphere for averaging
+            if (s->rotation[0] < 0) {
+                int i;
+                for (i = 0; i < 4; i++)
+                    s->rotation[i] = -s->rotation[i];
+            }
+        }
+    }
+    return 0;
+}
+
+static int parse_floats(const char *str, float *v, int n)
+{
+    int i;
+    char *end;
+    for (i = 0; i < n; i++) {
+        v[i] = strtof(str, &end);
+        if (end == str)
+            return 1;
+        str = end;
+        if (*str == ',')
+            str++;
+    }
+    return *str != 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option long_options[] =
+    {
+        {"dims",     required_argument, 0, 'n'},
+        {"bounds",   required_argument, 0, 'b'},
+        {"output",   required_argument, 0, 'o'},
+        {"help",     no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int dims[3] = { 8, 8, 8 };
+    float bounds[6], *min = bounds, *max = bounds + 3;
+    int have_bounds = 0;
+    const char *output = 0;
+    int i, j, x, y, z;
+
+    while (1)
+    {
+        float d[3];
+        int c = getopt_long(argc, argv, "n:b:o:h", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+        case 'n':
+            if (parse_floats(optarg, d, 3)) {
+                printf("[plhm-grid] --dims expects nx,ny,nz\n");
+                exit(1);
+            }
+            for (i = 0; i < 3; i++)
+                dims[i] = (int)d[i];
+            break;
+
+        case 'b':
+            if (parse_floats(optarg, bounds, 6)) {
+                printf("[plhm-grid] --bounds expects "
+                       "minx,miny,minz,maxx,maxy,maxz\n");
+                exit(1);
+            }
+            have_bounds = 1;
+            break;
+
+        case 'o':
+            output = optarg;
+            break;
+
+        default:
+            printf("Usage: %s [options] -o <grid> [samples...]\n"
+"  Build a distortion compensation grid for plhm --grid from\n"
+"  calibration samples, one per line:\n"
+"    mx my mz tx ty tz [maz mel mroll taz tel troll]\n"
+"  where m is measured and t is true.  Reads stdin if no files given.\n"
+"  -n --dims=nx,ny,nz    grid nodes along each axis (default 8,8,8)\n"
+"  -b --bounds=minx,miny,minz,maxx,maxy,maxz\n"
+"                        volume covered by the grid (default: the\n"
+"                        bounding box of the measured positions)\n"
+"  -o --output=<path>    grid file to write\n"
+"  -h --help             show this help\n"
+                   , argv[0]);
+            exit(c != 'h');
+        }
+    }
+
+    if (!output) {
+        printf("[plhm-grid] No output file given.  Try option '-h' for help.\n");
+        exit(1);
+    }
+
+    if (optind == argc) {
+        if (read_samples(stdin, "stdin"))
+            exit(1);
+    }
+    for (i = optind; i < argc; i++) {
+        FILE *f = fopen(argv[i], "r");
+        if (!f) {
+            printf("[plhm-grid] Could not open %s\n", argv[i]);
+            exit(1);
+        }
+        if (read_samples(f, argv[i]))
+            exit(1);
+        fclose(f);
+    }
+
+    if (!n_samples) {
+        printf("[plhm-grid] No samples.\n");
+        exit(1);
+    }
+
+    if (!have_bounds) {
+        for (i = 0; i < 3; i++)
+            min[i] = max[i] = samples[0].measured[i];
+        for (j = 1; j < n_samples; j++)
+            for (i = 0; i < 3; i++) {
+                if (samples[j].measured[i] < min[i])
+                    min[i] = samples[j].measured[i];
+                if (samples[j].measured[i] > max[i])
+                    max[i] = samples[j].measured[i];
+            }
+        for (i = 0; i < 3; i++)
+            if (max[i] <= min[i])
+                max[i] = min[i] + 1.0f;
+    }
+
+    for (i = 0; i < 3; i++)
+        if (dims[i] < 2 || max[i] <= min[i]) {
+            printf("[plhm-grid] Invalid grid dimensions or bounds.\n");
+            exit(1);
+        }
+
+    int count = dims[0] * dims[1] * dims[2];
+    plhm_grid_node_t *nodes = calloc(count, sizeof(plhm_grid_node_t));
+    float *weight = calloc(count, sizeof(float));
+    float *rweight = calloc(count, sizeof(float));
+    if (!nodes || !weight || !rweight) {
+        printf("Out of memory.\n");
+        exit(1);
+    }
+
+    // spread each sample over its cell
+    for (j = 0; j < n_samples; j++)
+    {
+        sample_t *s = &samples[j];
+        int c[3];
+        float t[3];
+
+        for (i = 0; i < 3; i++) {
+            float u = ((s->measured[i] - min[i]) * (dims[i] - 1)
+                       / (max[i] - min[i]));
+            if (u < 0 || u > dims[i] - 1)
+                break;
+            c[i] = (int)u;
+            if (c[i] > dims[i] - 2)
+                c[i] = dims[i] - 2;
+            t[i] = u - c[i];
+        }
+        if (i < 3)
+            continue;   // outside the grid
+
+        for (i = 0; i < 8; i++)
+        {
+            int dx = i & 1, dy = (i >> 1) & 1, dz = i >> 2;
+            float w = ((dx ? t[0] : 1 - t[0]) * (dy ? t[1] : 1 - t[1])
+                       * (dz ? t[2] : 1 - t[2]));
+            int n = ((c[2] + dz) * dims[1] + (c[1] + dy)) * dims[0]
+                + (c[0] + dx);
+            int k;
+
+            for (k = 0; k < 3; k++)
+                nodes[n].offset[k] += w * (s->truth[k] - s->measured[k]);
+            weight[n] += w;
+
+            if (s->has_rotation) {
+                // q and -q are the same rotation; add in one hemisphere
+                float sign = dot4(nodes[n].rotation, s->rotation) < 0
+                    ? -1 : 1;
+                for (k = 0; k < 4; k++)
+                    nodes[n].rotation[k] += sign * w * s->rotation[k];
+                rweight[n] += w;
+            }
+        }
+    }
+
+    int filled = 0, rfilled = 0;
+    for (i = 0; i < count; i++)
+    {
+        int k;
+        if (weight[i] > 0) {
+            for (k = 0; k < 3; k++)
+                nodes[i].offset[k] /= weight[i];
+            filled++;
+        }
+        if (rweight[i] > 0) {
+            normalize4(nodes[i].rotation);
+            rfilled++;
+        }
+        else {
+            nodes[i].rotation[0] = 1;
+            nodes[i].rotation[1] = nodes[i].rotation[2]
+                = nodes[i].rotation[3] = 0;
+        }
+    }
+
+    if (!filled) {
+        printf("[plhm-grid] No samples inside the grid bounds.\n");
+        exit(1);
+    }
+    printf("[plhm-grid] %d samples, %d of %d nodes measured\n",
+           n_samples, filled, count);
+
+    // fill unmeasured nodes from the average of measured neighbours,
+    // growing outwards one layer per pass; rotations likewise, if any
+    // sample had one, else they stay the identity
+    while (filled < count || (rfilled > 0 && rfilled < count))
+    {
+        float *next = malloc(count * sizeof(float));
+        float *rnext = malloc(count * sizeof(float));
+        memcpy(next, weight, count * sizeof(float));
+        memcpy(rnext, rweight, count * sizeof(float));
+        for (z = 0; z < dims[2]; z++)
+            for (y = 0; y < dims[1]; y++)
+                for (x = 0; x < dims[0]; x++)
+                {
+                    int n = (z * dims[1] + y) * dims[0] + x;
+                    int nb[6][3] = { {x-1,y,z}, {x+1,y,z}, {x,y-1,z},
+                                     {x,y+1,z}, {x,y,z-1}, {x,y,z+1} };
+                    float sum[3] = { 0, 0, 0 }, q[4] = { 0, 0, 0, 0 };
+                    int k, m = 0, mr = 0;
+
+                    if (weight[n] > 0 && (rweight[n] > 0 || !rfilled))
+                        continue;
+
+                    for (k = 0; k < 6; k++) {
+                        int a, j;
+                        if (nb[k][0] < 0 || nb[k][0] >= dims[0]
+                            || nb[k][1] < 0 || nb[k][1] >= dims[1]
+                            || nb[k][2] < 0 || nb[k][2] >= dims[2])
+                            continue;
+                        a = (nb[k][2] * dims[1] + nb[k][1]) * dims[0]
+                            + nb[k][0];
+                        if (weight[n] <= 0 && weight[a] > 0) {
+                            sum[0] += nodes[a].offset[0];
+                            sum[1] += nodes[a].offset[1];
+                            sum[2] += nodes[a].offset[2];
+                            m++;
+                        }
+                        if (rfilled && rweight[n] <= 0 && rweight[a] > 0) {
+                            float sign = dot4(q, nodes[a].rotation) < 0
+                                ? -1 : 1;
+                            for (j = 0; j < 4; j++)
+                                q[j] += sign * nodes[a].rotation[j];
+                            mr++;
+                        }
+                    }
+
+                    if (m) {
+                        for (k = 0; k < 3; k++)
+                            nodes[n].offset[k] = sum[k] / m;
+                        next[n] = 1;
+                        filled++;
+                    }
+                    if (mr) {
+                        normalize4(q);
+                        memcpy(nodes[n].rotation, q, sizeof(q));
+                        rnext[n] = 1;
+                        rfilled++;
+                    }
+                }
+        memcpy(weight, next, count * sizeof(float));
+        memcpy(rweight, rnext, count * sizeof(float));
+        free(next);
+        free(rnext);
+    }
+
+    if (plhm_grid_save(output, dims, min, max, nodes))
+        exit(1);
+
+    printf("[plhm-grid] wrote %dx%dx%d grid over "
+           "(%g, %g, %g) - (%g, %g, %g) to %s\n",
+           dims[0], dims[1], dims[2], min[0], min[1], min[2],
+           max[0], max[1], max[2], output);
+
+    free(nodes);
+    free(weight);
+    free(rweight);
+    free(samples);
+    return 0;
+}
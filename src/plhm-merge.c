@@ -0,0 +1,272 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* Merge compressed recordings of several trackers into one, in time
+ * order, optionally on a common frame clock.  The stations of each
+ * input follow those of the inputs before it. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "config.h"
+
+#include <plhm.h>
+#include <plhm_recording.h>
+#include <plhm_merge.h>
+
+// records pushed to the merger at a time
+#define PUSH_RECORDS 64
+
+typedef struct {
+    const char *name;
+    plhm_rec_reader_t reader;
+    plhm_record_t *recs;
+    int n, pos;
+    int source;
+    int ended;
+} input_t;
+
+static plhm_rec_writer_t writer;
+static plhm_record_t frame[PLHM_FRAME_STATIONS];
+static int frame_n = 0;
+
+static int64_t record_us(const plhm_record_t *r)
+{
+    return (int64_t)r->readtime.tv_sec * 1000000 + r->readtime.tv_usec;
+}
+
+/* Decode the next block of an input.  Returns 0 on success, 1 at the
+ * end. */
+static int next_block(input_t *in)
+{
+    plhm_rec_block_t b;
+    int rc;
+
+    while ((rc = plhm_rec_next_block(&in->reader, &b)) == 0) {
+        in->n = plhm_rec_decode_block(&b, in->recs);
+        in->pos = 0;
+        if (in->n > 0)
+            return 0;
+        printf("[plhm-merge] Skipping a damaged block in %s\n", in->name);
+    }
+    if (rc < 0)
+        printf("[plhm-merge] %s is damaged, reading up to there.\n",
+               in->name);
+    return 1;
+}
+
+/* Highest station recorded, from the block headers. */
+static int max_station(input_t *in)
+{
+    plhm_rec_reader_t r = in->reader;
+    plhm_rec_block_t b;
+    uint32_t mask = 0;
+    int i;
+
+    while (plhm_rec_next_block(&r, &b) == 0)
+        mask |= b.station_mask;
+    for (i = PLHM_REC_MAX_STATIONS; i > 0; i--)
+        if (mask & (1 << (i - 1)))
+            return i;
+    return 0;
+}
+
+static void write_frame()
+{
+    if (frame_n)
+        plhm_rec_write(&writer, frame, frame_n);
+    frame_n = 0;
+}
+
+static void write_record(const plhm_record_t *r)
+{
+    // records of the same time form a frame
+    if (frame_n && (record_us(r) != record_us(&frame[0])
+                    || r->station <= frame[frame_n - 1].station
+                    || frame_n == PLHM_FRAME_STATIONS))
+        write_frame();
+    frame[frame_n++] = *r;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option long_options[] =
+    {
+        {"output",   required_argument, 0, 'o'},
+        {"window",   required_argument, 0, 'w'},
+        {"clock",    required_argument, 0, 'c'},
+        {"align",    no_argument,       0, 'a'},
+        {"help",     no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    static plhm_merge_t merge;
+    plhm_record_t out[PLHM_FRAME_STATIONS * 4];
+    input_t *inputs;
+    const char *output = 0;
+    float window = 50, rate = 0;
+    int align = 0, n_inputs, stations = 0, i, n;
+    unsigned long long written = 0;
+    FILE *file;
+
+    while (1)
+    {
+        int c = getopt_long(argc, argv, "o:w:c:ah", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+        case 'o':
+            output = optarg;
+            break;
+
+        case 'w':
+            window = atof(optarg);
+            break;
+
+        case 'c':
+            rate = atof(optarg);
+            break;
+
+        case 'a':
+            align = 1;
+            break;
+
+        default:
+            printf("Usage: %s [options] -o <output> <recording>...\n"
+"  Merge compressed recordings (plhm -z) into one, in time order.\n"
+"  Stations of each recording are numbered after those of the ones\n"
+"  before it.\n"
+"  -o --output=<path>    recording to write\n"
+"  -w --window=<ms>      reorder window (default 50)\n"
+"  -c --clock=<Hz>       output frames at a fixed rate, each station\n"
+"                        holding its latest record\n"
+"  -a --align            shift each recording to start with the first\n"
+"  -h --help             show this help\n"
+                   , argv[0]);
+            exit(c != 'h');
+        }
+    }
+
+    n_inputs = argc - optind;
+    if (!output || n_inputs < 1) {
+        printf("[plhm-merge] Expected an output and at least one "
+               "recording.  Try option '-h' for help.\n");
+        exit(1);
+    }
+    if (n_inputs > PLHM_MERGE_MAX_SOURCES) {
+        printf("[plhm-merge] At most %d recordings.\n",
+               PLHM_MERGE_MAX_SOURCES);
+        exit(1);
+    }
+
+    plhm_merge_init(&merge, window);
+    plhm_merge_set_clock(&merge, rate);
+
+    inputs = calloc(n_inputs, sizeof(input_t));
+    for (i = 0; i < n_inputs; i++)
+    {
+        input_t *in = &inputs[i];
+        in->name = argv[optind + i];
+        in->recs = malloc(sizeof(plhm_record_t) * PLHM_REC_BLOCK_FRAMES
+                          * PLHM_REC_MAX_STATIONS);
+        if (!in->recs || plhm_rec_reader_open(&in->reader, in->name))
+            exit(1);
+
+        in->source = plhm_merge_add_source(&merge, stations);
+        stations += max_station(in);
+        if (stations > PLHM_FRAME_STATIONS) {
+            printf("[plhm-merge] More than %d stations in all.\n",
+                   PLHM_FRAME_STATIONS);
+            exit(1);
+        }
+
+        in->ended = next_block(in);
+        if (align && !in->ended && i > 0 && !inputs[0].ended) {
+            int64_t d = record_us(&inputs[0].recs[0]) - record_us(in->recs);
+            plhm_merge_set_time_offset(&merge, in->source, d / 1000.0f);
+        }
+        if (in->ended)
+            plhm_merge_end_source(&merge, in->source);
+    }
+
+    file = fopen(output, "w");
+    if (!file || plhm_rec_writer_open(&writer, file)) {
+        printf("[plhm-merge] Could not write %s\n", output);
+        exit(1);
+    }
+
+    while (1)
+    {
+        // feed the input that is furthest behind
+        input_t *in = 0;
+        for (i = 0; i < n_inputs; i++) {
+            plhm_merge_source_t *s = &merge.sources[inputs[i].source];
+            if (inputs[i].ended)
+                continue;
+            if (!in || !s->records
+                || (merge.sources[in->source].records
+                    && s->latest < merge.sources[in->source].latest))
+                in = &inputs[i];
+        }
+
+        if (in) {
+            n = in->n - in->pos;
+            if (n > PUSH_RECORDS)
+                n = PUSH_RECORDS;
+            plhm_merge_push(&merge, in->source, in->recs + in->pos, n);
+            in->pos += n;
+            if (in->pos == in->n && (in->ended = next_block(in)))
+                plhm_merge_end_source(&merge, in->source);
+        }
+
+        while ((n = plhm_merge_pop(&merge, out,
+                                   sizeof(out) / sizeof(out[0]), 0)) > 0)
+        {
+            if (rate) {
+                plhm_rec_write(&writer, out, n);
+            }
+            else
+                for (i = 0; i < n; i++)
+                    write_record(&out[i]);
+            written += n;
+        }
+
+        if (!in)
+            break;
+    }
+    write_frame();
+
+    if (plhm_rec_writer_close(&writer) || fclose(file)) {
+        printf("[plhm-merge] Error writing %s\n", output);
+        exit(1);
+    }
+
+    printf("[plhm-merge] wrote %llu records of %d stations to %s\n",
+           written, stations, output);
+    printf("%-24s %8s %6s %9s %9s %10s %9s\n", "recording", "records",
+           "late", "lat. ms", "max ms", "offset ms", "skew ppm");
+    for (i = 0; i < n_inputs; i++) {
+        plhm_merge_stats_t st;
+        plhm_merge_get_stats(&merge, inputs[i].source, &st);
+        printf("%-24s %8llu %6llu %9.3f %9.3f %10.3f %9.1f\n",
+               inputs[i].name, st.records, st.late + st.overflow,
+               st.latency_mean, st.latency_max, st.offset, st.skew);
+        plhm_rec_reader_close(&inputs[i].reader);
+        free(inputs[i].recs);
+    }
+    free(inputs);
+    return 0;
+}
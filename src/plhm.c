@@ -17,29 +17,48 @@
 #include <getopt.h>
 #include <unistd.h>
 #include <signal.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
 
 #include "config.h"
 
 #ifdef HAVE_LIBLO
 #include <lo/lo.h>
+#include "subscribers.h"
 #endif
 
 #include <plhm.h>
+#include <plhm_shm.h>
+#include <plhm_history.h>
+#include <plhm_distortion.h>
+#include <plhm_filter.h>
+#include <plhm_features.h>
+#include <plhm_triggers.h>
+#include <plhm_recording.h>
+#include <plhm_resample.h>
+
+#include "sink.h"
+#include "metrics.h"
+#include "plugins.h"
 
 double starttime;
-double curtime;
 struct timeval temp;
-struct timeval prev;
 
 int listen_port=0;
-int started = 0;
-int device_found = 0;
-int data_good = 0;
+volatile int started = 0;
+volatile int device_found = 0;
+volatile int data_good = 0;
 int poll_period = 0;
 
-#ifdef HAVE_LIBLO
-lo_address addr = 0;
+/* current acquisition configuration, changed only by the acquisition
+ * thread (see apply_control_requests) */
+int data_fields = 0;
+plhm_rate data_rate = PLHM_RATE_240;
+int stations_disabled = 0;
 
+#ifdef HAVE_LIBLO
 void liblo_error(int num, const char *msg, const char *path);
 int start_handler(const char *path, const char *types, lo_arg **argv, int argc,
                   void *data, void *user_data);
@@ -47,11 +66,35 @@ int stop_handler(const char *path, const char *types, lo_arg **argv, int argc,
                  void *data, void *user_data);
 int status_handler(const char *path, const char *types, lo_arg **argv, int argc,
                    void *data, void *user_data);
-#else
-int addr = 1;
+int fields_handler(const char *path, const char *types, lo_arg **argv, int argc,
+                   void *data, void *user_data);
+int rate_handler(const char *path, const char *types, lo_arg **argv, int argc,
+                 void *data, void *user_data);
+int station_handler(const char *path, const char *types, lo_arg **argv, int argc,
+                    void *data, void *user_data);
+int subscribe_handler(const char *path, const char *types, lo_arg **argv,
+                      int argc, void *data, void *user_data);
+int unsubscribe_handler(const char *path, const char *types, lo_arg **argv,
+                        int argc, void *data, void *user_data);
+int stats_handler(const char *path, const char *types, lo_arg **argv, int argc,
+                  void *data, void *user_data);
+int history_handler(const char *path, const char *types, lo_arg **argv,
+                    int argc, void *data, void *user_data);
 #endif
 
 int read_stations_and_send(plhm_t *pol, int poll);
+void send_ticks(const struct timeval *now);
+int wait_for_frame(plhm_t *pol);
+void process_frame(frame_t *f);
+void write_file_frame(const frame_t *f, void *user_data);
+void write_shm_frame(const frame_t *f, void *user_data);
+void write_history_frame(const frame_t *f, void *user_data);
+int load_plugins();
+#ifdef HAVE_LIBLO
+void write_osc_frame(const frame_t *f, void *user_data);
+#endif
+int has_destination();
+int apply_control_requests(plhm_t *pol);
 
 typedef union {
     const int *i;
@@ -68,33 +111,187 @@ typedef union {
 #define LOG(...) if (outfile) { fprintf(outfile, __VA_ARGS__); }
 
 /* option flags */
-static int daemon_flag = 0;
+static volatile sig_atomic_t daemon_flag = 0;    // cleared on SIGINT
 static int hex_flag = 0;
+static int ascii_flag = 0;
 static int euler_flag = 0;
 static int position_flag = 0;
 static int timestamp_flag = 0;
 static int reset_flag = 0;
+static int compress_flag = 0;
+static int uring_flag = 0;
+static int auto_rate_flag = 0;
 
 const char *device_name = "/dev/ttyUSB0";
 const char *osc_url = 0;
+const char *shm_name = 0;
+plhm_shm_t shm;
+const char *history_name = 0;
+float history_seconds = 0;
+plhm_history_t history;
+const char *grid_name = 0;
+plhm_grid_t grid;
+plhm_filter_t filter;
+float filter_lead = 0;
+plhm_features_t features;
+const char *triggers_name = 0;
+plhm_triggers_t triggers;
+int resampling = 0;
+plhm_resample_t resampler;
+
+/* the current frame, per component, for the processing stages */
+plhm_frame_t stage_frame;
+
+/* Output stages.  Frames are published to a ring shared by the
+ * sinks, each reading it on its own thread; the policy decides what
+ * happens when one falls behind. */
+sink_ring_t ring;
+sink_t file_sink;
+sink_policy file_policy = SINK_BLOCK;
+sink_t shm_sink;
+sink_policy shm_policy = SINK_COALESCE;
+sink_t history_sink;
+sink_policy history_policy = SINK_BLOCK;
+#ifdef HAVE_LIBLO
+sink_t osc_sink;
+sink_policy osc_policy = SINK_COALESCE;
+#endif
+
+/* Output plugins, and -b policies naming them, resolved once they
+ * are loaded. */
+const char *plugin_specs[MAX_PLUGINS];
+plugin_t plugins[MAX_PLUGINS];
+int n_plugins = 0;
+int plugin_fields = 0;
+struct { const char *name; sink_policy policy; } plugin_policies[MAX_PLUGINS];
+int n_plugin_policies = 0;
 
 FILE *outfile = 0;
+plhm_rec_writer_t recorder;
+
+/* Counters for /liberty/stats and the periodic dump.  The acquisition
+ * thread updates them once per frame, and copies the library's
+ * counters once a second. */
+typedef struct {
+    pthread_mutex_t lock;
+    double start;                   // monotonic us
+    unsigned long long frames;      // frames read
+    unsigned long long missing;     // of which lacked an active station
+    histogram_t process;            // us from read to published
+    plhm_stats_t device;
+    unsigned long calls;            // input system calls
+    double records_per_s, frames_per_s, calls_per_frame;
+    plhm_link_t link;               // measured is the last second's
+    int link_short;                 // seconds it has fallen short
+
+    // as of the last rate update
+    double rate_time;
+    unsigned long long rate_records, rate_frames, rate_bytes;
+    unsigned long rate_calls;
+} daemon_stats_t;
+
+daemon_stats_t stats = { PTHREAD_MUTEX_INITIALIZER };
+const char *stats_path = 0;
+int stats_period = 10;
+pthread_t stats_thread;
+pthread_mutex_t stats_wait_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t stats_wait = PTHREAD_COND_INITIALIZER;
+int stats_running = 0;
+
+void update_stats(const plhm_t *pol, int missing, double process_us);
+void report_link(const plhm_t *pol);
+void write_stats_json(FILE *f);
+int start_stats_dump();
+void stop_stats_dump();
+
+/* Requests from the OSC thread are queued here and applied by the
+ * acquisition thread between frames, so that the device and the
+ * destination address are only ever touched from one thread. */
+typedef enum {
+    CONTROL_START,
+    CONTROL_STOP,
+    CONTROL_FIELDS,
+    CONTROL_RATE,
+    CONTROL_STATION,
+    CONTROL_SUBSCRIBE,
+    CONTROL_UNSUBSCRIBE,
+} control_type;
+
+typedef struct {
+    control_type type;
+    int arg[2];
+#ifdef HAVE_LIBLO
+    subscription_t sub;
+#endif
+} control_request;
+
+#define CONTROL_QUEUE_SIZE 32
+control_request control_queue[CONTROL_QUEUE_SIZE];
+int control_head = 0;
+int control_count = 0;
+pthread_mutex_t control_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int push_control_request(const control_request *req)
+{
+    int rc = 1;
+    pthread_mutex_lock(&control_lock);
+    if (control_count < CONTROL_QUEUE_SIZE) {
+        control_queue[(control_head + control_count) % CONTROL_QUEUE_SIZE]
+            = *req;
+        control_count++;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&control_lock);
+    if (rc)
+        printf("[plhm] control queue full, request dropped.\n");
+    return rc;
+}
+
+int take_control_requests(control_request *reqs)
+{
+    int n;
+    pthread_mutex_lock(&control_lock);
+    for (n = 0; n < control_count; n++)
+        reqs[n] = control_queue[(control_head + n) % CONTROL_QUEUE_SIZE];
+    control_head = (control_head + n) % CONTROL_QUEUE_SIZE;
+    control_count = 0;
+    pthread_mutex_unlock(&control_lock);
+    return n;
+}
 
 void ctrlc_handler(int sig) {
+    // also leave the daemon loop, which would otherwise wait for a
+    // new start request
     started = 0;
+    daemon_flag = 0;
 }
 
 int main(int argc, char *argv[])
 {
     static struct option long_options[] =
     {
-        {"daemon",   no_argument,       &daemon_flag,   1},
+        {"daemon",   no_argument,       0,              'D'},
         {"device",   required_argument, 0,              'd'},
         {"hex",      no_argument,       &hex_flag,      1},
+        {"ascii",    no_argument,       &ascii_flag,    1},
+        {"uring",    no_argument,       &uring_flag,    1},
+        {"auto-rate",no_argument,       &auto_rate_flag,1},
         {"euler",    no_argument,       &euler_flag,    1},
         {"position", no_argument,       &position_flag, 1},
         {"timestamp",no_argument,       &timestamp_flag,1},
         {"output",   optional_argument, 0,              'o'},
+        {"compress", no_argument,       &compress_flag, 1},
+        {"shm",      optional_argument, 0,              'm'},
+        {"policy",   required_argument, 0,              'b'},
+        {"history",  required_argument, 0,              'k'},
+        {"plugin",   required_argument, 0,              'x'},
+        {"stats",    required_argument, 0,              'j'},
+        {"grid",     required_argument, 0,              'g'},
+        {"filter",   required_argument, 0,              'f'},
+        {"predict",  required_argument, 0,              'L'},
+        {"features", required_argument, 0,              'F'},
+        {"triggers", required_argument, 0,              'R'},
+        {"resample", required_argument, 0,              'r'},
 #ifdef HAVE_LIBLO
         {"send",     required_argument, 0,              's'},
         {"listen",   required_argument, 0,              'l'},
@@ -109,7 +306,7 @@ int main(int argc, char *argv[])
     while (1)
     {
         int option_index = 0;
-        int c = getopt_long(argc, argv, "Dd:HEPTo::s:l:hVp::",
+        int c = getopt_long(argc, argv, "Dd:HAauEPTo::zm::k:x:b:j:g:f:L:F:R:r:s:l:hVp::",
                             long_options, &option_index);
         if (c==-1)
             break;
@@ -129,6 +326,18 @@ int main(int argc, char *argv[])
             hex_flag = 1;
             break;
 
+        case 'A':
+            ascii_flag = 1;
+            break;
+
+        case 'u':
+            uring_flag = 1;
+            break;
+
+        case 'a':
+            auto_rate_flag = 1;
+            break;
+
         case 'P':
             position_flag = 1;
             break;
@@ -147,7 +356,7 @@ int main(int argc, char *argv[])
             break;
 
 #ifdef HAVE_LIBLO
-        case 'u':
+        case 's':
             // handle OSC url (liblo)
             osc_url = optarg;
             break;
@@ -177,6 +386,131 @@ int main(int argc, char *argv[])
                 outfile = stdout;
             break;
 
+        case 'z':
+            compress_flag = 1;
+            break;
+
+        case 'm':
+            // publish the latest frame in shared memory
+            shm_name = optarg ? optarg : PLHM_SHM_DEFAULT_NAME;
+            break;
+
+        case 'k':
+        {
+            // <seconds>[,<name>]
+            char *c = strchr(optarg, ',');
+            history_seconds = atof(optarg);
+            history_name = c ? c+1 : PLHM_HISTORY_DEFAULT_NAME;
+            if (history_seconds <= 0 || !*history_name) {
+                printf("[plhm] Unknown history '%s'.\n", optarg);
+                exit(1);
+            }
+            break;
+        }
+
+        case 'x':
+            // <path>[:<args>], loaded once options are parsed
+            if (n_plugins == MAX_PLUGINS) {
+                printf("[plhm] At most %d plugins.\n", MAX_PLUGINS);
+                exit(1);
+            }
+            plugin_specs[n_plugins++] = optarg;
+            break;
+
+        case 'g':
+            // distortion compensation grid, see plhm-grid
+            grid_name = optarg;
+            break;
+
+        case 'f':
+            if (plhm_filter_parse(&filter, optarg)) {
+                printf("[plhm] Unknown filter '%s'.\n", optarg);
+                exit(1);
+            }
+            break;
+
+        case 'L':
+            filter_lead = atof(optarg);
+            break;
+
+        case 'F':
+        {
+            int f = plhm_features_parse(optarg);
+            if (f <= 0) {
+                printf("[plhm] Unknown features '%s'.\n", optarg);
+                exit(1);
+            }
+            plhm_features_init(&features, f);
+            break;
+        }
+
+        case 'R':
+            // regions and proximity rules, see plhm_triggers.h
+#ifdef HAVE_LIBLO
+            triggers_name = optarg;
+#else
+            printf("[plhm] Triggers need OSC support, which this plhm was "
+                   "built without.\n");
+            exit(1);
+#endif
+            break;
+
+        case 'r':
+            if (plhm_resample_parse(&resampler, optarg)) {
+                printf("[plhm] Unknown resampling '%s'.\n", optarg);
+                exit(1);
+            }
+            resampling = 1;
+            break;
+
+        case 'b':
+        {
+            // <sink>:<policy>
+            sink_policy pol;
+            const char *c = strchr(optarg, ':');
+            if (!c || sink_parse_policy(c+1, &pol)) {
+                printf("[plhm] Unknown policy '%s'.\n", optarg);
+                exit(1);
+            }
+            if (!strncmp(optarg, "file:", 5))
+                file_policy = pol;
+            else if (!strncmp(optarg, "shm:", 4))
+                shm_policy = pol;
+            else if (!strncmp(optarg, "history:", 8))
+                history_policy = pol;
+#ifdef HAVE_LIBLO
+            else if (!strncmp(optarg, "osc:", 4))
+                osc_policy = pol;
+#endif
+            else if (n_plugin_policies < MAX_PLUGINS) {
+                // perhaps a plugin
+                *(char*)c = 0;
+                plugin_policies[n_plugin_policies].name = optarg;
+                plugin_policies[n_plugin_policies++].policy = pol;
+            }
+            else {
+                printf("[plhm] Unknown sink in '%s'.\n", optarg);
+                exit(1);
+            }
+            break;
+        }
+
+        case 'j':
+        {
+            // <path>[,<seconds>]
+            char *c = strrchr(optarg, ',');
+            stats_path = optarg;
+            if (c) {
+                *c = 0;
+                stats_period = atoi(c+1);
+            }
+            if (!*stats_path || stats_period < 1) {
+                printf("[plhm] Unknown statistics output '%s'.\n", optarg);
+                exit(1);
+            }
+            break;
+        }
+
         case 'V':
             printf(PACKAGE_STRING "  (" __DATE__ ")\n");
             exit(0);
@@ -196,8 +530,58 @@ int main(int argc, char *argv[])
 "  -T --timestamp        request timestamp data\n"
 "  -o --output=[path]    write data to stdout, or to a file\n"
 "                        if path is specified\n"
+"  -z --compress         write a compressed recording rather than\n"
+"                        text, see plhm_recording.h\n"
 "  -H --hex              write float values as hexidecimal\n"
+"  -A --ascii            acquire in ASCII rather than binary mode\n"
+"  -u --uring            read the device through io_uring, where\n"
+"                        the kernel supports it\n"
+"  -a --auto-rate        measure what the link delivers at each rate\n"
+"                        and use the fastest it carries in full\n"
+"  -m --shm=[name]       publish the latest frame in POSIX shared\n"
+"                        memory, by default " PLHM_SHM_DEFAULT_NAME "\n"
+"  -k --history=<seconds>[,<name>]\n"
+"                        keep the last seconds of every station in\n"
+"                        POSIX shared memory for range queries, by\n"
+"                        default " PLHM_HISTORY_DEFAULT_NAME "\n"
+"  -b --policy=<sink>:<policy>\n"
+"                        what to do when the file, shm, history or\n"
+"                        osc sink falls behind: block, drop (oldest\n"
+"                        frame) or coalesce (to the latest frame per\n"
+"                        station); defaults are file:block,\n"
+"                        shm:coalesce, history:block and osc:coalesce;\n"
+"                        plugins choose their own\n"
+"  -x --plugin=<path>[:<args>]\n"
+"                        send frames to an output plugin, see\n"
+"                        plhm_plugin.h; a name without a slash is\n"
+"                        looked for in " PLHM_PLUGIN_DIR "\n"
+"  -j --stats=<path>[,<seconds>]\n"
+"                        write counters and latency histograms as\n"
+"                        JSON to path, or stderr for -, every 10 s\n"
+"                        or as given\n"
+"  -g --grid=<path>      correct positions and orientations for\n"
+"                        field distortion using a grid file made\n"
+"                        by plhm-grid\n"
+"  -f --filter=<filter>  smooth each station, with one of\n"
+"                        euro[:mincutoff[,beta[,dcutoff]]]\n"
+"                          one-euro filter, default 1,0.01,1\n"
+"                        kalman[:accel_noise[,meas_noise]]\n"
+"                          constant-velocity Kalman filter,\n"
+"                          default 1000,0.001\n"
+"  -L --predict=<ms>     extrapolate filtered poses forward in time\n"
+"  -r --resample=<rate>[/<div>][:<method>[,<ms>]]\n"
+"                        output frames at rate/div Hz, interpolated\n"
+"                        linear(ly) or cubic (default), waiting at\n"
+"                        most ms for input (default 20), e.g.\n"
+"                        48000/64 for every 64 samples at 48 kHz\n"
+"  -F --features=<list>  compute gesture features and output them\n"
+"                        with the data, any of v(elocity),\n"
+"                        a(cceleration), j(erk), s(peed),\n"
+"                        w (angular velocity), d(istances)\n"
 #ifdef HAVE_LIBLO
+"  -R --triggers=<path>  send OSC events when stations enter or\n"
+"                        leave the regions defined in a file, or\n"
+"                        come near each other\n"
 "  -s --send=<url>       provide a URL for OSC destination\n"
 "                        this URL must be liblo-compatible,\n"
 "                        e.g., osc.udp://localhost:9999\n"
@@ -218,16 +602,32 @@ int main(int argc, char *argv[])
         }
     }
 
-    int slp = 0;
+    int slp = 0, i;
+
+    if (load_plugins())
+        exit(1);
 
     // sanity check: ensure user requested something
-    if (!(euler_flag || position_flag || timestamp_flag)) {
+    if (!(euler_flag || position_flag || timestamp_flag || plugin_fields)) {
         printf("[plhm] No data requested.  Try option '-h' for help.\n");
         exit(1);
     }
 
+    if (compress_flag && !outfile) {
+        printf("[plhm] -z compresses the output of -o, which was not "
+               "given.\n");
+        exit(1);
+    }
+
+    data_fields = ((position_flag ? PLHM_DATA_POSITION : 0)
+                   | (euler_flag ? PLHM_DATA_EULER : 0)
+                   | (timestamp_flag ? PLHM_DATA_TIMESTAMP : 0)
+                   | plugin_fields);
+
     plhm_t pol;
     memset((void*)&pol, 0, sizeof(plhm_t));
+    if (uring_flag)
+        plhm_set_input(&pol, PLHM_INPUT_URING);
 
 #ifdef HAVE_LIBLO
     // setup OSC server
@@ -247,17 +647,126 @@ int main(int argc, char *argv[])
                                     status_handler, &pol);
         lo_server_thread_add_method(st, "/liberty/status", "i",
                                     status_handler, &pol);
+        lo_server_thread_add_method(st, "/liberty/stats", "si",
+                                    stats_handler, &pol);
+        lo_server_thread_add_method(st, "/liberty/stats", "i",
+                                    stats_handler, &pol);
+        lo_server_thread_add_method(st, "/liberty/history", "siif",
+                                    history_handler, &pol);
+        lo_server_thread_add_method(st, "/liberty/history", "iif",
+                                    history_handler, &pol);
+        lo_server_thread_add_method(st, "/liberty/history", "siidd",
+                                    history_handler, &pol);
+        lo_server_thread_add_method(st, "/liberty/history", "iidd",
+                                    history_handler, &pol);
+        lo_server_thread_add_method(st, "/liberty/fields", "s",
+                                    fields_handler, &pol);
+        lo_server_thread_add_method(st, "/liberty/rate", "i",
+                                    rate_handler, &pol);
+        lo_server_thread_add_method(st, "/liberty/station", "ii",
+                                    station_handler, &pol);
+        lo_server_thread_add_method(st, "/liberty/subscribe", "siiis",
+                                    subscribe_handler, &pol);
+        lo_server_thread_add_method(st, "/liberty/subscribe", "siiisi",
+                                    subscribe_handler, &pol);
+        lo_server_thread_add_method(st, "/liberty/unsubscribe", "si",
+                                    unsubscribe_handler, &pol);
         lo_server_thread_start(st);
     }
 
     if (osc_url != 0) {
-        addr = lo_address_new_from_url(osc_url);
-        if (!addr) {
+        subscription_t sub;
+        lo_address a = lo_address_new_from_url(osc_url);
+        if (!a) {
             printf("[plhm] Couldn't open OSC address %s\n", osc_url);
             exit(1);
         }
+        memset(&sub, 0, sizeof(sub));
+        strncpy(sub.host, lo_address_get_hostname(a), sizeof(sub.host)-1);
+        sub.port = atoi(lo_address_get_port(a));
+        lo_address_free(a);
+        sub.primary = 1;
+        sub.station_mask = ~0;
+        sub.fields = ~0;
+        sub.features = ~0;
+        if (subscription_resolve(&sub))
+            exit(1);
+        subscribers_add(&sub, 0);
+    }
+#endif
+
+    if (filter_lead) {
+        if (filter.type == PLHM_FILTER_NONE) {
+            printf("[plhm] Prediction requires a filter (option -f).\n");
+            exit(1);
+        }
+        plhm_filter_set_prediction(&filter, filter_lead);
+    }
+    plhm_frame_clear(&stage_frame);
+
+    if (triggers_name) {
+        plhm_triggers_init(&triggers);
+        if (plhm_triggers_load(&triggers, triggers_name)) {
+            printf("[plhm] Couldn't load triggers %s\n", triggers_name);
+            exit(1);
+        }
+        printf("[plhm] %d regions, %d proximity rules\n",
+               triggers.n_regions, triggers.n_rules);
+    }
+
+    if (grid_name && plhm_grid_load(&grid, grid_name)) {
+        printf("[plhm] Couldn't load distortion grid %s\n", grid_name);
+        exit(1);
+    }
+
+    if (shm_name && plhm_shm_create(&shm, shm_name)) {
+        printf("[plhm] Couldn't create shared memory %s\n", shm_name);
+        exit(1);
+    }
+
+    if (history_name) {
+        // room for the fastest output, the resampled rate or 240 Hz
+        double rate = 240;
+        if (resampling && (double)resampler.num / resampler.den > rate)
+            rate = (double)resampler.num / resampler.den;
+        if (plhm_history_create(&history, history_name,
+                                history_seconds * rate + 1)) {
+            printf("[plhm] Couldn't create the history %s\n", history_name);
+            exit(1);
+        }
     }
+
+    if (outfile && compress_flag) {
+        if (outfile == stdout && isatty(fileno(stdout))) {
+            printf("[plhm] Not writing a compressed recording to a terminal.\n");
+            exit(1);
+        }
+        if (plhm_rec_writer_open(&recorder, outfile)) {
+            printf("[plhm] Couldn't start the recording.\n");
+            exit(1);
+        }
+    }
+
+    stats.start = stats.rate_time = monotonic_us();
+    sink_ring_init(&ring);
+    if (outfile && sink_start(&file_sink, &ring, "file", file_policy,
+                              write_file_frame, 0))
+        exit(1);
+    if (shm_name && sink_start(&shm_sink, &ring, "shm", shm_policy,
+                               write_shm_frame, 0))
+        exit(1);
+    if (history_name && sink_start(&history_sink, &ring, "history",
+                                   history_policy, write_history_frame, 0))
+        exit(1);
+    for (i = 0; i < n_plugins; i++)
+        if (plugin_start(&plugins[i], &ring))
+            exit(1);
+#ifdef HAVE_LIBLO
+    if (sink_start(&osc_sink, &ring, "osc", osc_policy, write_osc_frame, 0))
+        exit(1);
 #endif
+    if (stats_path && start_stats_dump())
+        exit(1);
 
     started = 1;
 
@@ -266,7 +775,10 @@ int main(int argc, char *argv[])
     while (started || daemon_flag) {
         sleep(slp);
         slp = 1;
-        
+
+        // the device is closed, so this only updates the configuration
+        apply_control_requests(&pol);
+
         // Loop until device is available.
         if (plhm_find_device(device_name)) {
             if (daemon_flag) {
@@ -280,7 +792,9 @@ int main(int argc, char *argv[])
         device_found = 1;
 
         // Don't open device if nobody is listening
-        if (!(started && (addr || outfile)) && daemon_flag)
+        if (!(started && (has_destination() || outfile || shm_name
+                          || history_name))
+            && daemon_flag)
             continue;
 
         if (plhm_open_device(&pol, device_name))
@@ -316,28 +830,44 @@ int main(int argc, char *argv[])
         // check what stations are available
         CHECKBRK("get_stations",plhm_get_stations(&pol));
 
+        // keep at least one station, even if all were disabled
+        int s, rc = 0;
+        for (s = 0; s < 16 && !rc; s++)
+            if ((stations_disabled & (1 << s)) && (pol.station_mask & (1 << s))
+                && (pol.station_mask & ~(1 << s)))
+                rc = plhm_set_station_active(&pol, s, 0);
+        CHECKBRK("set_station_active",rc);
+
         CHECKBRK("set_hemisphere",plhm_set_hemisphere(&pol));
 
         CHECKBRK("set_units",plhm_set_units(&pol, PLHM_UNITS_METRIC));
 
-        CHECKBRK("set_rate",plhm_set_rate(&pol, PLHM_RATE_240));
+        CHECKBRK("set_rate",plhm_set_rate(&pol, data_rate));
 
-        CHECKBRK("set_data_fields",
-                 plhm_set_data_fields(&pol,
-                                      (position_flag ? PLHM_DATA_POSITION : 0)
-                                      | (euler_flag ? PLHM_DATA_EULER : 0)
-                                      | (timestamp_flag ? PLHM_DATA_TIMESTAMP : 0)));
+        CHECKBRK("set_data_fields",plhm_set_data_fields(&pol, data_fields));
 
         gettimeofday(&temp, NULL);
         starttime = (temp.tv_sec * 1000.0) + (temp.tv_usec / 1000.0);
 
-        CHECKBRK("binary_mode",plhm_binary_mode(&pol));
+        if (ascii_flag) {
+            CHECKBRK("text_mode",plhm_text_mode(&pol));
+        }
+        else {
+            CHECKBRK("binary_mode",plhm_binary_mode(&pol));
+        }
+
+        if (auto_rate_flag && !poll_period)
+            CHECKBRK("choose_rate",plhm_choose_rate(&pol, 500, &data_rate,
+                                                    &pol.link));
+        report_link(&pol);
 
         if (!poll_period)
             CHECKBRK("data_request_continuous",plhm_data_request_continuous(&pol));
 
         /* loop getting data until stop is requested or error occurs */
         while (started && !read_stations_and_send(&pol,poll_period!=0)) {
+            if (apply_control_requests(&pol))
+                break;
             if (poll_period > 0)
                 usleep(poll_period);
         }
@@ -359,14 +889,41 @@ int main(int argc, char *argv[])
 
     plhm_close_device(&pol);
 
+    if (stats_path)
+        stop_stats_dump();
+
 #ifdef HAVE_LIBLO
     if (st)
         lo_server_thread_free(st);
-    if (addr)
-        lo_address_free(addr);
+    sink_stop(&osc_sink);
+    subscribers_free();
 #endif
-    if (outfile && (outfile != stdout))
-        fclose(outfile);
+    if (outfile) {
+        sink_stop(&file_sink);
+        if (compress_flag)
+            plhm_rec_writer_close(&recorder);
+        if (outfile != stdout)
+            fclose(outfile);
+    }
+    if (shm_name) {
+        sink_stop(&shm_sink);
+        plhm_shm_close(&shm);
+    }
+    if (history_name) {
+        sink_stop(&history_sink);
+        plhm_history_close(&history);
+    }
+    for (i = 0; i < n_plugins; i++)
+        plugin_unload(&plugins[i]);
+    sink_ring_free(&ring);
+    if (grid_name)
+        plhm_grid_free(&grid);
+    if (triggers_name)
+        plhm_triggers_free(&triggers);
+    if (resampling)
+        printf("[plhm] resampled %llu frames, %llu held by the latency "
+               "bound, %llu skipped\n", resampler.ticks, resampler.forced,
+               resampler.skipped);
 
     return 0;
 }
@@ -390,6 +947,124 @@ int timeval_subtract (struct timeval *result,
     return x->tv_sec < y->tv_sec;
 }
 
+/* Apply queued control requests at a frame boundary.  If the device
+ * is streaming, continuous output is paused only for as long as it
+ * takes to send the new configuration, and the decoder switches to
+ * the new record layout before the next frame is read. */
+int apply_control_requests(plhm_t *pol)
+{
+    control_request reqs[CONTROL_QUEUE_SIZE];
+    int i, bit, n = take_control_requests(reqs);
+    int fields = data_fields, rate = data_rate, disabled = stations_disabled;
+    int known = pol->device_open ? pol->detected_mask : 0;
+    struct timeval before, after, diff;
+
+    if (!n)
+        return 0;
+
+    gettimeofday(&before, NULL);
+#ifdef HAVE_LIBLO
+    double now = (before.tv_sec * 1000.0) + (before.tv_usec / 1000.0);
+#endif
+
+    for (i = 0; i < n; i++)
+    {
+        switch (reqs[i].type)
+        {
+        case CONTROL_START:
+#ifdef HAVE_LIBLO
+            if (reqs[i].sub.addr)
+                subscribers_add(&reqs[i].sub, now);
+#endif
+            started = 1;
+            break;
+        case CONTROL_SUBSCRIBE:
+#ifdef HAVE_LIBLO
+            subscribers_add(&reqs[i].sub, now);
+#endif
+            break;
+        case CONTROL_UNSUBSCRIBE:
+#ifdef HAVE_LIBLO
+            subscribers_remove(reqs[i].sub.host, reqs[i].sub.port);
+#endif
+            break;
+        case CONTROL_STOP:
+            started = 0;
+            break;
+        case CONTROL_FIELDS:
+            // plugins keep the fields they asked for
+            fields = reqs[i].arg[0] | plugin_fields;
+            break;
+        case CONTROL_RATE:
+            rate = reqs[i].arg[0];
+            break;
+        case CONTROL_STATION:
+            // once stations are known, only those with a sensor count,
+            // and the last active one stays on: without it no records
+            // would be read at all
+            bit = 1 << reqs[i].arg[0];
+            if (known && !(known & bit))
+                printf("[plhm] no sensor at station %d\n", reqs[i].arg[0] + 1);
+            else if (reqs[i].arg[1])
+                disabled &= ~bit;
+            else if (known && !(known & ~(disabled | bit)))
+                printf("[plhm] station %d is the last active, not disabled\n",
+                       reqs[i].arg[0] + 1);
+            else
+                disabled |= bit;
+            break;
+        }
+    }
+
+    if (fields == data_fields && rate == data_rate
+        && disabled == stations_disabled)
+        return 0;
+
+    int changed = disabled ^ stations_disabled;
+    data_fields = fields;
+    data_rate = rate;
+    stations_disabled = disabled;
+
+    if (!pol->device_open || !started)
+        return 0;
+
+    if (plhm_pause_continuous(pol))
+        return 1;
+
+    if (plhm_set_rate(pol, data_rate))
+        return 1;
+
+    for (i = 0; i < 16; i++)
+        if ((changed & pol->detected_mask) & (1 << i))
+            if (plhm_set_station_active(pol, i, !(disabled & (1 << i))))
+                return 1;
+
+    if (pol->fields != data_fields)
+        if (plhm_set_data_fields(pol, data_fields))
+            return 1;
+
+    if (!poll_period)
+        if (plhm_resume_continuous(pol))
+            return 1;
+
+    gettimeofday(&after, NULL);
+    timeval_subtract(&diff, &after, &before);
+    printf("[plhm] reconfigured in %.1f ms\n",
+           diff.tv_sec * 1000.0 + diff.tv_usec / 1000.0);
+
+    return 0;
+}
+
+int has_destination()
+{
+#ifdef HAVE_LIBLO
+    return subscribers_count() > 0;
+#else
+    // without OSC, keep acquiring as before
+    return 1;
+#endif
+}
+
 void log_float(float f)
 {
     multiptr p;
@@ -404,103 +1079,459 @@ void log_float(float f)
         LOG(", %.4f", f);
 }
 
-int read_stations_and_send(plhm_t *pol, int poll)
+/* Output the resampled ticks that are ready by now. */
+void send_ticks(const struct timeval *now)
 {
-    struct timeval now, diff;
+    frame_t *f;
 
-    static int c=0;
-    if (c++ > 30) {
-        gettimeofday(&now, NULL);
-        timeval_subtract(&diff, &now, &prev);
-        prev.tv_sec = now.tv_sec;
-        prev.tv_usec = now.tv_usec;
+    while (1) {
+        f = sink_ring_acquire(&ring);
+        if ((f->n = plhm_resample_pull(&resampler, f->recs, now,
+                                       &f->tick)) <= 0)
+            break;
+        process_frame(f);
+    }
+}
 
-        fprintf(stderr, "Update frequency: %0.2f Hz           \r",
-                30.0 / (diff.tv_usec/1000000.0 + diff.tv_sec));
-        c=0;
+/* Wait for the next frame, outputting the ticks that the latency bound
+ * makes due meanwhile, for up to the time a read would wait. */
+int wait_for_frame(plhm_t *pol)
+{
+    struct timeval now, start;
+    int ms, rc;
+
+    gettimeofday(&start, NULL);
+    while (1) {
+        gettimeofday(&now, NULL);
+        ms = plhm_resample_timeout(&resampler, &now);
+        if (ms < 0 || (now.tv_sec - start.tv_sec) * 1000
+                      + (now.tv_usec - start.tv_usec) / 1000 > 500)
+            return 0;
+        rc = plhm_wait_input(pol, ms);
+        if (rc)
+            return rc < 0;
+        gettimeofday(&now, NULL);
+        send_ticks(&now);
     }
+}
+
+int read_stations_and_send(plhm_t *pol, int poll)
+{
+    struct timeval now;
+    double read_done;
+    int seen = 0;
 
     if (poll)
         plhm_data_request(pol);
-    
-    plhm_record_t rec;
-    int s;
+    else if (resampling && wait_for_frame(pol)) {
+        data_good = 0;
+        return 1;
+    }
+
+    // records are read straight into the ring, unless they are
+    // resampled first; a frame that is not published is reused
+    static plhm_record_t read_recs[SINK_MAX_STATIONS];
+    frame_t *f = resampling ? 0 : sink_ring_acquire(&ring);
+    plhm_record_t *recs = f ? f->recs : read_recs;
+    int n;
 
-    for (s = 0; s < pol->stations; s++)
+    for (n = 0; n < pol->stations && n < SINK_MAX_STATIONS; n++)
     {
-        if (plhm_read_data_record(pol, &rec)) {
+        if (plhm_read_data_record(pol, &recs[n])) {
             data_good = 0;
             return 1;
         }
+        if (grid_name)
+            plhm_grid_apply_record(&grid, &recs[n]);
+        if (recs[n].station >= 1 && recs[n].station <= SINK_MAX_STATIONS)
+            seen |= 1u << (recs[n].station - 1);
         data_good = 1;
+    }
+    read_done = monotonic_us();
+
+    if (!resampling) {
+        f->n = n;
+        f->tick = -1;
+        process_frame(f);
+        update_stats(pol, seen != pol->station_mask,
+                     monotonic_us() - read_done);
+        return 0;
+    }
 
-        curtime = ((rec.readtime.tv_sec * 1000.0)
-                   + (rec.readtime.tv_usec / 1000.0));
+    // each frame read gives the ticks it completes, if any
+    plhm_resample_push(&resampler, recs, n);
+    gettimeofday(&now, NULL);
+    send_ticks(&now);
+    update_stats(pol, seen != pol->station_mask, monotonic_us() - read_done);
 
-        LOG("%d", rec.station);
+    return 0;
+}
 
-        if (rec.fields & PLHM_DATA_POSITION)
-        {
-            log_float(rec.position[0]);
-            log_float(rec.position[1]);
-            log_float(rec.position[2]);
+/* Print the stations found, the byte rate they need and, if it was
+ * measured, what the link delivered. */
+void report_link(const plhm_t *pol)
+{
+    plhm_link_t l;
+    int i;
+
+    plhm_get_link(pol, &l);
+    printf("[plhm] station%s", l.stations > 1 ? "s" : "");
+    for (i = 0; i < 16; i++)
+        if (l.station_mask & (1 << i))
+            printf(" %d", i + 1);
+    printf(" at %d Hz, %d bytes per record: %.0f bytes/s\n",
+           l.rate_hz, l.record_bytes, l.required);
+    if (l.measured > 0)
+        printf("[plhm] the link delivered %.0f bytes/s, %.0f records/s\n",
+               l.measured, l.records_per_s);
+}
+
+void update_stats(const plhm_t *pol, int missing, double process_us)
+{
+    double now = monotonic_us(), dt;
+
+    pthread_mutex_lock(&stats.lock);
+    stats.frames++;
+    stats.missing += missing;
+    histogram_add(&stats.process, process_us);
+
+    dt = (now - stats.rate_time) / 1e6;
+    if (dt >= 1) {
+        stats.device = pol->stats;
+        stats.calls = pol->input_calls;
+        stats.records_per_s = (pol->stats.records - stats.rate_records) / dt;
+        stats.frames_per_s = (stats.frames - stats.rate_frames) / dt;
+        stats.calls_per_frame = stats.frames > stats.rate_frames
+            ? (double)(pol->input_calls - stats.rate_calls)
+              / (stats.frames - stats.rate_frames) : 0;
+        plhm_get_link(pol, &stats.link);
+        stats.link.measured = (pol->stats.bytes - stats.rate_bytes) / dt;
+        stats.link.records_per_s = stats.records_per_s;
+        stats.rate_time = now;
+        stats.rate_records = pol->stats.records;
+        stats.rate_frames = stats.frames;
+        stats.rate_bytes = pol->stats.bytes;
+        stats.rate_calls = pol->input_calls;
+
+        // warn after a few seconds short, not for a pause to reconfigure
+        if (!poll_period && stats.records_per_s
+            < 0.95 * stats.link.rate_hz * stats.link.stations) {
+            if (++stats.link_short == 3)
+                printf("[plhm] Warning: the link delivers %.0f of %d "
+                       "records/s (%.0f of %.0f bytes/s); use a lower "
+                       "rate, fewer fields or -a.\n", stats.records_per_s,
+                       stats.link.rate_hz * stats.link.stations,
+                       stats.link.measured, stats.link.required);
+        }
+        else {
+            if (stats.link_short >= 3)
+                printf("[plhm] The link delivers every record again.\n");
+            stats.link_short = 0;
         }
 
-        if (rec.fields & PLHM_DATA_EULER)
-        {
-            log_float(rec.euler[0]);
-            log_float(rec.euler[1]);
-            log_float(rec.euler[2]);
+        fprintf(stderr, "Update frequency: %0.2f Hz           \r",
+                stats.frames_per_s);
+        pthread_mutex_unlock(&stats.lock);
+        return;
+    }
+    pthread_mutex_unlock(&stats.lock);
+}
+
+static void sink_json(FILE *f, sink_t *s, const char *sep)
+{
+    sink_stats_t st;
+
+    if (!s->running)
+        return;
+    sink_get_stats(s, &st);
+    fprintf(f, "%s    { \"name\": \"%s\", \"policy\": \"%s\", "
+            "\"frames\": %lu, \"dropped\": %lu, \"coalesced\": %lu, "
+            "\"delayed\": %lu, \"events_dropped\": %lu, \"queued\": %d, "
+            "\"max_queued\": %d,\n      \"latency\": ", sep, s->name,
+            sink_policy_name(s->policy), st.frames, st.dropped,
+            st.coalesced, st.delayed, st.events_dropped, st.queued,
+            st.max_queued);
+    histogram_json(f, &st.latency);
+    fprintf(f, " }");
+}
+
+void write_stats_json(FILE *f)
+{
+    daemon_stats_t c;
+    const char *sep = "\n";
+    int i;
+
+    pthread_mutex_lock(&stats.lock);
+    c = stats;
+    pthread_mutex_unlock(&stats.lock);
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"uptime_s\": %.1f,\n", (monotonic_us() - c.start) / 1e6);
+    fprintf(f, "  \"records\": %llu,\n", c.device.records);
+    fprintf(f, "  \"records_per_s\": %.1f,\n", c.records_per_s);
+    fprintf(f, "  \"frames\": %llu,\n", c.frames);
+    fprintf(f, "  \"frames_per_s\": %.1f,\n", c.frames_per_s);
+    fprintf(f, "  \"frames_missing_stations\": %llu,\n", c.missing);
+    fprintf(f, "  \"parse_errors\": %llu,\n", c.device.parse_errors);
+    fprintf(f, "  \"resyncs\": %llu,\n", c.device.resyncs);
+    fprintf(f, "  \"station_errors\": %llu,\n", c.device.station_errors);
+    fprintf(f, "  \"timeouts\": %llu,\n", c.device.timeouts);
+    fprintf(f, "  \"read_calls_per_frame\": %.2f,\n", c.calls_per_frame);
+    fprintf(f, "  \"decode_ns_per_record\": %.0f,\n", c.device.records
+            ? (double)c.device.decode_ns / c.device.records : 0.0);
+    fprintf(f, "  \"link\": { \"station_mask\": %d, \"rate_hz\": %d, "
+            "\"record_bytes\": %d, \"required_bytes_per_s\": %.0f, "
+            "\"delivered_bytes_per_s\": %.0f },\n", c.link.station_mask,
+            c.link.rate_hz, c.link.record_bytes, c.link.required,
+            c.link.measured);
+    fprintf(f, "  \"process\": ");
+    histogram_json(f, &c.process);
+    fprintf(f, ",\n  \"sinks\": [");
+    if (outfile) {
+        sink_json(f, &file_sink, sep);
+        sep = ",\n";
+    }
+    if (shm_name) {
+        sink_json(f, &shm_sink, sep);
+        sep = ",\n";
+    }
+    if (history_name) {
+        sink_json(f, &history_sink, sep);
+        sep = ",\n";
+    }
+    for (i = 0; i < n_plugins; i++) {
+        sink_json(f, &plugins[i].sink, sep);
+        sep = ",\n";
+    }
+#ifdef HAVE_LIBLO
+    sink_json(f, &osc_sink, sep);
+#endif
+    fprintf(f, "\n  ]\n}\n");
+}
+
+/* Write the statistics every stats_period seconds, to a temporary
+ * file renamed over the last so that readers never see half of one. */
+static void *dump_stats(void *arg)
+{
+    char tmp[1024];
+    struct timespec until;
+    FILE *f;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", stats_path);
+    pthread_mutex_lock(&stats_wait_lock);
+    while (stats_running)
+    {
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += stats_period;
+        while (stats_running
+               && pthread_cond_timedwait(&stats_wait, &stats_wait_lock,
+                                         &until) != ETIMEDOUT) {}
+        if (!stats_running)
+            break;
+        pthread_mutex_unlock(&stats_wait_lock);
+
+        if (!strcmp(stats_path, "-"))
+            write_stats_json(stderr);
+        else if ((f = fopen(tmp, "w"))) {
+            write_stats_json(f);
+            fclose(f);
+            if (rename(tmp, stats_path))
+                perror("[plhm] rename");
         }
+        else
+            perror("[plhm] stats");
 
-        if (rec.fields & PLHM_DATA_TIMESTAMP)
-            LOG(", %u", rec.timestamp);
+        pthread_mutex_lock(&stats_wait_lock);
+    }
+    pthread_mutex_unlock(&stats_wait_lock);
+    return 0;
+}
 
-        LOG(", %f\n", curtime);
+int start_stats_dump()
+{
+    stats_running = 1;
+    if (pthread_create(&stats_thread, 0, dump_stats, 0)) {
+        printf("[plhm] Could not start writing statistics.\n");
+        stats_running = 0;
+        return 1;
+    }
+    return 0;
+}
 
-        if (!addr)
-            continue;
+void stop_stats_dump()
+{
+    if (!stats_running)
+        return;
+    pthread_mutex_lock(&stats_wait_lock);
+    stats_running = 0;
+    pthread_cond_signal(&stats_wait);
+    pthread_mutex_unlock(&stats_wait_lock);
+    pthread_join(stats_thread, 0);
+}
 
-#ifdef HAVE_LIBLO
-        char path[30];
-        if (rec.fields & PLHM_DATA_POSITION)
-        {
-            sprintf(path, "/liberty/marker/%d/x", rec.station);
-            lo_send(addr, path, "f", rec.position[0]);
+/* Run the processing stages on a frame, in place in the ring, and
+ * publish it to the sinks. */
+void process_frame(frame_t *f)
+{
+    f->features.features = 0;
+    f->n_events = 0;
+    if (filter.type != PLHM_FILTER_NONE || features.features || triggers_name)
+    {
+        plhm_frame_from_records(&stage_frame, f->recs, f->n);
+        if (filter.type != PLHM_FILTER_NONE) {
+            plhm_filter_apply(&filter, &stage_frame);
+            f->n = plhm_frame_to_records(&stage_frame, f->recs);
+        }
+        if (features.features)
+            plhm_features_compute(&features, &stage_frame, &f->features);
+        if (triggers_name)
+            f->n_events = plhm_triggers_update(&triggers, &stage_frame,
+                                               f->events, SINK_MAX_EVENTS);
+    }
 
-            sprintf(path, "/liberty/marker/%d/y", rec.station);
-            lo_send(addr, path, "f", rec.position[1]);
+    sink_ring_publish(&ring);
+}
+
+void log_vector(const float *v, int valid)
+{
+    log_float(valid ? v[0] : 0);
+    log_float(valid ? v[1] : 0);
+    log_float(valid ? v[2] : 0);
+}
 
-            sprintf(path, "/liberty/marker/%d/z", rec.station);
-            lo_send(addr, path, "f", rec.position[2]);
+/* Features follow the readtime, in the order of PLHM_FEATURE_* bits;
+ * derivatives are 0 until there are enough samples.  Distances take
+ * one column for each of the 16 stations, so that every line has the
+ * same columns; the cell is empty for the station itself and for
+ * stations not in the frame. */
+void log_features(const plhm_feature_values_t *fv, int st)
+{
+    int j, bit = 1 << st;
+
+    if (st < 0 || st >= 16)
+        return;
+
+    if (fv->features & PLHM_FEATURE_VELOCITY)
+        log_vector(fv->velocity[st], fv->velocity_mask & bit);
+    if (fv->features & PLHM_FEATURE_ACCELERATION)
+        log_vector(fv->acceleration[st], fv->acceleration_mask & bit);
+    if (fv->features & PLHM_FEATURE_JERK)
+        log_vector(fv->jerk[st], fv->jerk_mask & bit);
+    if (fv->features & PLHM_FEATURE_SPEED)
+        log_float((fv->velocity_mask & bit) ? fv->speed[st] : 0);
+    if (fv->features & PLHM_FEATURE_ANGULAR_VELOCITY)
+        log_vector(fv->angular_velocity[st], fv->velocity_mask & bit);
+    if (fv->features & PLHM_FEATURE_DISTANCE)
+        for (j = 0; j < 16; j++) {
+            if (j == st || !(fv->station_mask & (1 << j))) {
+                LOG(",");
+            }
+            else if (j < st)
+                log_float(fv->distance[PLHM_FEATURE_PAIR(j, st)]);
+            else
+                log_float(fv->distance[PLHM_FEATURE_PAIR(st, j)]);
         }
+}
 
-        if (rec.fields & PLHM_DATA_EULER)
-        {
-            sprintf(path, "/liberty/marker/%d/azimuth", rec.station);
-            lo_send(addr, path, "f", rec.euler[0]);
+void write_file_frame(const frame_t *f, void *user_data)
+{
+    int i;
+
+    if (compress_flag) {
+        plhm_rec_write(&recorder, f->recs, f->n);
+        return;
+    }
+
+    for (i = 0; i < f->n; i++)
+    {
+        const plhm_record_t *rec = &f->recs[i];
+        double t = ((rec->readtime.tv_sec * 1000.0)
+                    + (rec->readtime.tv_usec / 1000.0));
 
-            sprintf(path, "/liberty/marker/%d/elevation", rec.station);
-            lo_send(addr, path, "f", rec.euler[1]);
+        LOG("%d", rec->station);
 
-            sprintf(path, "/liberty/marker/%d/roll", rec.station);
-            lo_send(addr, path, "f", rec.euler[2]);
+        if (rec->fields & PLHM_DATA_POSITION)
+        {
+            log_float(rec->position[0]);
+            log_float(rec->position[1]);
+            log_float(rec->position[2]);
         }
 
-        if (rec.fields & PLHM_DATA_TIMESTAMP)
+        if (rec->fields & PLHM_DATA_EULER)
         {
-            sprintf(path, "/liberty/marker/%d/timestamp", rec.station);
-            lo_send(addr, path, "i", rec.timestamp);
+            log_float(rec->euler[0]);
+            log_float(rec->euler[1]);
+            log_float(rec->euler[2]);
         }
 
-        sprintf(path, "/liberty/marker/%d/readtime", rec.station);
-        lo_send(addr, path, "f", curtime);
-#endif // HAVE_LIBLO
+        if (rec->fields & PLHM_DATA_TIMESTAMP)
+            LOG(", %u", rec->timestamp);
+
+        LOG(", %f", t);
+
+        if (f->features.features)
+            log_features(&f->features, rec->station - 1);
+
+        LOG("\n");
     }
+}
+
+void write_shm_frame(const frame_t *f, void *user_data)
+{
+    plhm_shm_publish(&shm, f->recs, f->n);
+}
 
+void write_history_frame(const frame_t *f, void *user_data)
+{
+    plhm_history_add(&history, f->recs, f->n);
+}
+
+/* Load the plugins given with -x and apply the policies given for
+ * them with -b. */
+int load_plugins()
+{
+    int i, j;
+
+    for (i = 0; i < n_plugins; i++) {
+        if (plugin_load(&plugins[i], plugin_specs[i])) {
+            while (--i >= 0)
+                plugin_unload(&plugins[i]);
+            return 1;
+        }
+        plugin_fields |= plugins[i].desc->fields
+            & (PLHM_DATA_POSITION | PLHM_DATA_EULER | PLHM_DATA_TIMESTAMP);
+        printf("[plhm] Loaded plugin %s.\n", plugins[i].desc->name);
+    }
+
+    for (j = 0; j < n_plugin_policies; j++) {
+        for (i = 0; i < n_plugins; i++)
+            if (!strcmp(plugins[i].desc->name, plugin_policies[j].name))
+                break;
+        if (i == n_plugins) {
+            printf("[plhm] Unknown sink '%s'.\n", plugin_policies[j].name);
+            return 1;
+        }
+        plugins[i].policy = plugin_policies[j].policy;
+    }
     return 0;
 }
 
+#ifdef HAVE_LIBLO
+void write_osc_frame(const frame_t *f, void *user_data)
+{
+    const struct timeval *t;
+
+    // nothing to send for a frame without stations
+    if (f->n == 0)
+        return;
+    t = &f->recs[f->n-1].readtime;
+
+    // one bundle per subscriber for the whole frame
+    subscribers_send_frame(f, &triggers,
+                           (t->tv_sec * 1000.0) + (t->tv_usec / 1000.0));
+}
+#endif
+
 #ifdef HAVE_LIBLO
 void liblo_error(int num, const char *msg, const char *path)
 {
@@ -513,7 +1544,7 @@ int start_handler(const char *path, const char *types, lo_arg **argv, int argc,
 {
     int port;
     const char *hostname;
-    started = 0;
+    control_request req;
 
     if (argc == 1) {
         hostname = lo_address_get_hostname(lo_message_get_source(data));
@@ -532,29 +1563,170 @@ int start_handler(const char *path, const char *types, lo_arg **argv, int argc,
         port = argv[1]->i;
     }
 
-    char url[256];
-    sprintf(url, "osc.udp://%s:%d", hostname, port);
-    lo_address a = lo_address_new_from_url(url);
-    if (a && addr) lo_address_free(addr);
-    addr = a;
-    printf("starting... %s\n", url);
-
-    started = 1;
+    memset(&req, 0, sizeof(req));
+    req.type = CONTROL_START;
+    strncpy(req.sub.host, hostname, sizeof(req.sub.host)-1);
+    req.sub.port = port;
+    req.sub.primary = 1;
+    req.sub.station_mask = ~0;
+    req.sub.fields = ~0;
+    req.sub.features = ~0;
+    printf("starting... osc.udp://%s:%d\n", hostname, port);
+
+    subscription_resolve(&req.sub);
+    if (push_control_request(&req))
+        subscription_release(&req.sub);
     return 0;
 }
 
 int stop_handler(const char *path, const char *types, lo_arg **argv, int argc,
                  void *data, void *user_data)
 {
+    control_request req;
     printf("stopping..\n");
-    started = 0;
+    memset(&req, 0, sizeof(req));
+    req.type = CONTROL_STOP;
+    push_control_request(&req);
+    return 0;
+}
+
+int fields_handler(const char *path, const char *types, lo_arg **argv, int argc,
+                   void *data, void *user_data)
+{
+    control_request req;
+    const char *c;
+
+    // same letters as the command-line options: P, E, T
+    memset(&req, 0, sizeof(req));
+    req.type = CONTROL_FIELDS;
+    for (c = &argv[0]->s; *c; c++) {
+        switch (*c) {
+        case 'P': case 'p': req.arg[0] |= PLHM_DATA_POSITION; break;
+        case 'E': case 'e': req.arg[0] |= PLHM_DATA_EULER; break;
+        case 'T': case 't': req.arg[0] |= PLHM_DATA_TIMESTAMP; break;
+        default:
+            printf("[plhm] unknown field '%c'\n", *c);
+            return 0;
+        }
+    }
+    if (!req.arg[0]) {
+        printf("[plhm] no fields requested\n");
+        return 0;
+    }
+    push_control_request(&req);
     return 0;
 }
 
+int rate_handler(const char *path, const char *types, lo_arg **argv, int argc,
+                 void *data, void *user_data)
+{
+    control_request req;
+    memset(&req, 0, sizeof(req));
+    req.type = CONTROL_RATE;
+    switch (argv[0]->i) {
+    case 120: req.arg[0] = PLHM_RATE_120; break;
+    case 240: req.arg[0] = PLHM_RATE_240; break;
+    default:
+        printf("[plhm] unsupported rate %d\n", argv[0]->i);
+        return 0;
+    }
+    push_control_request(&req);
+    return 0;
+}
+
+int station_handler(const char *path, const char *types, lo_arg **argv, int argc,
+                    void *data, void *user_data)
+{
+    control_request req;
+    if (argv[0]->i < 1 || argv[0]->i > 16) {
+        printf("[plhm] invalid station %d\n", argv[0]->i);
+        return 0;
+    }
+    memset(&req, 0, sizeof(req));
+    req.type = CONTROL_STATION;
+    req.arg[0] = argv[0]->i - 1;
+    req.arg[1] = argv[1]->i != 0;
+    push_control_request(&req);
+    return 0;
+}
+
+/* /liberty/subscribe host port divisor stations fields [lease]
+ *   divisor:  send every n-th frame
+ *   stations: bit mask, bit 0 is station 1, 0 for all
+ *   fields:   letters P, E, T as for /liberty/fields, and feature
+ *             letters; "" for all, all data fields if none given
+ *   lease:    seconds until expiry unless renewed, 0 for never */
+int subscribe_handler(const char *path, const char *types, lo_arg **argv,
+                      int argc, void *data, void *user_data)
+{
+    control_request req;
+    const char *c;
+    int f;
+
+    memset(&req, 0, sizeof(req));
+    req.type = CONTROL_SUBSCRIBE;
+    strncpy(req.sub.host, &argv[0]->s, sizeof(req.sub.host)-1);
+    req.sub.port = argv[1]->i;
+    req.sub.divisor = argv[2]->i;
+    req.sub.station_mask = argv[3]->i ? argv[3]->i : ~0;
+    req.sub.lease = argc > 5 ? argv[5]->i : 60;
+
+    // data fields P, E, T and feature letters, or all if empty
+    for (c = &argv[4]->s; *c; c++) {
+        switch (*c) {
+        case 'P': case 'p': req.sub.fields |= PLHM_DATA_POSITION; break;
+        case 'E': case 'e': req.sub.fields |= PLHM_DATA_EULER; break;
+        case 'T': case 't': req.sub.fields |= PLHM_DATA_TIMESTAMP; break;
+        default:
+            if (!(f = plhm_features_letter(*c))) {
+                printf("[plhm] unknown field '%c'\n", *c);
+                return 0;
+            }
+            req.sub.features |= f;
+        }
+    }
+    if (c == &argv[4]->s)
+        req.sub.features = ~0;
+    // features alone still come with the data they were computed from
+    if (!req.sub.fields)
+        req.sub.fields = ~0;
+
+    if (subscription_resolve(&req.sub))
+        return 0;
+    if (push_control_request(&req))
+        subscription_release(&req.sub);
+    return 0;
+}
+
+int unsubscribe_handler(const char *path, const char *types, lo_arg **argv,
+                        int argc, void *data, void *user_data)
+{
+    control_request req;
+    memset(&req, 0, sizeof(req));
+    req.type = CONTROL_UNSUBSCRIBE;
+    strncpy(req.sub.host, &argv[0]->s, sizeof(req.sub.host)-1);
+    req.sub.port = argv[1]->i;
+    push_control_request(&req);
+    return 0;
+}
+
+/* /liberty/status/sink name policy queued max_queued frames dropped
+ *                     coalesced delayed */
+void send_sink_status(lo_address t, sink_t *s)
+{
+    sink_stats_t st;
+    sink_get_stats(s, &st);
+    lo_send(t, "/liberty/status/sink", "ssiiiiii", s->name,
+            sink_policy_name(s->policy), st.queued, st.max_queued,
+            (int)st.frames, (int)st.dropped, (int)st.coalesced,
+            (int)st.delayed);
+}
+
 void send_status(plhm_t *pol, const char* hostname, int port)
 {
     char port_s[30];
     char *status;
+    int i;
 
     if (started) {
         status = "sending";
@@ -573,6 +1745,15 @@ void send_status(plhm_t *pol, const char* hostname, int port)
     lo_address t = lo_address_new(hostname, port_s);
     if (t) {
         lo_send(t, "/liberty/status","s", status);
+        send_sink_status(t, &osc_sink);
+        if (outfile)
+            send_sink_status(t, &file_sink);
+        if (shm_name)
+            send_sink_status(t, &shm_sink);
+        if (history_name)
+            send_sink_status(t, &history_sink);
+        for (i = 0; i < n_plugins; i++)
+            send_sink_status(t, &plugins[i].sink);
         lo_address_free(t);
     }
 }
@@ -597,4 +1778,153 @@ int status_handler(const char *path, const char *types, lo_arg **argv, int argc,
 
     return 0;
 }
+
+/* /liberty/stats/device records parse_errors resyncs station_errors
+ *                       timeouts frames frames_missing_stations
+ * /liberty/stats/rate records_per_s frames_per_s read_calls_per_frame
+ * /liberty/stats/link station_mask rate_hz required_bytes_per_s
+ *                     delivered_bytes_per_s
+ * /liberty/stats/decode ns_per_record process_p50_us process_p99_us
+ *                       process_max_us
+ * /liberty/stats/sink name frames dropped latency_p50_us
+ *                     latency_p99_us latency_max_us */
+static void send_sink_stats(lo_address t, sink_t *s)
+{
+    sink_stats_t st;
+
+    if (!s->running)
+        return;
+    sink_get_stats(s, &st);
+    lo_send(t, "/liberty/stats/sink", "shhfff", s->name,
+            (int64_t)st.frames, (int64_t)st.dropped,
+            (float)histogram_quantile(&st.latency, 0.5),
+            (float)histogram_quantile(&st.latency, 0.99),
+            (float)st.latency.max);
+}
+
+int stats_handler(const char *path, const char *types, lo_arg **argv, int argc,
+                  void *data, void *user_data)
+{
+    daemon_stats_t c;
+    char port_s[30];
+    const char *hostname;
+    int port, i;
+    lo_address t;
+
+    if (argc == 1) {
+        hostname = lo_address_get_hostname(lo_message_get_source(data));
+        port = argv[0]->i;
+    }
+    else {
+        hostname = &argv[0]->s;
+        port = argv[1]->i;
+    }
+
+    pthread_mutex_lock(&stats.lock);
+    c = stats;
+    pthread_mutex_unlock(&stats.lock);
+
+    sprintf(port_s, "%d", port);
+    t = lo_address_new(hostname, port_s);
+    if (!t)
+        return 0;
+
+    lo_send(t, "/liberty/stats/device", "hhhhhhh",
+            (int64_t)c.device.records, (int64_t)c.device.parse_errors,
+            (int64_t)c.device.resyncs, (int64_t)c.device.station_errors,
+            (int64_t)c.device.timeouts, (int64_t)c.frames,
+            (int64_t)c.missing);
+    lo_send(t, "/liberty/stats/rate", "fff", (float)c.records_per_s,
+            (float)c.frames_per_s, (float)c.calls_per_frame);
+    lo_send(t, "/liberty/stats/link", "iiff", c.link.station_mask,
+            c.link.rate_hz, (float)c.link.required, (float)c.link.measured);
+    lo_send(t, "/liberty/stats/decode", "ffff", c.device.records
+            ? (float)c.device.decode_ns / c.device.records : 0.0f,
+            (float)histogram_quantile(&c.process, 0.5),
+            (float)histogram_quantile(&c.process, 0.99),
+            (float)c.process.max);
+    send_sink_stats(t, &osc_sink);
+    if (outfile)
+        send_sink_stats(t, &file_sink);
+    if (shm_name)
+        send_sink_stats(t, &shm_sink);
+    if (history_name)
+        send_sink_stats(t, &history_sink);
+    for (i = 0; i < n_plugins; i++)
+        send_sink_stats(t, &plugins[i].sink);
+    lo_address_free(t);
+
+    return 0;
+}
+
+// samples per reply, to stay within a UDP datagram
+#define HISTORY_CHUNK 1024
+
+/* /liberty/history [host] port station seconds
+ *   the last seconds of a station
+ * /liberty/history [host] port station from to
+ *   the samples read between from and to, in ms as in the data
+ *
+ * reply with /liberty/history station index total blob, the blob
+ * holding the samples index and on of the window as an array of
+ * plhm_history_sample_t, in as many messages as it takes. */
+int history_handler(const char *path, const char *types, lo_arg **argv,
+                    int argc, void *data, void *user_data)
+{
+    static plhm_history_sample_t samples[HISTORY_CHUNK];
+    char port_s[30];
+    const char *hostname;
+    int port, station, a = 0, n, sent = 0;
+    double from, to, newest;
+    uint64_t i = 0, end = 0;
+    lo_address t;
+
+    if (types[0] == 's') {
+        hostname = &argv[0]->s;
+        a = 1;
+    }
+    else
+        hostname = lo_address_get_hostname(lo_message_get_source(data));
+    port = argv[a]->i;
+    station = argv[a+1]->i;
+
+    // fix the window first, so that the total is known in advance
+    if (history_name && station >= 1 && station <= PLHM_HISTORY_STATIONS
+        && plhm_history_bounds(&history, station, 0, &newest))
+    {
+        if (types[a+2] == 'f') {
+            to = newest;
+            from = newest - argv[a+2]->f * 1000.0;
+        }
+        else {
+            from = argv[a+2]->d;
+            to = argv[a+3]->d;
+        }
+        i = plhm_history_seek(&history, station, from);
+        end = plhm_history_seek(&history, station, nextafter(to, INFINITY));
+    }
+
+    sprintf(port_s, "%d", port);
+    t = lo_address_new(hostname, port_s);
+    if (!t)
+        return 0;
+
+    do {
+        lo_blob b;
+        n = 0;
+        if (i < end)
+            n = plhm_history_read(&history, station, &i, samples,
+                                  end - i < HISTORY_CHUNK ? end - i
+                                  : HISTORY_CHUNK);
+        // the total shrinks if the oldest were replaced meanwhile
+        b = lo_blob_new(n * sizeof(plhm_history_sample_t), samples);
+        lo_send(t, "/liberty/history", "iiib", station, sent,
+                (int)(sent + n + (end > i ? end - i : 0)), b);
+        lo_blob_free(b);
+        sent += n;
+    } while (n > 0 && i < end);
+
+    lo_address_free(t);
+    return 0;
+}
 #endif // HAVE_LIBLO
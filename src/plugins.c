@@ -0,0 +1,118 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <dlfcn.h>
+
+#include "plugins.h"
+
+#ifndef PLHM_PLUGIN_DIR
+#define PLHM_PLUGIN_DIR "."
+#endif
+
+int plugin_load(plugin_t *p, const char *spec)
+{
+    char path[1024];
+    const char *args = strchr(spec, ':');
+    int len = args ? args - spec : strlen(spec);
+    plhm_plugin_describe_fn *describe;
+
+    memset(p, 0, sizeof(plugin_t));
+    if (memchr(spec, '/', len))
+        snprintf(path, sizeof(path), "%.*s", len, spec);
+    else
+        snprintf(path, sizeof(path), "%s/%.*s.so", PLHM_PLUGIN_DIR, len, spec);
+
+    if (!(p->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL))) {
+        printf("[plhm] Couldn't load plugin: %s\n", dlerror());
+        return 1;
+    }
+
+    describe = (plhm_plugin_describe_fn*)dlsym(p->handle,
+                                               "plhm_plugin_describe");
+    if (!describe || !(p->desc = describe())) {
+        printf("[plhm] %s is not a plhm plugin.\n", path);
+        goto fail;
+    }
+    if (p->desc->version != PLHM_PLUGIN_VERSION) {
+        printf("[plhm] Plugin %s is for version %d of the plugin "
+               "interface, not %d.\n", path, p->desc->version,
+               PLHM_PLUGIN_VERSION);
+        goto fail;
+    }
+    if (!p->desc->name || !p->desc->open || !p->desc->write) {
+        printf("[plhm] Plugin %s is incomplete.\n", path);
+        goto fail;
+    }
+
+    switch (p->desc->policy) {
+    case PLHM_PLUGIN_DROP_OLDEST: p->policy = SINK_DROP_OLDEST; break;
+    case PLHM_PLUGIN_COALESCE: p->policy = SINK_COALESCE; break;
+    default: p->policy = SINK_BLOCK; break;
+    }
+
+    if (!(p->state = p->desc->open(args ? args + 1 : ""))) {
+        printf("[plhm] Plugin %s failed to open.\n", p->desc->name);
+        goto fail;
+    }
+    return 0;
+
+  fail:
+    dlclose(p->handle);
+    p->handle = 0;
+    p->desc = 0;
+    return 1;
+}
+
+/* Hand the plugin a view of the frame the sink is writing; frames
+ * without any of its stations do not call it at all. */
+static void write_plugin_frame(const frame_t *f, void *user_data)
+{
+    plugin_t *p = (plugin_t*)user_data;
+    plhm_plugin_frame_t view;
+    uint32_t mask = 0;
+    int i;
+
+    for (i = 0; i < f->n; i++)
+        if (f->recs[i].station >= 1
+            && f->recs[i].station <= PLHM_FRAME_STATIONS)
+            mask |= 1u << (f->recs[i].station - 1);
+    if (p->desc->station_mask && !(mask & p->desc->station_mask))
+        return;
+
+    view.n = f->n;
+    view.recs = f->recs;
+    view.station_mask = mask;
+    view.tick = f->tick;
+    view.features = &f->features;
+    view.n_events = f->n_events;
+    view.events = f->events;
+    p->desc->write(p->state, &view);
+}
+
+int plugin_start(plugin_t *p, sink_ring_t *ring)
+{
+    return sink_start(&p->sink, ring, p->desc->name, p->policy,
+                      write_plugin_frame, p);
+}
+
+void plugin_unload(plugin_t *p)
+{
+    if (!p->handle)
+        return;
+    sink_stop(&p->sink);
+    if (p->desc->close)
+        p->desc->close(p->state);
+    dlclose(p->handle);
+    p->handle = 0;
+}
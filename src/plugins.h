@@ -0,0 +1,41 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _PLUGINS_H_
+#define _PLUGINS_H_
+
+#include <plhm_plugin.h>
+
+#include "sink.h"
+
+// sinks left after file, shm, history and osc
+#define MAX_PLUGINS 4
+
+/* An output plugin loaded with -x, fed by a sink of its own. */
+typedef struct _plugin
+{
+    void *handle;
+    const plhm_plugin_t *desc;
+    void *state;
+    sink_policy policy;
+    sink_t sink;
+} plugin_t;
+
+/* Load <path>[:<args>] and open it.  A path without a slash names a
+ * plugin installed in PLHM_PLUGIN_DIR. */
+int plugin_load(plugin_t *p, const char *spec);
+int plugin_start(plugin_t *p, sink_ring_t *ring);
+
+/* stops the sink, then closes and unloads the plugin */
+void plugin_unload(plugin_t *p);
+
+#endif // _PLUGINS_H_
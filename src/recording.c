@@ -0,0 +1,510 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "plhm_recording.h"
+
+/* Zero bytes after each bit stream, so that the reader can load 64
+ * bits at a time and check for overruns once per station. */
+#define PADDING 64
+
+/* Largest encoding of one station: two timestamps in the widest
+ * form, an error code, and six floats in the widest form. */
+#define STATION_BITS (2 * (4 + 64) + 9 + 6 * (2 + 5 + 5 + 32))
+#define FRAME_BYTES (PLHM_REC_MAX_STATIONS * (STATION_BITS + 7) / 8)
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Writer */
+
+static inline void put(plhm_rec_writer_t *w, uint64_t v, int n)
+{
+    w->acc = (w->acc << n) | (v & ((1ull << n) - 1));
+    w->bits += n;
+    while (w->bits >= 8) {
+        w->bits -= 8;
+        w->buffer[w->bytes++] = (uint8_t)(w->acc >> w->bits);
+    }
+}
+
+static inline void put64(plhm_rec_writer_t *w, uint64_t v)
+{
+    put(w, v >> 32, 32);
+    put(w, v, 32);
+}
+
+/* A delta of deltas, in 1, 9, 12, 16 or 68 bits. */
+static void put_dod(plhm_rec_writer_t *w, int64_t d)
+{
+    if (d == 0)
+        put(w, 0, 1);
+    else if (d >= -63 && d <= 64) {
+        put(w, 2, 2);
+        put(w, d, 7);
+    }
+    else if (d >= -255 && d <= 256) {
+        put(w, 6, 3);
+        put(w, d, 9);
+    }
+    else if (d >= -2047 && d <= 2048) {
+        put(w, 14, 4);
+        put(w, d, 12);
+    }
+    else {
+        put(w, 15, 4);
+        put64(w, d);
+    }
+}
+
+static void put_float(plhm_rec_writer_t *w, plhm_rec_station_t *s, int c,
+                      float f)
+{
+    uint32_t v, x;
+    int lead, trail, len;
+
+    memcpy(&v, &f, 4);
+    x = v ^ s->value[c];
+    s->value[c] = v;
+
+    if (!x) {
+        put(w, 0, 1);
+        return;
+    }
+
+    lead = __builtin_clz(x);
+    trail = __builtin_ctz(x);
+    if (lead > 31)
+        lead = 31;
+
+    if (s->lead[c] != 255 && lead >= s->lead[c] && trail >= s->trail[c]) {
+        // fits in the previous window
+        put(w, 2, 2);
+        put(w, x >> s->trail[c], 32 - s->lead[c] - s->trail[c]);
+    }
+    else {
+        len = 32 - lead - trail;
+        put(w, 3, 2);
+        put(w, lead, 5);
+        put(w, len - 1, 5);
+        put(w, x >> trail, len);
+        s->lead[c] = lead;
+        s->trail[c] = trail;
+    }
+}
+
+static void start_block(plhm_rec_writer_t *w, uint32_t mask, int fields)
+{
+    int i;
+    w->station_mask = mask;
+    w->fields = fields;
+    w->frames = 0;
+    w->bytes = 0;
+    w->bits = 0;
+    w->acc = 0;
+    memset(w->station, 0, sizeof(w->station));
+    for (i = 0; i < PLHM_REC_MAX_STATIONS; i++)
+        memset(w->station[i].lead, 255, sizeof(w->station[i].lead));
+}
+
+static int flush_block(plhm_rec_writer_t *w)
+{
+    uint8_t header[PLHM_REC_BLOCK_HEADER_BYTES];
+    size_t payload;
+
+    if (!w->frames)
+        return 0;
+
+    if (w->bits)
+        put(w, 0, 8 - w->bits);
+    payload = ((w->bytes + 7) & ~7) + PADDING;
+    memset(w->buffer + w->bytes, 0, payload - w->bytes);
+
+    put_le32(header, PLHM_REC_BLOCK_MAGIC);
+    put_le32(header + 4, payload);
+    put_le32(header + 8, w->frames);
+    put_le32(header + 12, w->station_mask);
+    put_le32(header + 16, w->fields);
+
+    if (fwrite(header, sizeof(header), 1, w->file) != 1
+        || fwrite(w->buffer, payload, 1, w->file) != 1)
+    {
+        printf("Error writing recording.\n");
+        return 1;
+    }
+    w->written += sizeof(header) + payload;
+    w->frames = 0;
+    return 0;
+}
+
+int plhm_rec_writer_open(plhm_rec_writer_t *w, FILE *file)
+{
+    uint8_t header[PLHM_REC_HEADER_BYTES];
+
+    memset(w, 0, sizeof(plhm_rec_writer_t));
+    w->file = file;
+    w->buffer = malloc(PLHM_REC_BLOCK_BYTES + PADDING + 8);
+    if (!w->buffer)
+        return 1;
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, PLHM_REC_MAGIC, sizeof(PLHM_REC_MAGIC));
+    put_le32(header + 8, PLHM_REC_VERSION);
+    if (fwrite(header, sizeof(header), 1, file) != 1) {
+        printf("Error writing recording.\n");
+        free(w->buffer);
+        w->buffer = 0;
+        return 1;
+    }
+    w->written = sizeof(header);
+    return 0;
+}
+
+int plhm_rec_write(plhm_rec_writer_t *w, const plhm_record_t *recs, int n)
+{
+    const plhm_record_t *by_station[PLHM_REC_MAX_STATIONS];
+    uint32_t mask = 0;
+    int i, fields = n ? recs[0].fields : 0;
+
+    for (i = 0; i < n; i++) {
+        int s = recs[i].station - 1;
+        if (s < 0 || s >= PLHM_REC_MAX_STATIONS)
+            continue;
+        mask |= 1 << s;
+        by_station[s] = &recs[i];
+    }
+    if (!mask)
+        return 0;
+
+    if (mask != w->station_mask || fields != w->fields
+        || w->frames >= PLHM_REC_BLOCK_FRAMES
+        || w->bytes + FRAME_BYTES > PLHM_REC_BLOCK_BYTES)
+    {
+        if (flush_block(w))
+            return 1;
+        start_block(w, mask, fields);
+    }
+
+    for (i = 0; i < PLHM_REC_MAX_STATIONS; i++)
+    {
+        const plhm_record_t *r = by_station[i];
+        plhm_rec_station_t *s = &w->station[i];
+        int64_t t, d;
+
+        if (!(mask & (1 << i)))
+            continue;
+
+        t = (int64_t)r->readtime.tv_sec * 1000000 + r->readtime.tv_usec;
+        d = t - s->time;
+        put_dod(w, d - s->time_delta);
+        s->time = t;
+        s->time_delta = d;
+
+        if (fields & PLHM_DATA_TIMESTAMP) {
+            // the device counter may wrap
+            d = (int32_t)(r->timestamp - s->timestamp);
+            put_dod(w, d - s->timestamp_delta);
+            s->timestamp = r->timestamp;
+            s->timestamp_delta = d;
+        }
+
+        if (r->error == s->error)
+            put(w, 0, 1);
+        else {
+            put(w, 1, 1);
+            put(w, r->error, 8);
+            s->error = r->error & 0xFF;
+        }
+
+        if (fields & PLHM_DATA_POSITION) {
+            put_float(w, s, 0, r->position[0]);
+            put_float(w, s, 1, r->position[1]);
+            put_float(w, s, 2, r->position[2]);
+        }
+        if (fields & PLHM_DATA_EULER) {
+            put_float(w, s, 3, r->euler[0]);
+            put_float(w, s, 4, r->euler[1]);
+            put_float(w, s, 5, r->euler[2]);
+        }
+
+        w->records++;
+    }
+
+    w->frames++;
+    return 0;
+}
+
+int plhm_rec_writer_close(plhm_rec_writer_t *w)
+{
+    int rc = flush_block(w);
+    if (fflush(w->file))
+        rc = 1;
+    free(w->buffer);
+    w->buffer = 0;
+    return rc;
+}
+
+/* Reader */
+
+int plhm_rec_is_recording(const void *data, size_t size)
+{
+    return (size >= PLHM_REC_HEADER_BYTES
+            && !memcmp(data, PLHM_REC_MAGIC, sizeof(PLHM_REC_MAGIC)));
+}
+
+int plhm_rec_reader_init(plhm_rec_reader_t *r, const void *data, size_t size)
+{
+    memset(r, 0, sizeof(plhm_rec_reader_t));
+    r->fd = -1;
+    if (!plhm_rec_is_recording(data, size)
+        || get_le32((const uint8_t*)data + 8) != PLHM_REC_VERSION)
+    {
+        printf("Not a recording, or an unsupported version.\n");
+        return 1;
+    }
+    r->data = data;
+    r->size = size;
+    r->pos = PLHM_REC_HEADER_BYTES;
+    return 0;
+}
+
+int plhm_rec_reader_open(plhm_rec_reader_t *r, const char *path)
+{
+    struct stat st;
+    void *data;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &st)) {
+        printf("Could not open recording %s.\n", path);
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+
+    data = mmap(0, st.st_size ? st.st_size : 1, PROT_READ, MAP_PRIVATE,
+                fd, 0);
+    if (data == MAP_FAILED) {
+        printf("Could not map recording %s.\n", path);
+        close(fd);
+        return 1;
+    }
+
+    if (plhm_rec_reader_init(r, data, st.st_size)) {
+        munmap(data, st.st_size ? st.st_size : 1);
+        close(fd);
+        return 1;
+    }
+    r->fd = fd;
+    return 0;
+}
+
+void plhm_rec_reader_close(plhm_rec_reader_t *r)
+{
+    if (r->fd >= 0) {
+        munmap((void*)r->data, r->size ? r->size : 1);
+        close(r->fd);
+    }
+    r->fd = -1;
+    r->data = 0;
+}
+
+int plhm_rec_next_block(plhm_rec_reader_t *r, plhm_rec_block_t *b)
+{
+    const uint8_t *h = r->data + r->pos;
+
+    if (r->pos == r->size)
+        return 1;
+    if (r->size - r->pos < PLHM_REC_BLOCK_HEADER_BYTES
+        || get_le32(h) != PLHM_REC_BLOCK_MAGIC)
+        return -1;
+
+    b->payload = get_le32(h + 4);
+    b->frames = get_le32(h + 8);
+    b->station_mask = get_le32(h + 12);
+    b->fields = get_le32(h + 16);
+    b->data = h + PLHM_REC_BLOCK_HEADER_BYTES;
+
+    if ((b->payload & 7) || b->payload < PADDING
+        || b->payload > r->size - r->pos - PLHM_REC_BLOCK_HEADER_BYTES
+        || b->frames > PLHM_REC_BLOCK_FRAMES
+        || (b->station_mask >> PLHM_REC_MAX_STATIONS))
+        return -1;
+
+    r->pos += PLHM_REC_BLOCK_HEADER_BYTES + b->payload;
+    return 0;
+}
+
+typedef struct {
+    const uint8_t *data;
+    uint64_t pos;       // in bits
+} bitreader_t;
+
+/* Up to 57 bits. */
+static inline uint64_t peek(const bitreader_t *br, int n)
+{
+    uint64_t word;
+    memcpy(&word, br->data + (br->pos >> 3), 8);
+    word = __builtin_bswap64(word);
+    return (word << (br->pos & 7)) >> (64 - n);
+}
+
+static inline uint64_t get(bitreader_t *br, int n)
+{
+    uint64_t v = peek(br, n);
+    br->pos += n;
+    return v;
+}
+
+static inline int64_t sign_extend(uint64_t v, int n)
+{
+    return (v > (1ull << (n - 1))) ? (int64_t)v - (1ll << n) : (int64_t)v;
+}
+
+/* Prefix lengths and value widths of the delta-of-delta forms, by the
+ * first four bits. */
+static const unsigned char dod_prefix[16] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 4, 4
+};
+static const unsigned char dod_bits[16] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 7, 7, 7, 7, 9, 9, 12, 64
+};
+
+static inline int64_t get_dod(bitreader_t *br)
+{
+    int c = (int)peek(br, 4), n = dod_bits[c];
+    br->pos += dod_prefix[c];
+    if (n == 64) {
+        uint64_t hi = get(br, 32);
+        return (int64_t)((hi << 32) | get(br, 32));
+    }
+    return n ? sign_extend(get(br, n), n) : 0;
+}
+
+static inline int get_float(bitreader_t *br, plhm_rec_station_t *s, int c,
+                            float *f)
+{
+    int code = (int)peek(br, 2);
+    uint32_t x = 0;
+
+    if (code < 2)
+        br->pos++;
+    else if (code == 2) {
+        br->pos += 2;
+        if (s->lead[c] == 255)
+            return 1;
+        x = (uint32_t)get(br, 32 - s->lead[c] - s->trail[c]) << s->trail[c];
+    }
+    else {
+        int lead, len;
+        br->pos += 2;
+        lead = (int)get(br, 5);
+        len = (int)get(br, 5) + 1;
+        if (lead + len > 32)
+            return 1;
+        s->lead[c] = lead;
+        s->trail[c] = 32 - lead - len;
+        x = (uint32_t)get(br, len) << s->trail[c];
+    }
+
+    s->value[c] ^= x;
+    memcpy(f, &s->value[c], 4);
+    return 0;
+}
+
+int plhm_rec_decode_block(const plhm_rec_block_t *b, plhm_record_t *recs)
+{
+    plhm_rec_station_t station[PLHM_REC_MAX_STATIONS];
+    bitreader_t br;
+    uint64_t limit = (uint64_t)(b->payload - PADDING) * 8;
+    int i, f, n = 0;
+
+    memset(station, 0, sizeof(station));
+    for (i = 0; i < PLHM_REC_MAX_STATIONS; i++)
+        memset(station[i].lead, 255, sizeof(station[i].lead));
+
+    br.data = b->data;
+    br.pos = 0;
+
+    for (f = 0; f < (int)b->frames; f++)
+    {
+        for (i = 0; i < PLHM_REC_MAX_STATIONS; i++)
+        {
+            plhm_rec_station_t *s = &station[i];
+            plhm_record_t *r = &recs[n];
+            int err = 0;
+
+            if (!(b->station_mask & (1 << i)))
+                continue;
+
+            // a station never needs more than the padding
+            if (br.pos > limit)
+                return -1;
+
+            s->time_delta += get_dod(&br);
+            s->time += s->time_delta;
+            r->readtime.tv_sec = s->time / 1000000;
+            r->readtime.tv_usec = s->time % 1000000;
+
+            if (b->fields & PLHM_DATA_TIMESTAMP) {
+                s->timestamp_delta += get_dod(&br);
+                s->timestamp += (uint32_t)s->timestamp_delta;
+            }
+            r->timestamp = s->timestamp;
+
+            if (get(&br, 1))
+                s->error = (int)get(&br, 8);
+            r->error = s->error;
+
+            if (b->fields & PLHM_DATA_POSITION) {
+                err |= get_float(&br, s, 0, &r->position[0]);
+                err |= get_float(&br, s, 1, &r->position[1]);
+                err |= get_float(&br, s, 2, &r->position[2]);
+            }
+            else
+                r->position[0] = r->position[1] = r->position[2] = 0;
+
+            if (b->fields & PLHM_DATA_EULER) {
+                err |= get_float(&br, s, 3, &r->euler[0]);
+                err |= get_float(&br, s, 4, &r->euler[1]);
+                err |= get_float(&br, s, 5, &r->euler[2]);
+            }
+            else
+                r->euler[0] = r->euler[1] = r->euler[2] = 0;
+
+            if (err)
+                return -1;
+
+            r->fields = b->fields;
+            r->station = i + 1;
+            n++;
+        }
+    }
+
+    return br.pos > limit ? -1 : n;
+}
@@ -0,0 +1,198 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* Recordings round trip exactly, through every delta-of-delta form
+ * including the 64-bit escape, and damaged files are refused. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <plhm_recording.h>
+
+#define FRAMES 600
+#define STATIONS 2
+
+static int failed = 0;
+
+#define CHECK(cond) do { if (!(cond)) { \
+    printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failed = 1; } \
+    } while (0)
+
+static plhm_record_t frames[FRAMES][STATIONS];
+
+/* Read time steps, in us, chosen to land on each side of every
+ * boundary between the delta-of-delta forms, and to jump by days. */
+static int64_t step(int f)
+{
+    static const int64_t dods[] = {
+        64, -63, 65, -64, 256, -255, 257, -256, 2048, -2047, 2049, -2048,
+    };
+    int64_t base = 4167;
+    if (f >= 100 && f < 112) {
+        int64_t d = base, i;
+        for (i = 100; i <= f; i++)
+            d += dods[i - 100];
+        return d;
+    }
+    if (f == 200)
+        return 3 * 86400 * 1000000LL;
+    if (f == 201)
+        return -86400 * 1000000LL;
+    return base;
+}
+
+static void make_frames()
+{
+    int64_t t = 1700000000LL * 1000000;
+    uint32_t ts = 0xFFFFFF00;
+    int f, s, c;
+
+    for (f = 0; f < FRAMES; f++)
+    {
+        t += step(f);
+        // the counter wraps, then jumps by most of its range
+        ts += f == 300 ? 0x7FFFFFF0 : f == 301 ? 0x80000010 : 4;
+        for (s = 0; s < STATIONS; s++)
+        {
+            plhm_record_t *r = &frames[f][s];
+            r->fields = PLHM_DATA_POSITION | PLHM_DATA_EULER
+                | PLHM_DATA_TIMESTAMP;
+            r->station = 1 + 2 * s;
+            r->error = (s == 1 && f >= 10 && f < 13) ? 'E' : ' ';
+            r->readtime.tv_sec = (t + s) / 1000000;
+            r->readtime.tv_usec = (t + s) % 1000000;
+            r->timestamp = ts;
+            // slow motion, with stations holding still now and then
+            for (c = 0; c < 3; c++) {
+                r->position[c] = (f / 50 % 2) ? 10.0f * (s + 1)
+                    : 10.0f * (s + 1) + f * 0.01f * (c + 1);
+                r->euler[c] = -90.0f + f * 0.3f * (c - 1) - s;
+            }
+        }
+    }
+}
+
+static int same(const plhm_record_t *a, const plhm_record_t *b)
+{
+    return a->fields == b->fields && a->station == b->station
+        && a->error == b->error && a->timestamp == b->timestamp
+        && a->readtime.tv_sec == b->readtime.tv_sec
+        && a->readtime.tv_usec == b->readtime.tv_usec
+        && !memcmp(a->position, b->position, sizeof(a->position))
+        && !memcmp(a->euler, b->euler, sizeof(a->euler));
+}
+
+static plhm_record_t recs[PLHM_REC_BLOCK_FRAMES * PLHM_REC_MAX_STATIONS];
+
+/* Decode every block, comparing with the frames written.  Returns the
+ * frames decoded, or -1 on the first error. */
+static int decode_all(const uint8_t *data, size_t size)
+{
+    plhm_rec_reader_t r;
+    plhm_rec_block_t b;
+    int rc, n, i, f = 0;
+
+    if (plhm_rec_reader_init(&r, data, size))
+        return -1;
+    while ((rc = plhm_rec_next_block(&r, &b)) == 0)
+    {
+        n = plhm_rec_decode_block(&b, recs);
+        if (n < 0 || n != (int)b.frames * STATIONS)
+            return -1;
+        for (i = 0; i < n; i++)
+            if (f + i / STATIONS >= FRAMES
+                || !same(&recs[i], &frames[f + i / STATIONS][i % STATIONS]))
+            {
+                printf("frame %d station %d differs\n", f + i / STATIONS,
+                       recs[i].station);
+                return -1;
+            }
+        f += b.frames;
+    }
+    return rc < 0 ? -1 : f;
+}
+
+int main()
+{
+    plhm_rec_writer_t w;
+    plhm_rec_reader_t r;
+    plhm_rec_block_t b;
+    uint8_t *copy;
+    char *data;
+    size_t size, block, last;
+    FILE *file;
+    int f;
+
+    make_frames();
+
+    file = open_memstream(&data, &size);
+    if (!file || plhm_rec_writer_open(&w, file))
+        return 1;
+    for (f = 0; f < FRAMES; f++)
+        CHECK(plhm_rec_write(&w, frames[f], STATIONS) == 0);
+    CHECK(plhm_rec_writer_close(&w) == 0);
+    fclose(file);
+
+    CHECK(decode_all((uint8_t*)data, size) == FRAMES);
+
+    copy = malloc(size);
+    memcpy(copy, data, size);
+
+    // the first block, to damage
+    CHECK(plhm_rec_reader_init(&r, copy, size) == 0);
+    CHECK(plhm_rec_next_block(&r, &b) == 0);
+    block = r.pos;
+
+    // a file cut off inside a block
+    CHECK(decode_all(copy, block - b.payload / 2) == -1);
+    CHECK(decode_all(copy, PLHM_REC_HEADER_BYTES + 10) == -1);
+
+    // the last block, which is not full, claiming more frames than its
+    // bit stream holds
+    last = r.pos;
+    while (plhm_rec_next_block(&r, &b) == 0 && r.pos < size)
+        last = r.pos;
+    CHECK(b.frames < PLHM_REC_BLOCK_FRAMES);
+    copy[last + 8] = PLHM_REC_BLOCK_FRAMES & 0xFF;
+    copy[last + 9] = PLHM_REC_BLOCK_FRAMES >> 8;
+    CHECK(plhm_rec_reader_init(&r, copy, size) == 0);
+    r.pos = last;
+    CHECK(plhm_rec_next_block(&r, &b) == 0);
+    CHECK(plhm_rec_decode_block(&b, recs) == -1);
+    memcpy(copy, data, size);
+
+    // damaged headers: magic, payload size, frame count, stations
+    copy[PLHM_REC_HEADER_BYTES] ^= 1;
+    CHECK(decode_all(copy, size) == -1);
+    memcpy(copy, data, size);
+    copy[PLHM_REC_HEADER_BYTES + 4] ^= 1;
+    CHECK(decode_all(copy, size) == -1);
+    memcpy(copy, data, size);
+    copy[PLHM_REC_HEADER_BYTES + 7] = 0x7F;
+    CHECK(decode_all(copy, size) == -1);
+    memcpy(copy, data, size);
+    copy[PLHM_REC_HEADER_BYTES + 9] = 0x10;
+    CHECK(decode_all(copy, size) == -1);
+    memcpy(copy, data, size);
+    copy[PLHM_REC_HEADER_BYTES + 14] = 0x01;
+    CHECK(decode_all(copy, size) == -1);
+    memcpy(copy, data, size);
+
+    // and the file header
+    copy[8] = PLHM_REC_VERSION + 1;
+    CHECK(plhm_rec_reader_init(&r, copy, size) == 1);
+
+    free(copy);
+    free(data);
+    return failed;
+}
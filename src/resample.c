@@ -0,0 +1,381 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "plhm_resample.h"
+
+// frames averaged for the period before the loop takes over
+#define CLOCK_WARMUP 8
+
+// loop gains for the phase and the period of the input clock
+#define CLOCK_GAIN 0.1
+#define PERIOD_GAIN 0.01
+
+// a frame later than this many periods, or this many us while
+// warming up, restarts the clock
+#define MAX_GAP_PERIODS 4
+#define MAX_GAP_US 250000
+
+static int64_t us_since(const struct timeval *start, const struct timeval *t)
+{
+    return (int64_t)(t->tv_sec - start->tv_sec) * 1000000
+        + (t->tv_usec - start->tv_usec);
+}
+
+static int64_t tick_time(const plhm_resample_t *r, int64_t k)
+{
+    return (k * r->den * 1000000 + r->num / 2) / r->num;
+}
+
+int plhm_resample_init(plhm_resample_t *r, int num, int den,
+                       plhm_resample_method method, float latency_ms)
+{
+    memset(r, 0, sizeof(plhm_resample_t));
+    if (num <= 0 || den <= 0 || (int64_t)den * 1000000 < num
+        || latency_ms < 0)
+        return 1;
+    if (method != PLHM_RESAMPLE_LINEAR && method != PLHM_RESAMPLE_HERMITE)
+        return 1;
+    r->num = num;
+    r->den = den;
+    r->method = method;
+    r->latency = (int64_t)(latency_ms * 1000);
+    return 0;
+}
+
+int plhm_resample_parse(plhm_resample_t *r, const char *spec)
+{
+    plhm_resample_method method = PLHM_RESAMPLE_HERMITE;
+    float latency = 20;
+    long num, den = 1;
+    char *end;
+
+    num = strtol(spec, &end, 10);
+    if (end == spec)
+        return 1;
+    if (*end == '/') {
+        spec = end + 1;
+        den = strtol(spec, &end, 10);
+        if (end == spec)
+            return 1;
+    }
+    if (*end == ':') {
+        const char *m = end + 1;
+        size_t len = strcspn(m, ",");
+        if (len == 6 && !strncmp(m, "linear", 6))
+            method = PLHM_RESAMPLE_LINEAR;
+        else if (len == 5 && !strncmp(m, "cubic", 5))
+            method = PLHM_RESAMPLE_HERMITE;
+        else
+            return 1;
+        end = (char*)m + len;
+        if (*end == ',') {
+            spec = end + 1;
+            latency = strtof(spec, &end);
+            if (end == spec)
+                return 1;
+        }
+    }
+    if (*end || num > 1000000 || den > 1000000)
+        return 1;
+
+    return plhm_resample_init(r, num, den, method, latency);
+}
+
+void plhm_resample_reset(plhm_resample_t *r)
+{
+    plhm_resample_t c = *r;
+    plhm_resample_init(r, c.num, c.den, c.method, 0);
+    r->latency = c.latency;
+    r->ticks = c.ticks;
+    r->forced = c.forced;
+    r->skipped = c.skipped;
+}
+
+/* After a gap, interpolating across it makes no sense: drop the
+ * history and continue from the first tick of the new input. */
+static void restart(plhm_resample_t *r, double t)
+{
+    int i;
+    int64_t k = (int64_t)(t * r->num / (r->den * 1000000.0));
+
+    while (k > 0 && tick_time(r, k - 1) >= t)
+        k--;
+    while (tick_time(r, k) < t)
+        k++;
+    if (k > r->tick) {
+        r->skipped += k - r->tick;
+        r->tick = k;
+    }
+    for (i = 0; i < PLHM_FRAME_STATIONS; i++)
+        r->station[i].count = 0;
+    r->frames = 0;
+}
+
+/* Place a frame read at t on the input clock. */
+static double clock_update(plhm_resample_t *r, double t)
+{
+    if (r->frames > 0 && t - r->clock > (r->frames < CLOCK_WARMUP
+                                         ? MAX_GAP_US
+                                         : MAX_GAP_PERIODS * r->period))
+        restart(r, t);
+
+    if (r->frames == 0)
+        r->first = r->clock = t;
+    else if (r->frames < CLOCK_WARMUP) {
+        r->period = (t - r->first) / r->frames;
+        r->clock = t;
+    }
+    else {
+        double predicted = r->clock + r->period;
+        double err = t - predicted;
+        double c = predicted + CLOCK_GAIN * err;
+
+        r->period += PERIOD_GAIN * err;
+        // frames that arrive in a burst must not go backwards
+        if (c < r->clock + r->period / 2)
+            c = r->clock + r->period / 2;
+        r->clock = c;
+    }
+    r->frames++;
+    return r->clock;
+}
+
+void plhm_resample_push(plhm_resample_t *r, const plhm_record_t *recs, int n)
+{
+    double t;
+    int i, j;
+
+    if (n <= 0)
+        return;
+
+    if (!r->started) {
+        r->start = recs[n-1].readtime;
+        r->started = 1;
+    }
+    t = clock_update(r, us_since(&r->start, &recs[n-1].readtime));
+
+    for (i = 0; i < n; i++)
+    {
+        int s = recs[i].station - 1;
+        plhm_resample_station_t *st;
+        float *q;
+
+        if (s < 0 || s >= PLHM_FRAME_STATIONS)
+            continue;
+        st = &r->station[s];
+
+        if (st->count == PLHM_RESAMPLE_HISTORY) {
+            memmove(st->time, st->time + 1,
+                    sizeof(st->time[0]) * (PLHM_RESAMPLE_HISTORY - 1));
+            memmove(st->rec, st->rec + 1,
+                    sizeof(st->rec[0]) * (PLHM_RESAMPLE_HISTORY - 1));
+            memmove(st->q, st->q + 1,
+                    sizeof(st->q[0]) * (PLHM_RESAMPLE_HISTORY - 1));
+            st->count--;
+        }
+
+        st->time[st->count] = t;
+        st->rec[st->count] = recs[i];
+        q = st->q[st->count];
+        if (recs[i].fields & PLHM_DATA_EULER) {
+            plhm_euler_to_quat(recs[i].euler, q);
+            // q and -q are the same orientation; keep successive
+            // samples in the same hemisphere so that slerp takes the
+            // shorter way
+            if (st->count > 0) {
+                const float *p = st->q[st->count - 1];
+                if (p[0]*q[0] + p[1]*q[1] + p[2]*q[2] + p[3]*q[3] < 0)
+                    for (j = 0; j < 4; j++)
+                        q[j] = -q[j];
+            }
+        }
+        else {
+            q[0] = 1;
+            q[1] = q[2] = q[3] = 0;
+        }
+        st->count++;
+    }
+}
+
+static void slerp(const float a[4], const float b[4], double u, float q[4])
+{
+    double d = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+    double s0 = 1 - u, s1 = u, n;
+    int j;
+
+    // nearly equal: lerp and renormalize
+    if (d < 0.9995) {
+        double theta = acos(d);
+        double s = sin(theta);
+        s0 = sin((1 - u) * theta) / s;
+        s1 = sin(u * theta) / s;
+    }
+    for (j = 0; j < 4; j++)
+        q[j] = (float)(s0 * a[j] + s1 * b[j]);
+
+    n = sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+    if (n > 0)
+        for (j = 0; j < 4; j++)
+            q[j] /= n;
+}
+
+/* Slope of one position component at sample i, from its neighbours
+ * where there are some. */
+static double slope(const plhm_resample_station_t *st, int i, int c)
+{
+    int a = i > 0 ? i - 1 : i;
+    int b = i < st->count - 1 ? i + 1 : i;
+
+    if (st->time[b] <= st->time[a])
+        return 0;
+    return (st->rec[b].position[c] - st->rec[a].position[c])
+        / (st->time[b] - st->time[a]);
+}
+
+static void interpolate(const plhm_resample_t *r,
+                        const plhm_resample_station_t *st, double t,
+                        plhm_record_t *out)
+{
+    const plhm_record_t *a, *b;
+    double h, u;
+    int i, c;
+
+    for (i = st->count - 1; i > 0 && st->time[i] > t; i--) {}
+
+    a = &st->rec[i];
+    *out = *a;
+    if (i == st->count - 1 || t <= st->time[i])
+        return;
+
+    // the layout changed between the two: take the nearer
+    b = &st->rec[i+1];
+    h = st->time[i+1] - st->time[i];
+    u = (t - st->time[i]) / h;
+    if (a->fields != b->fields) {
+        if (u >= 0.5)
+            *out = *b;
+        return;
+    }
+    if (u >= 0.5)
+        out->error = b->error;
+
+    if (a->fields & PLHM_DATA_POSITION)
+    {
+        for (c = 0; c < 3; c++)
+        {
+            double p0 = a->position[c], p1 = b->position[c];
+            if (r->method == PLHM_RESAMPLE_HERMITE) {
+                double m0 = slope(st, i, c) * h, m1 = slope(st, i+1, c) * h;
+                double u2 = u*u, u3 = u2*u;
+                out->position[c] = (float)((2*u3 - 3*u2 + 1) * p0
+                                           + (u3 - 2*u2 + u) * m0
+                                           + (-2*u3 + 3*u2) * p1
+                                           + (u3 - u2) * m1);
+            }
+            else
+                out->position[c] = (float)(p0 + (p1 - p0) * u);
+        }
+    }
+
+    if (a->fields & PLHM_DATA_EULER)
+    {
+        float q[4];
+        slerp(st->q[i], st->q[i+1], u, q);
+        plhm_quat_to_euler(q, out->euler);
+    }
+
+    if (a->fields & PLHM_DATA_TIMESTAMP)
+        out->timestamp = a->timestamp
+            + (unsigned int)floor((int)(b->timestamp - a->timestamp) * u + 0.5);
+}
+
+static int stale(const plhm_resample_t *r,
+                 const plhm_resample_station_t *st)
+{
+    return !st->count || st->time[st->count - 1] + r->latency < r->clock;
+}
+
+int plhm_resample_pull(plhm_resample_t *r, plhm_record_t *out,
+                       const struct timeval *now, int64_t *tick)
+{
+    int64_t t;
+    int i, n = 0, ready = 1, any = 0;
+    int need = r->method == PLHM_RESAMPLE_HERMITE ? 2 : 1;
+
+    if (!r->started)
+        return 0;
+    t = tick_time(r, r->tick);
+
+    for (i = 0; i < PLHM_FRAME_STATIONS; i++)
+    {
+        const plhm_resample_station_t *st = &r->station[i];
+
+        // stations that stopped while others go on are left out once
+        // they are older than the latency bound
+        if (stale(r, st))
+            continue;
+        any = 1;
+        if (st->count < need || st->time[st->count - need] < t)
+            ready = 0;
+    }
+    if (!any)
+        return 0;
+
+    if (!ready) {
+        if (!now || us_since(&r->start, now) < t + r->latency)
+            return 0;
+        r->forced++;
+    }
+
+    for (i = 0; i < PLHM_FRAME_STATIONS; i++)
+    {
+        const plhm_resample_station_t *st = &r->station[i];
+        int64_t us;
+
+        if (stale(r, st))
+            continue;
+        interpolate(r, st, t, &out[n]);
+
+        us = r->start.tv_usec + t;
+        out[n].readtime.tv_sec = r->start.tv_sec + us / 1000000;
+        out[n].readtime.tv_usec = us % 1000000;
+        n++;
+    }
+
+    if (tick)
+        *tick = r->tick;
+    r->tick++;
+    r->ticks++;
+    return n;
+}
+
+int plhm_resample_timeout(const plhm_resample_t *r,
+                          const struct timeval *now)
+{
+    int64_t due;
+    int i;
+
+    if (!r->started)
+        return -1;
+    for (i = 0; i < PLHM_FRAME_STATIONS; i++)
+        if (!stale(r, &r->station[i]))
+            break;
+    if (i == PLHM_FRAME_STATIONS)
+        return -1;
+
+    due = tick_time(r, r->tick) + r->latency - us_since(&r->start, now);
+    return due > 0 ? (int)((due + 999) / 1000) : 0;
+}
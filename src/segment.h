@@ -0,0 +1,26 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _SEGMENT_H_
+#define _SEGMENT_H_
+
+/* Shared memory with a single writer, internal to libplhm.  The
+ * writer holds a lock on the segment for as long as its descriptor is
+ * open, so that one left behind by a writer that exited can be told
+ * from one still in use. */
+
+/* Create the segment name for writing, replacing a stale one.
+ * Returns its descriptor, or -1 with errno set, EBUSY if another
+ * writer has it. */
+int plhm_segment_create(const char *name);
+
+#endif // _SEGMENT_H_
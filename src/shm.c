@@ -0,0 +1,229 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include "plhm_shm.h"
+#include "segment.h"
+
+int plhm_segment_create(const char *name)
+{
+    struct stat st;
+    int fd, tries;
+
+    for (tries = 0; tries < 2; tries++)
+    {
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd >= 0) {
+            // another writer may be looking at it for a moment
+            flock(fd, LOCK_EX);
+            return fd;
+        }
+        if (errno != EEXIST)
+            return -1;
+
+        // a writer that exited has released its lock; one that is
+        // creating the segment has not sized it yet
+        fd = shm_open(name, O_RDWR, 0);
+        if (fd == -1)
+            continue;
+        if (flock(fd, LOCK_EX | LOCK_NB) || fstat(fd, &st)
+            || st.st_size == 0)
+        {
+            close(fd);
+            errno = EBUSY;
+            return -1;
+        }
+        shm_unlink(name);
+        close(fd);
+    }
+    errno = EBUSY;
+    return -1;
+}
+
+int plhm_shm_create(plhm_shm_t *s, const char *name)
+{
+    memset(s, 0, sizeof(plhm_shm_t));
+    strncpy(s->name, name ? name : PLHM_SHM_DEFAULT_NAME,
+            sizeof(s->name)-1);
+
+    s->fd = plhm_segment_create(s->name);
+    if (s->fd == -1) {
+        if (errno == EBUSY)
+            printf("Shared memory %s is in use by another plhm.\n",
+                   s->name);
+        else {
+            printf("Could not create shared memory %s.\n", s->name);
+            perror("shm_open");
+        }
+        return 1;
+    }
+
+    if (ftruncate(s->fd, sizeof(plhm_shm_frame_t))) {
+        perror("ftruncate");
+        close(s->fd);
+        shm_unlink(s->name);
+        return 1;
+    }
+
+    s->frame = mmap(0, sizeof(plhm_shm_frame_t), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, s->fd, 0);
+    if (s->frame == MAP_FAILED) {
+        perror("mmap");
+        close(s->fd);
+        shm_unlink(s->name);
+        s->frame = 0;
+        return 1;
+    }
+
+    memset(s->frame, 0, sizeof(plhm_shm_frame_t));
+    s->frame->version = PLHM_SHM_VERSION;
+    __atomic_store_n(&s->frame->magic, PLHM_SHM_MAGIC, __ATOMIC_RELEASE);
+    s->writer = 1;
+    return 0;
+}
+
+int plhm_shm_publish(plhm_shm_t *s, const plhm_record_t *recs, int n)
+{
+    plhm_shm_frame_t *f = s->frame;
+    uint32_t seq = f->seq;
+    int i;
+
+    // odd sequence: readers retry until the frame is complete
+    __atomic_store_n(&f->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    f->station_mask = 0;
+    for (i = 0; i < n; i++)
+    {
+        const plhm_record_t *r = &recs[i];
+        plhm_shm_station_t *st;
+        if (r->station < 1 || r->station > PLHM_SHM_STATIONS)
+            continue;
+        st = &f->station[r->station - 1];
+        st->station = r->station;
+        st->error = r->error;
+        memcpy(st->position, r->position, sizeof(st->position));
+        memcpy(st->euler, r->euler, sizeof(st->euler));
+        st->timestamp = r->timestamp;
+        st->readtime_sec = r->readtime.tv_sec;
+        st->readtime_usec = r->readtime.tv_usec;
+        f->station_mask |= 1 << (r->station - 1);
+        f->fields = r->fields;
+    }
+    if (n > 0) {
+        f->readtime_sec = recs[n-1].readtime.tv_sec;
+        f->readtime_usec = recs[n-1].readtime.tv_usec;
+    }
+    f->frame++;
+
+    __atomic_store_n(&f->seq, seq + 2, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int plhm_shm_open(plhm_shm_t *s, const char *name)
+{
+    memset(s, 0, sizeof(plhm_shm_t));
+    strncpy(s->name, name ? name : PLHM_SHM_DEFAULT_NAME,
+            sizeof(s->name)-1);
+
+    s->fd = shm_open(s->name, O_RDONLY, 0);
+    if (s->fd == -1)
+        return 1;
+
+    s->frame = mmap(0, sizeof(plhm_shm_frame_t), PROT_READ,
+                    MAP_SHARED, s->fd, 0);
+    if (s->frame == MAP_FAILED) {
+        close(s->fd);
+        s->frame = 0;
+        return 1;
+    }
+
+    if (__atomic_load_n(&s->frame->magic, __ATOMIC_ACQUIRE) != PLHM_SHM_MAGIC
+        || s->frame->version != PLHM_SHM_VERSION)
+    {
+        printf("Shared memory %s is not a plhm frame.\n", s->name);
+        plhm_shm_close(s);
+        return 2;
+    }
+    return 0;
+}
+
+uint32_t plhm_shm_read_begin(plhm_shm_t *s)
+{
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&s->frame->seq, __ATOMIC_ACQUIRE)) & 1)
+        ;
+    return seq;
+}
+
+int plhm_shm_read_retry(plhm_shm_t *s, uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&s->frame->seq, __ATOMIC_RELAXED) != seq;
+}
+
+int plhm_shm_read(plhm_shm_t *s, plhm_shm_frame_t *out)
+{
+    uint32_t seq;
+    do {
+        seq = plhm_shm_read_begin(s);
+        memcpy(out, s->frame, sizeof(plhm_shm_frame_t));
+    } while (plhm_shm_read_retry(s, seq));
+    return 0;
+}
+
+int plhm_shm_read_station(plhm_shm_t *s, int station, plhm_record_t *r)
+{
+    const plhm_shm_station_t *st;
+    uint32_t seq, mask;
+
+    if (station < 1 || station > PLHM_SHM_STATIONS)
+        return 1;
+    st = &s->frame->station[station - 1];
+
+    do {
+        seq = plhm_shm_read_begin(s);
+        mask = s->frame->station_mask;
+        r->fields = s->frame->fields;
+        r->station = st->station;
+        r->error = st->error;
+        memcpy(r->position, st->position, sizeof(r->position));
+        memcpy(r->euler, st->euler, sizeof(r->euler));
+        r->timestamp = st->timestamp;
+        r->readtime.tv_sec = st->readtime_sec;
+        r->readtime.tv_usec = st->readtime_usec;
+    } while (plhm_shm_read_retry(s, seq));
+
+    // no data for this station in the latest frame
+    return !(mask & (1 << (station - 1)));
+}
+
+int plhm_shm_close(plhm_shm_t *s)
+{
+    if (s->frame)
+        munmap(s->frame, sizeof(plhm_shm_frame_t));
+    if (s->fd >= 0)
+        close(s->fd);
+    if (s->writer)
+        shm_unlink(s->name);
+    s->frame = 0;
+    s->fd = -1;
+    return 0;
+}
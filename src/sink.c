@@ -0,0 +1,298 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sink.h"
+
+static const char *policy_names[] = { "block", "drop", "coalesce" };
+
+const char *sink_policy_name(sink_policy p)
+{
+    return policy_names[p];
+}
+
+int sink_parse_policy(const char *str, sink_policy *p)
+{
+    int i;
+    for (i = 0; i < 3; i++) {
+        if (!strcmp(str, policy_names[i])) {
+            *p = i;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void sink_ring_init(sink_ring_t *r)
+{
+    memset(r, 0, sizeof(sink_ring_t));
+    pthread_mutex_init(&r->lock, 0);
+    pthread_cond_init(&r->published, 0);
+    pthread_cond_init(&r->released, 0);
+}
+
+void sink_ring_free(sink_ring_t *r)
+{
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->published);
+    pthread_cond_destroy(&r->released);
+}
+
+/* Replace the records of dst with the stations present in f, so that
+ * it holds the latest sample of each.  Events are kept, since each
+ * happens only once; returns the number that did not fit. */
+static int coalesce(frame_t *dst, const frame_t *f)
+{
+    int i, j;
+    for (i = 0; i < f->n; i++)
+    {
+        for (j = 0; j < dst->n; j++)
+            if (dst->recs[j].station == f->recs[i].station)
+                break;
+        if (j == dst->n) {
+            if (dst->n >= SINK_MAX_STATIONS)
+                continue;
+            dst->n++;
+        }
+        dst->recs[j] = f->recs[i];
+    }
+    dst->tick = f->tick;
+    if (f->features.features)
+        dst->features = f->features;
+    for (i = 0; i < f->n_events && dst->n_events < SINK_MAX_EVENTS; i++)
+        dst->events[dst->n_events++] = f->events[i];
+    return f->n_events - i;
+}
+
+/* Called with the lock held. */
+static void release(sink_ring_t *r, uint64_t seq)
+{
+    if (--r->refs[seq % SINK_RING_FRAMES] == 0)
+        pthread_cond_signal(&r->released);
+}
+
+/* Take the oldest frame it has not started away from each sink that
+ * does not block and has fallen too far behind.  Such a sink writes
+ * from its own copy, so only sinks that block can keep the ring
+ * full. */
+static void reclaim(sink_ring_t *r)
+{
+    int i;
+
+    for (i = 0; i < r->n_sinks; i++)
+    {
+        sink_t *s = r->sinks[i];
+        frame_t *f = &r->frames[s->next % SINK_RING_FRAMES];
+
+        if (s->policy == SINK_BLOCK || r->head - s->next < SINK_QUEUE_FRAMES)
+            continue;
+        if (s->policy == SINK_COALESCE) {
+            if (s->carried)
+                s->events_dropped += coalesce(&s->carry, f);
+            else
+                s->carry = *f;
+            s->carried = 1;
+            s->coalesced++;
+        }
+        else {
+            s->dropped++;
+            s->events_dropped += f->n_events;
+        }
+        release(r, s->next++);
+    }
+}
+
+/* Called with the lock held. */
+static void free_frames(sink_ring_t *r)
+{
+    while (r->tail < r->head && !r->refs[r->tail % SINK_RING_FRAMES])
+        r->tail++;
+}
+
+frame_t *sink_ring_acquire(sink_ring_t *r)
+{
+    int i, waited = 0;
+
+    pthread_mutex_lock(&r->lock);
+    free_frames(r);
+    if (r->head - r->tail >= SINK_QUEUE_FRAMES) {
+        reclaim(r);
+        free_frames(r);
+    }
+    while (r->head - r->tail >= SINK_RING_FRAMES)
+    {
+        if (!waited) {
+            // charge the sinks holding the oldest frame
+            for (i = 0; i < r->n_sinks; i++)
+                if (r->sinks[i]->policy == SINK_BLOCK
+                    && r->sinks[i]->next - r->sinks[i]->writing <= r->tail)
+                    r->sinks[i]->delayed++;
+            waited = 1;
+        }
+        pthread_cond_wait(&r->released, &r->lock);
+        free_frames(r);
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    return &r->frames[r->head % SINK_RING_FRAMES];
+}
+
+void sink_ring_publish(sink_ring_t *r)
+{
+    int i, n = 0;
+
+    pthread_mutex_lock(&r->lock);
+    for (i = 0; i < r->n_sinks; i++)
+        n += r->sinks[i]->running;
+    r->refs[r->head % SINK_RING_FRAMES] = n;
+    r->times[r->head % SINK_RING_FRAMES] = monotonic_us();
+    r->head++;
+    if (n)
+        pthread_cond_broadcast(&r->published);
+    pthread_mutex_unlock(&r->lock);
+}
+
+static void *sink_thread(void *arg)
+{
+    sink_t *s = (sink_t*)arg;
+    sink_ring_t *r = s->ring;
+    frame_t merged;
+    const frame_t *f;
+    uint64_t seq;
+    double published;
+
+    pthread_mutex_lock(&r->lock);
+    while (1)
+    {
+        while (s->running && s->next == r->head)
+            pthread_cond_wait(&r->published, &r->lock);
+
+        // drain what is published before stopping
+        if (s->next == r->head)
+            break;
+
+        if (r->head - s->next > (uint64_t)s->max_queued)
+            s->max_queued = r->head - s->next;
+
+        seq = s->next++;
+        f = &r->frames[seq % SINK_RING_FRAMES];
+        published = r->times[seq % SINK_RING_FRAMES];
+
+        // frames taken from this sink under overload come first
+        if (s->carried) {
+            merged = s->carry;
+            s->carried = 0;
+            s->events_dropped += coalesce(&merged, f);
+            release(r, seq);
+            f = &merged;
+        }
+        // a sink that does not block must not hold the ring while it
+        // writes, or acquisition would wait for it once the ring fills
+        else if (s->policy != SINK_BLOCK) {
+            merged = *f;
+            release(r, seq);
+            f = &merged;
+        }
+        else
+            s->writing = 1;
+        pthread_mutex_unlock(&r->lock);
+
+        s->write(f, s->user_data);
+
+        pthread_mutex_lock(&r->lock);
+        if (s->writing) {
+            s->writing = 0;
+            release(r, seq);
+        }
+        s->frames++;
+        histogram_add(&s->latency, monotonic_us() - published);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return 0;
+}
+
+int sink_start(sink_t *s, sink_ring_t *r, const char *name,
+               sink_policy policy, sink_write_fn *write, void *user_data)
+{
+    memset(s, 0, sizeof(sink_t));
+    s->name = name;
+    s->policy = policy;
+    s->write = write;
+    s->user_data = user_data;
+    s->ring = r;
+
+    pthread_mutex_lock(&r->lock);
+    if (r->n_sinks == SINK_MAX_SINKS) {
+        pthread_mutex_unlock(&r->lock);
+        printf("[plhm] Too many sinks for %s.\n", name);
+        return 1;
+    }
+    s->next = r->head;
+    s->running = 1;
+    if (pthread_create(&s->thread, 0, sink_thread, s)) {
+        pthread_mutex_unlock(&r->lock);
+        printf("[plhm] Could not start %s sink.\n", name);
+        s->running = 0;
+        return 1;
+    }
+    r->sinks[r->n_sinks++] = s;
+    pthread_mutex_unlock(&r->lock);
+    return 0;
+}
+
+void sink_stop(sink_t *s)
+{
+    sink_ring_t *r = s->ring;
+    int i;
+
+    if (!s->running)
+        return;
+
+    pthread_mutex_lock(&r->lock);
+    s->running = 0;
+    pthread_cond_broadcast(&r->published);
+    pthread_mutex_unlock(&r->lock);
+
+    pthread_join(s->thread, 0);
+
+    pthread_mutex_lock(&r->lock);
+    for (i = 0; i < r->n_sinks; i++)
+        if (r->sinks[i] == s) {
+            r->sinks[i] = r->sinks[--r->n_sinks];
+            break;
+        }
+    pthread_mutex_unlock(&r->lock);
+
+    if (s->dropped || s->coalesced || s->delayed)
+        fprintf(stderr, "[plhm] %s sink: %lu frames written, %lu dropped, "
+                "%lu coalesced, %lu delayed, %lu events lost\n", s->name,
+                s->frames, s->dropped, s->coalesced, s->delayed,
+                s->events_dropped);
+}
+
+void sink_get_stats(sink_t *s, sink_stats_t *st)
+{
+    sink_ring_t *r = s->ring;
+
+    pthread_mutex_lock(&r->lock);
+    st->frames = s->frames;
+    st->dropped = s->dropped;
+    st->coalesced = s->coalesced;
+    st->delayed = s->delayed;
+    st->events_dropped = s->events_dropped;
+    st->queued = s->running ? r->head - s->next : 0;
+    st->max_queued = s->max_queued;
+    st->latency = s->latency;
+    pthread_mutex_unlock(&r->lock);
+}
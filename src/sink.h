@@ -0,0 +1,126 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _SINK_H_
+#define _SINK_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <plhm.h>
+#include <plhm_features.h>
+#include <plhm_triggers.h>
+
+#include "metrics.h"
+
+#define SINK_MAX_STATIONS 16
+#define SINK_RING_FRAMES 128
+#define SINK_QUEUE_FRAMES 64    // most frames a sink that does not block
+                                // may fall behind
+#define SINK_MAX_EVENTS 32
+#define SINK_MAX_SINKS 8
+
+/* One complete frame: a record for each active station, and the
+ * gesture features and trigger events computed from it, if any. */
+typedef struct _frame
+{
+    int n;
+    int64_t tick;       // index of a resampled frame, -1 if not resampled
+    plhm_record_t recs[SINK_MAX_STATIONS];
+    plhm_feature_values_t features;
+    int n_events;
+    plhm_trigger_event_t events[SINK_MAX_EVENTS];
+} frame_t;
+
+/* What to do when a sink falls SINK_QUEUE_FRAMES behind. */
+typedef enum _sink_policy
+{
+    SINK_BLOCK,         // let the ring fill, then delay acquisition
+    SINK_DROP_OLDEST,   // the sink skips the oldest frame
+    SINK_COALESCE,      // the sink merges it into the next frame
+} sink_policy;
+
+typedef void sink_write_fn(const frame_t *f, void *user_data);
+
+struct _sink;
+
+/* Frames shared by the acquisition stage and all sinks.  Acquisition
+ * fills the frame at head in place and publishes it; each sink follows
+ * with its own cursor, and a frame is reused once every sink that was
+ * running when it was published has released it. */
+typedef struct _sink_ring
+{
+    frame_t frames[SINK_RING_FRAMES];
+    int refs[SINK_RING_FRAMES];     // sinks yet to release each frame
+    double times[SINK_RING_FRAMES]; // when each was published, in us
+    uint64_t head;                  // the next frame to publish
+    uint64_t tail;                  // the oldest frame still held
+
+    struct _sink *sinks[SINK_MAX_SINKS];
+    int n_sinks;
+
+    pthread_mutex_t lock;
+    pthread_cond_t published, released;
+} sink_ring_t;
+
+/* A consumer of frames running on its own thread, so that a slow file
+ * or network cannot stall the serial port. */
+typedef struct _sink
+{
+    const char *name;
+    sink_policy policy;
+    sink_write_fn *write;
+    void *user_data;
+
+    sink_ring_t *ring;
+    uint64_t next;              // the next frame to write
+    frame_t carry;              // frames skipped while coalescing,
+    int carried;                // merged, if any
+    int writing;                // holding the frame before next
+    int running;
+    pthread_t thread;
+
+    // overload accounting
+    unsigned long frames;       // frames written
+    unsigned long dropped;      // frames skipped unwritten
+    unsigned long coalesced;    // frames merged into a later frame
+    unsigned long delayed;      // frames acquisition had to wait for
+    unsigned long events_dropped;   // trigger events in frames dropped
+    int max_queued;
+    histogram_t latency;        // from publishing to written
+} sink_t;
+
+typedef struct _sink_stats
+{
+    unsigned long frames, dropped, coalesced, delayed, events_dropped;
+    int queued, max_queued;
+    histogram_t latency;
+} sink_stats_t;
+
+void sink_ring_init(sink_ring_t *r);
+void sink_ring_free(sink_ring_t *r);
+
+/* The frame to fill next, waiting for sinks that block if the ring is
+ * full of frames they hold; sinks that do not block never delay it.
+ * It is handed to the sinks by sink_ring_publish(), or reused by the
+ * next call if it is not published. */
+frame_t *sink_ring_acquire(sink_ring_t *r);
+void sink_ring_publish(sink_ring_t *r);
+
+int sink_start(sink_t *s, sink_ring_t *r, const char *name,
+               sink_policy policy, sink_write_fn *write, void *user_data);
+void sink_stop(sink_t *s);
+void sink_get_stats(sink_t *s, sink_stats_t *st);
+
+const char *sink_policy_name(sink_policy p);
+int sink_parse_policy(const char *str, sink_policy *p);
+
+#endif // _SINK_H_
@@ -0,0 +1,85 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* Sinks that drop or coalesce frames must never delay acquisition,
+ * even while stalled in a write. */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "sink.h"
+
+#define FRAMES (4 * SINK_RING_FRAMES)
+#define STALL_US 1000000
+#define MAX_WAIT_US 100000.0
+
+static void stalled_write(const frame_t *f, void *user_data)
+{
+    int *stalled = (int*)user_data;
+    if (!*stalled) {
+        *stalled = 1;
+        usleep(STALL_US);
+    }
+}
+
+static int run(sink_policy policy)
+{
+    sink_ring_t r;
+    sink_t s;
+    sink_stats_t st;
+    frame_t *f;
+    double t, longest = 0;
+    int i, stalled = 0, failed = 0;
+
+    sink_ring_init(&r);
+    if (sink_start(&s, &r, sink_policy_name(policy), policy,
+                   stalled_write, &stalled))
+        return 1;
+
+    for (i = 0; i < FRAMES; i++)
+    {
+        t = monotonic_us();
+        f = sink_ring_acquire(&r);
+        t = monotonic_us() - t;
+        if (t > longest)
+            longest = t;
+        f->n = 0;
+        f->tick = i;
+        f->features.features = 0;
+        f->n_events = 0;
+        sink_ring_publish(&r);
+    }
+
+    sink_stop(&s);
+    sink_get_stats(&s, &st);
+    sink_ring_free(&r);
+
+    if (longest > MAX_WAIT_US || st.delayed) {
+        printf("%s sink: acquisition waited %.0f us, %lu frames delayed\n",
+               sink_policy_name(policy), longest, st.delayed);
+        failed = 1;
+    }
+    if (st.frames + st.dropped + st.coalesced != FRAMES) {
+        printf("%s sink: %lu written, %lu dropped, %lu coalesced "
+               "of %d\n", sink_policy_name(policy), st.frames,
+               st.dropped, st.coalesced, FRAMES);
+        failed = 1;
+    }
+    return failed;
+}
+
+int main()
+{
+    int failed = run(SINK_DROP_OLDEST);
+    failed |= run(SINK_COALESCE);
+    return failed;
+}
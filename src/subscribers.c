@@ -0,0 +1,440 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <pthread.h>
+
+#include "config.h"
+
+#ifdef HAVE_LIBLO
+
+#include "subscribers.h"
+
+/* Largest bundle serialised for sendmmsg(); bigger ones go through
+ * lo_send_bundle(). */
+#define BUNDLE_MAX 8192
+
+enum {
+    PATH_X, PATH_Y, PATH_Z,
+    PATH_AZIMUTH, PATH_ELEVATION, PATH_ROLL,
+    PATH_TIMESTAMP, PATH_READTIME,
+    PATH_VELOCITY, PATH_ACCELERATION, PATH_JERK, PATH_SPEED,
+    PATH_ANGULAR_VELOCITY,
+    PATH_COUNT
+};
+
+static const char *path_names[PATH_COUNT] = {
+    "x", "y", "z", "azimuth", "elevation", "roll", "timestamp", "readtime",
+    "velocity", "acceleration", "jerk", "speed", "angular_velocity"
+};
+
+typedef struct
+{
+    subscription_t s;
+    double expires;     // ms, or 0 for no expiry
+    unsigned int frames;
+    char buffer[BUNDLE_MAX];
+} subscriber_t;
+
+static subscriber_t subscribers[MAX_SUBSCRIBERS];
+static int n_subscribers = 0;
+static char paths[16][PATH_COUNT][40];
+static char distance_paths[PLHM_FEATURE_PAIRS][32];
+static int paths_ready = 0;
+static int sock4 = -1, sock6 = -1;
+
+// frames are sent from the OSC sink thread
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+int subscription_resolve(subscription_t *s)
+{
+    struct addrinfo hints, *res;
+    char port[30];
+
+    sprintf(port, "%d", s->port);
+    s->addr = lo_address_new(s->host, port);
+    if (!s->addr) {
+        printf("[plhm] Couldn't open OSC address %s:%d\n", s->host, s->port);
+        return 1;
+    }
+
+    // a failed lookup here only means falling back to liblo
+    s->salen = 0;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (!getaddrinfo(s->host, port, &hints, &res)) {
+        memcpy(&s->sa, res->ai_addr, res->ai_addrlen);
+        s->salen = res->ai_addrlen;
+        freeaddrinfo(res);
+    }
+    return 0;
+}
+
+void subscription_release(subscription_t *s)
+{
+    if (s->addr)
+        lo_address_free(s->addr);
+    s->addr = 0;
+}
+
+static void remove_at(int i)
+{
+    subscription_release(&subscribers[i].s);
+    n_subscribers--;
+    if (i != n_subscribers)
+        memcpy(&subscribers[i], &subscribers[n_subscribers],
+               sizeof(subscriber_t));
+}
+
+void subscribers_add(subscription_t *s, double now)
+{
+    int i;
+    subscriber_t *sub = 0;
+
+    pthread_mutex_lock(&lock);
+    for (i = 0; i < n_subscribers; i++) {
+        if ((s->primary && subscribers[i].s.primary)
+            || (!s->primary && !subscribers[i].s.primary
+                && subscribers[i].s.port == s->port
+                && !strcmp(subscribers[i].s.host, s->host)))
+        {
+            sub = &subscribers[i];
+            subscription_release(&sub->s);
+            break;
+        }
+    }
+
+    if (!sub) {
+        if (n_subscribers >= MAX_SUBSCRIBERS) {
+            printf("[plhm] Too many subscribers, ignoring %s:%d\n",
+                   s->host, s->port);
+            subscription_release(s);
+            pthread_mutex_unlock(&lock);
+            return;
+        }
+        sub = &subscribers[n_subscribers++];
+        sub->frames = 0;
+        printf("[plhm] subscribed %s:%d\n", s->host, s->port);
+    }
+
+    sub->s = *s;
+    if (sub->s.divisor < 1)
+        sub->s.divisor = 1;
+    sub->expires = s->lease ? now + s->lease * 1000.0 : 0;
+
+    // ownership of the address passes to the table
+    s->addr = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+int subscribers_remove(const char *host, int port)
+{
+    int i, rc = 1;
+    pthread_mutex_lock(&lock);
+    for (i = 0; i < n_subscribers; i++) {
+        if (!subscribers[i].s.primary && subscribers[i].s.port == port
+            && !strcmp(subscribers[i].s.host, host))
+        {
+            printf("[plhm] unsubscribed %s:%d\n", host, port);
+            remove_at(i);
+            rc = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return rc;
+}
+
+int subscribers_count()
+{
+    int n;
+    pthread_mutex_lock(&lock);
+    n = n_subscribers;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+void subscribers_free()
+{
+    pthread_mutex_lock(&lock);
+    while (n_subscribers > 0)
+        remove_at(n_subscribers - 1);
+    if (sock4 >= 0) close(sock4);
+    if (sock6 >= 0) close(sock6);
+    sock4 = sock6 = -1;
+    pthread_mutex_unlock(&lock);
+}
+
+static void add_float(lo_bundle b, const char *path, float f)
+{
+    lo_message m = lo_message_new();
+    lo_message_add_float(m, f);
+    lo_bundle_add_message(b, path, m);
+}
+
+static void add_vector(lo_bundle b, const char *path, const float *v)
+{
+    lo_message m = lo_message_new();
+    lo_message_add_float(m, v[0]);
+    lo_message_add_float(m, v[1]);
+    lo_message_add_float(m, v[2]);
+    lo_bundle_add_message(b, path, m);
+}
+
+static void add_features(lo_bundle b, subscriber_t *sub,
+                         const plhm_feature_values_t *fv)
+{
+    int features = fv->features & sub->s.features;
+    uint32_t stations = fv->station_mask & sub->s.station_mask;
+    int st, j;
+
+    for (st = 0; st < 16; st++)
+    {
+        uint32_t bit = 1 << st;
+        if (!(stations & bit))
+            continue;
+
+        if ((features & PLHM_FEATURE_VELOCITY) && (fv->velocity_mask & bit))
+            add_vector(b, paths[st][PATH_VELOCITY], fv->velocity[st]);
+        if ((features & PLHM_FEATURE_ACCELERATION)
+            && (fv->acceleration_mask & bit))
+            add_vector(b, paths[st][PATH_ACCELERATION],
+                       fv->acceleration[st]);
+        if ((features & PLHM_FEATURE_JERK) && (fv->jerk_mask & bit))
+            add_vector(b, paths[st][PATH_JERK], fv->jerk[st]);
+        if ((features & PLHM_FEATURE_SPEED) && (fv->velocity_mask & bit))
+            add_float(b, paths[st][PATH_SPEED], fv->speed[st]);
+        if ((features & PLHM_FEATURE_ANGULAR_VELOCITY)
+            && (fv->velocity_mask & bit))
+            add_vector(b, paths[st][PATH_ANGULAR_VELOCITY],
+                       fv->angular_velocity[st]);
+
+        if (features & PLHM_FEATURE_DISTANCE)
+            for (j = st + 1; j < 16; j++)
+                if (stations & (1 << j))
+                    add_float(b, distance_paths[PLHM_FEATURE_PAIR(st, j)],
+                              fv->distance[PLHM_FEATURE_PAIR(st, j)]);
+    }
+}
+
+static void add_events(lo_bundle b, subscriber_t *sub, const frame_t *f,
+                       const plhm_triggers_t *t)
+{
+    static const char *event_paths[] = {
+        "/liberty/region/enter", "/liberty/region/exit",
+        "/liberty/proximity/near", "/liberty/proximity/far"
+    };
+    int i;
+
+    for (i = 0; i < f->n_events; i++)
+    {
+        const plhm_trigger_event_t *e = &f->events[i];
+        lo_message m;
+
+        if (!(sub->s.station_mask & (1 << e->station)))
+            continue;
+
+        m = lo_message_new();
+        if (e->type == PLHM_TRIGGER_ENTER || e->type == PLHM_TRIGGER_EXIT)
+            lo_message_add_string(m, t->regions[e->index].name);
+        else {
+            lo_message_add_string(m, t->rules[e->index].name);
+            lo_message_add_int32(m, e->other + 1);
+        }
+        lo_message_add_int32(m, e->station + 1);
+        lo_bundle_add_message(b, event_paths[e->type], m);
+    }
+}
+
+/* OSC time of a host time: seconds since 1900, and a binary fraction. */
+static lo_timetag timetag(const struct timeval *tv)
+{
+    lo_timetag tt;
+    tt.sec = (uint32_t)(tv->tv_sec + 2208988800UL);
+    tt.frac = (uint32_t)(tv->tv_usec * 4294.967296);
+    return tt;
+}
+
+static lo_bundle build_bundle(subscriber_t *sub, const frame_t *f,
+                              const plhm_triggers_t *t, int data)
+{
+    // resampled frames are due at their tick, which lets a receiver
+    // space out ticks that were sent together
+    lo_bundle b = lo_bundle_new(f->tick >= 0 && f->n
+                                ? timetag(&f->recs[0].readtime)
+                                : LO_TT_IMMEDIATE);
+    const plhm_record_t *recs = f->recs;
+    int i, n = data ? f->n : 0;
+
+    if (f->n_events)
+        add_events(b, sub, f, t);
+
+    // a resampled frame carries its tick, and the tick time in ms as
+    // a double, since the float readtime cannot hold the microseconds
+    if (n && f->tick >= 0)
+    {
+        lo_message m = lo_message_new();
+        lo_message_add_int64(m, f->tick);
+        lo_message_add_double(m, (recs[0].readtime.tv_sec * 1000.0)
+                              + (recs[0].readtime.tv_usec / 1000.0));
+        lo_bundle_add_message(b, "/liberty/tick", m);
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        const plhm_record_t *rec = &recs[i];
+        int st = rec->station - 1;
+        int fields = rec->fields & sub->s.fields;
+
+        if (st < 0 || st >= 16 || !(sub->s.station_mask & (1 << st)))
+            continue;
+
+        if (fields & PLHM_DATA_POSITION)
+        {
+            add_float(b, paths[st][PATH_X], rec->position[0]);
+            add_float(b, paths[st][PATH_Y], rec->position[1]);
+            add_float(b, paths[st][PATH_Z], rec->position[2]);
+        }
+
+        if (fields & PLHM_DATA_EULER)
+        {
+            add_float(b, paths[st][PATH_AZIMUTH], rec->euler[0]);
+            add_float(b, paths[st][PATH_ELEVATION], rec->euler[1]);
+            add_float(b, paths[st][PATH_ROLL], rec->euler[2]);
+        }
+
+        if (fields & PLHM_DATA_TIMESTAMP)
+        {
+            lo_message m = lo_message_new();
+            lo_message_add_int32(m, rec->timestamp);
+            lo_bundle_add_message(b, paths[st][PATH_TIMESTAMP], m);
+        }
+
+        add_float(b, paths[st][PATH_READTIME],
+                  (rec->readtime.tv_sec * 1000.0)
+                  + (rec->readtime.tv_usec / 1000.0));
+    }
+
+    if (data && f->features.features)
+        add_features(b, sub, &f->features);
+
+    return b;
+}
+
+#ifdef HAVE_SENDMMSG
+static void send_batch(int *sock, int family, struct mmsghdr *msgs, int n)
+{
+    int sent = 0, rc;
+
+    if (!n)
+        return;
+
+    if (*sock < 0)
+        *sock = socket(family, SOCK_DGRAM, 0);
+    if (*sock < 0) {
+        perror("socket");
+        return;
+    }
+
+    while (sent < n) {
+        rc = sendmmsg(*sock, msgs + sent, n - sent, 0);
+        if (rc <= 0) {
+            // skip the datagram that failed, e.g. no route to host
+            rc = 1;
+        }
+        sent += rc;
+    }
+}
+#endif
+
+void subscribers_send_frame(const frame_t *f, const plhm_triggers_t *t,
+                            double now)
+{
+    int i, j;
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgs4[MAX_SUBSCRIBERS], msgs6[MAX_SUBSCRIBERS];
+    struct iovec iov[MAX_SUBSCRIBERS];
+    int n4 = 0, n6 = 0;
+#endif
+
+    if (!paths_ready) {
+        for (i = 0; i < 16; i++)
+            for (j = 0; j < PATH_COUNT; j++)
+                sprintf(paths[i][j], "/liberty/marker/%d/%s",
+                        i+1, path_names[j]);
+        for (i = 0; i < 16; i++)
+            for (j = i + 1; j < 16; j++)
+                sprintf(distance_paths[PLHM_FEATURE_PAIR(i, j)],
+                        "/liberty/distance/%d/%d", i+1, j+1);
+        paths_ready = 1;
+    }
+
+    pthread_mutex_lock(&lock);
+    for (i = 0; i < n_subscribers; i++)
+    {
+        subscriber_t *sub = &subscribers[i];
+
+        if (sub->expires && now > sub->expires) {
+            printf("[plhm] subscription %s:%d expired\n",
+                   sub->s.host, sub->s.port);
+            remove_at(i--);
+            continue;
+        }
+
+        int data = (sub->frames++ % sub->s.divisor) == 0;
+        if (!data && !f->n_events)
+            continue;
+
+        lo_bundle b = build_bundle(sub, f, t, data);
+        size_t size = lo_bundle_length(b);
+
+#ifdef HAVE_SENDMMSG
+        if (sub->s.salen && size <= BUNDLE_MAX
+            && (sub->s.sa.ss_family == AF_INET
+                || sub->s.sa.ss_family == AF_INET6))
+        {
+            struct mmsghdr *m;
+            lo_bundle_serialise(b, sub->buffer, &size);
+            if (sub->s.sa.ss_family == AF_INET)
+                m = &msgs4[n4++];
+            else
+                m = &msgs6[n6++];
+            memset(m, 0, sizeof(struct mmsghdr));
+            iov[i].iov_base = sub->buffer;
+            iov[i].iov_len = size;
+            m->msg_hdr.msg_name = &sub->s.sa;
+            m->msg_hdr.msg_namelen = sub->s.salen;
+            m->msg_hdr.msg_iov = &iov[i];
+            m->msg_hdr.msg_iovlen = 1;
+        }
+        else
+#endif
+            lo_send_bundle(sub->s.addr, b);
+
+        lo_bundle_free_recursive(b);
+    }
+
+#ifdef HAVE_SENDMMSG
+    send_batch(&sock4, AF_INET, msgs4, n4);
+    send_batch(&sock6, AF_INET6, msgs6, n6);
+#endif
+    pthread_mutex_unlock(&lock);
+}
+
+#endif // HAVE_LIBLO
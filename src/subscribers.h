@@ -0,0 +1,62 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _SUBSCRIBERS_H_
+#define _SUBSCRIBERS_H_
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <lo/lo.h>
+
+#include <plhm.h>
+#include <plhm_triggers.h>
+
+#include "sink.h"
+
+#define MAX_SUBSCRIBERS 32
+
+/* A destination for the OSC stream.  The primary subscription is the
+ * one given by --send or /liberty/start; it never expires and is
+ * replaced by the next /liberty/start.  Others are added with
+ * /liberty/subscribe and live until unsubscribed or their lease
+ * runs out. */
+typedef struct _subscription
+{
+    char host[256];
+    int port;
+    int primary;
+    int divisor;        // send every n-th frame
+    int station_mask;   // bit 0 is station 1
+    int fields;         // PLHM_DATA_* bits
+    int features;       // PLHM_FEATURE_* bits
+    int lease;          // seconds, or 0 for no expiry
+    lo_address addr;
+    struct sockaddr_storage sa;
+    socklen_t salen;
+} subscription_t;
+
+/* Called on the thread receiving the request, since it may block on
+ * name lookup. */
+int subscription_resolve(subscription_t *s);
+void subscription_release(subscription_t *s);
+
+/* The table itself is only touched by the acquisition thread. */
+void subscribers_add(subscription_t *s, double now);
+int subscribers_remove(const char *host, int port);
+int subscribers_count(void);
+/* Trigger events are sent on every frame that has them, regardless of
+ * a subscriber's divisor; t supplies their names. */
+void subscribers_send_frame(const frame_t *f, const plhm_triggers_t *t,
+                            double now);
+void subscribers_free(void);
+
+#endif // _SUBSCRIBERS_H_
@@ -0,0 +1,97 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+/* Text records as the Liberty sends them, read through a pipe:
+ * columns run together by their signs, records missing fields, and
+ * the error byte. */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <plhm.h>
+
+static int failed = 0;
+
+#define CHECK(cond) do { if (!(cond)) { \
+    printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failed = 1; } \
+    } while (0)
+
+static int near(float a, float b)
+{
+    return a - b < 1e-4f && b - a < 1e-4f;
+}
+
+/* Feed one line to p and read it back as a record. */
+static int read_line(plhm_t *p, int wr, const char *line, plhm_record_t *r)
+{
+    if (write(wr, line, strlen(line)) != (ssize_t)strlen(line))
+        return -1;
+    memset(r, 0, sizeof(plhm_record_t));
+    return plhm_read_data_record(p, r);
+}
+
+int main()
+{
+    plhm_t *p = plhm_new();
+    plhm_record_t r;
+    int fd[2], rc;
+
+    if (!p || pipe(fd))
+        return 1;
+    fcntl(fd[0], F_SETFL, O_NONBLOCK);
+    p->rd = fd[0];
+    p->binary = 0;
+    p->fields = PLHM_DATA_POSITION | PLHM_DATA_EULER;
+
+    // negative values filling their columns leave no space between
+    rc = read_line(p, fd[1], " 1P  -12.34-5.67 100.25"
+                   "-179.999-0.125  90.000\r\n", &r);
+    CHECK(rc == 0);
+    CHECK(r.station == 1 && r.error == ' ');
+    CHECK(near(r.position[0], -12.34f));
+    CHECK(near(r.position[1], -5.67f));
+    CHECK(near(r.position[2], 100.25f));
+    CHECK(near(r.euler[0], -179.999f));
+    CHECK(near(r.euler[1], -0.125f));
+    CHECK(near(r.euler[2], 90.0f));
+
+    // a record cut short is refused and counted
+    rc = read_line(p, fd[1], " 2P    1.000   2.000\r\n", &r);
+    CHECK(rc == 1);
+    CHECK(r.station == 2);
+    CHECK(p->stats.parse_errors == 1);
+
+    // the error byte is kept, and the fields after it still read
+    rc = read_line(p, fd[1], " 3PE   1.000   2.000   3.000"
+                   "    4.000    5.000    6.000\r\n", &r);
+    CHECK(rc == 0);
+    CHECK(r.station == 3 && r.error == 'E');
+    CHECK(near(r.position[2], 3.0f) && near(r.euler[2], 6.0f));
+    CHECK(p->stats.station_errors == 1);
+
+    // the timestamp follows the angles, also run together
+    p->fields |= PLHM_DATA_TIMESTAMP;
+    rc = read_line(p, fd[1], "12P    0.500  -1.500   2.500"
+                   "   -0.001-100.000    0.000   12345678\r\n", &r);
+    CHECK(rc == 0);
+    CHECK(r.station == 12);
+    CHECK(near(r.euler[0], -0.001f) && near(r.euler[1], -100.0f));
+    CHECK(r.timestamp == 12345678);
+    CHECK(p->stats.records == 3 && p->stats.parse_errors == 1);
+
+    close(fd[0]);
+    close(fd[1]);
+    plhm_delete(p);
+    return failed;
+}
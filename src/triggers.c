@@ -0,0 +1,456 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "plhm_triggers.h"
+
+// largest grid along each axis
+#define MAX_CELLS 64
+
+void plhm_triggers_init(plhm_triggers_t *t)
+{
+    memset(t, 0, sizeof(plhm_triggers_t));
+}
+
+static void free_index(plhm_triggers_t *t)
+{
+    free(t->cell_start);
+    free(t->cell_items);
+    free(t->unbounded);
+    free(t->inside);
+    free(t->near);
+    t->cell_start = t->cell_items = t->unbounded = 0;
+    t->inside = 0;
+    t->near = 0;
+}
+
+void plhm_triggers_free(plhm_triggers_t *t)
+{
+    free_index(t);
+    free(t->regions);
+    free(t->rules);
+    plhm_triggers_init(t);
+}
+
+static plhm_region_t *add_region(plhm_triggers_t *t, plhm_region_type type,
+                                 const char *name)
+{
+    plhm_region_t *r;
+
+    if (t->n_regions >= 32767) {
+        printf("Too many regions.\n");
+        return 0;
+    }
+    r = realloc(t->regions, (t->n_regions + 1) * sizeof(plhm_region_t));
+    if (!r)
+        return 0;
+    t->regions = r;
+    r = &t->regions[t->n_regions++];
+    memset(r, 0, sizeof(plhm_region_t));
+    r->type = type;
+    strncpy(r->name, name, PLHM_TRIGGER_NAME - 1);
+    return r;
+}
+
+int plhm_triggers_add_box(plhm_triggers_t *t, const char *name,
+                          const float min[3], const float max[3])
+{
+    plhm_region_t *r;
+    int i;
+
+    for (i = 0; i < 3; i++)
+        if (!(max[i] >= min[i])) {
+            printf("Box %s has min > max.\n", name);
+            return 1;
+        }
+    if (!(r = add_region(t, PLHM_REGION_BOX, name)))
+        return 1;
+    memcpy(r->a, min, sizeof(r->a));
+    memcpy(r->b, max, sizeof(r->b));
+    return 0;
+}
+
+int plhm_triggers_add_sphere(plhm_triggers_t *t, const char *name,
+                             const float centre[3], float radius)
+{
+    plhm_region_t *r;
+
+    if (!(radius > 0)) {
+        printf("Sphere %s has no radius.\n", name);
+        return 1;
+    }
+    if (!(r = add_region(t, PLHM_REGION_SPHERE, name)))
+        return 1;
+    memcpy(r->a, centre, sizeof(r->a));
+    r->b[0] = radius;
+    return 0;
+}
+
+int plhm_triggers_add_plane(plhm_triggers_t *t, const char *name,
+                            const float normal[3], float offset)
+{
+    plhm_region_t *r;
+    float n = sqrtf(normal[0] * normal[0] + normal[1] * normal[1]
+                    + normal[2] * normal[2]);
+
+    if (!(n > 0)) {
+        printf("Plane %s has no normal.\n", name);
+        return 1;
+    }
+    if (!(r = add_region(t, PLHM_REGION_PLANE, name)))
+        return 1;
+    r->a[0] = normal[0] / n;
+    r->a[1] = normal[1] / n;
+    r->a[2] = normal[2] / n;
+    r->b[0] = offset / n;
+    return 0;
+}
+
+int plhm_triggers_add_proximity(plhm_triggers_t *t, const char *name,
+                                int a, int b, float distance)
+{
+    plhm_proximity_t *p;
+
+    if (a < 0 || b < 0 || a >= PLHM_FRAME_STATIONS
+        || b >= PLHM_FRAME_STATIONS || a == b || !(distance > 0))
+    {
+        printf("Invalid proximity rule %s.\n", name);
+        return 1;
+    }
+    p = realloc(t->rules, (t->n_rules + 1) * sizeof(plhm_proximity_t));
+    if (!p)
+        return 1;
+    t->rules = p;
+    p = &t->rules[t->n_rules++];
+    memset(p, 0, sizeof(plhm_proximity_t));
+    strncpy(p->name, name, PLHM_TRIGGER_NAME - 1);
+    p->a = a;
+    p->b = b;
+    p->distance = distance;
+    return 0;
+}
+
+/* Bounding box of a region grown by the hysteresis margin, since a
+ * station inside a region stays inside until it is that far out. */
+static int bounds(const plhm_triggers_t *t, const plhm_region_t *r,
+                  float lo[3], float hi[3])
+{
+    int i;
+    float h = t->hysteresis;
+
+    switch (r->type) {
+    case PLHM_REGION_BOX:
+        for (i = 0; i < 3; i++) {
+            lo[i] = r->a[i] - h;
+            hi[i] = r->b[i] + h;
+        }
+        return 1;
+    case PLHM_REGION_SPHERE:
+        for (i = 0; i < 3; i++) {
+            lo[i] = r->a[i] - r->b[0] - h;
+            hi[i] = r->a[i] + r->b[0] + h;
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static inline int cell_coord(const plhm_triggers_t *t, int i, float x)
+{
+    int c = (int)floorf((x - t->min[i]) * t->inv_cell[i]);
+    if (c < 0) return 0;
+    if (c >= t->dims[i]) return t->dims[i] - 1;
+    return c;
+}
+
+int plhm_triggers_build(plhm_triggers_t *t)
+{
+    float lo[3], hi[3], gmin[3], gmax[3], ext[3], size;
+    int i, n_bounded = 0, cells, x, y, z, pass;
+
+    free_index(t);
+    t->n_unbounded = 0;
+    memset(t->n_inside, 0, sizeof(t->n_inside));
+
+    t->n_words = (t->n_regions + 31) / 32;
+    t->inside = calloc(t->n_words * PLHM_FRAME_STATIONS + 1,
+                       sizeof(uint32_t));
+    t->near = calloc(t->n_rules + 1, 1);
+    t->unbounded = calloc(t->n_regions + 1, sizeof(int));
+    if (!t->inside || !t->near || !t->unbounded)
+        return 1;
+
+    for (i = 0; i < t->n_regions; i++)
+    {
+        if (!bounds(t, &t->regions[i], lo, hi)) {
+            t->unbounded[t->n_unbounded++] = i;
+            continue;
+        }
+        if (!n_bounded++) {
+            memcpy(gmin, lo, sizeof(gmin));
+            memcpy(gmax, hi, sizeof(gmax));
+        }
+        for (x = 0; x < 3; x++) {
+            if (lo[x] < gmin[x]) gmin[x] = lo[x];
+            if (hi[x] > gmax[x]) gmax[x] = hi[x];
+        }
+    }
+
+    if (!n_bounded) {
+        memset(gmin, 0, sizeof(gmin));
+        gmax[0] = gmax[1] = gmax[2] = 1;
+    }
+
+    // aim for about two regions' worth of cells, as cubic as the
+    // volume allows
+    for (i = 0; i < 3; i++) {
+        ext[i] = gmax[i] - gmin[i];
+        if (!(ext[i] > 1e-6f))
+            ext[i] = 1e-6f;
+    }
+    size = cbrtf(ext[0] * ext[1] * ext[2] / (2.0f * (n_bounded + 1)));
+    for (i = 0; i < 3; i++) {
+        t->dims[i] = (int)ceilf(ext[i] / size);
+        if (t->dims[i] < 1) t->dims[i] = 1;
+        if (t->dims[i] > MAX_CELLS) t->dims[i] = MAX_CELLS;
+        t->min[i] = gmin[i];
+        t->inv_cell[i] = t->dims[i] / ext[i];
+    }
+
+    cells = t->dims[0] * t->dims[1] * t->dims[2];
+    t->cell_start = calloc(cells + 1, sizeof(int));
+    if (!t->cell_start)
+        return 1;
+
+    // count the regions overlapping each cell, then fill
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (i = 0; i < t->n_regions; i++)
+        {
+            int c0[3], c1[3];
+            if (!bounds(t, &t->regions[i], lo, hi))
+                continue;
+            for (x = 0; x < 3; x++) {
+                c0[x] = cell_coord(t, x, lo[x]);
+                c1[x] = cell_coord(t, x, hi[x]);
+            }
+            for (z = c0[2]; z <= c1[2]; z++)
+                for (y = c0[1]; y <= c1[1]; y++)
+                    for (x = c0[0]; x <= c1[0]; x++) {
+                        int c = (z * t->dims[1] + y) * t->dims[0] + x;
+                        if (pass)
+                            t->cell_items[t->cell_start[c]++] = i;
+                        else
+                            t->cell_start[c + 1]++;
+                    }
+        }
+
+        if (!pass) {
+            for (i = 0; i < cells; i++)
+                t->cell_start[i + 1] += t->cell_start[i];
+            t->cell_items = malloc((t->cell_start[cells] + 1) * sizeof(int));
+            if (!t->cell_items)
+                return 1;
+        }
+        else {
+            // filling advanced each start to the next cell's start
+            for (i = cells; i > 0; i--)
+                t->cell_start[i] = t->cell_start[i - 1];
+            t->cell_start[0] = 0;
+        }
+    }
+
+    return 0;
+}
+
+int plhm_triggers_load(plhm_triggers_t *t, const char *path)
+{
+    char line[512], kind[32], name[PLHM_TRIGGER_NAME];
+    float v[6];
+    int lineno = 0, rc = 0, n;
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        printf("Could not open trigger file %s.\n", path);
+        return 1;
+    }
+
+    while (!rc && fgets(line, sizeof(line), f))
+    {
+        char *c = strchr(line, '#');
+        lineno++;
+        if (c)
+            *c = 0;
+
+        n = sscanf(line, "%31s %31s %f %f %f %f %f %f", kind, name,
+                   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+        if (n <= 0)
+            continue;
+
+        if (!strcmp(kind, "box") && n == 8)
+            rc = plhm_triggers_add_box(t, name, v, v + 3);
+        else if (!strcmp(kind, "sphere") && n == 6)
+            rc = plhm_triggers_add_sphere(t, name, v, v[3]);
+        else if (!strcmp(kind, "plane") && n == 6)
+            rc = plhm_triggers_add_plane(t, name, v, v[3]);
+        else if (!strcmp(kind, "proximity") && n == 5)
+            rc = plhm_triggers_add_proximity(t, name, (int)v[0] - 1,
+                                             (int)v[1] - 1, v[2]);
+        else if (!strcmp(kind, "hysteresis")
+                 && sscanf(line, "%*s %f", &v[0]) == 1 && v[0] >= 0)
+            t->hysteresis = v[0];
+        else {
+            printf("%s:%d: could not parse '%s' definition.\n",
+                   path, lineno, kind);
+            rc = 1;
+        }
+    }
+    fclose(f);
+
+    return rc || plhm_triggers_build(t);
+}
+
+/* Whether p is inside region r, grown by margin. */
+static int inside(const plhm_region_t *r, const float p[3], float margin)
+{
+    float d[3];
+    switch (r->type) {
+    case PLHM_REGION_BOX:
+        return (p[0] >= r->a[0] - margin && p[0] <= r->b[0] + margin
+                && p[1] >= r->a[1] - margin && p[1] <= r->b[1] + margin
+                && p[2] >= r->a[2] - margin && p[2] <= r->b[2] + margin);
+    case PLHM_REGION_SPHERE:
+        d[0] = p[0] - r->a[0];
+        d[1] = p[1] - r->a[1];
+        d[2] = p[2] - r->a[2];
+        return (d[0] * d[0] + d[1] * d[1] + d[2] * d[2]
+                <= (r->b[0] + margin) * (r->b[0] + margin));
+    case PLHM_REGION_PLANE:
+        return (p[0] * r->a[0] + p[1] * r->a[1] + p[2] * r->a[2]
+                >= r->b[0] - margin);
+    }
+    return 0;
+}
+
+static inline void event(plhm_trigger_event_t *events, int *n,
+                         plhm_trigger_type type, int index, int station,
+                         int other)
+{
+    events[*n].type = type;
+    events[*n].index = index;
+    events[*n].station = station;
+    events[*n].other = other;
+    (*n)++;
+}
+
+/* Enter region r if p is inside it.  State only changes when the
+ * event can be reported; otherwise it is retried on the next frame. */
+static void try_enter(plhm_triggers_t *t, int s, int r, const float p[3],
+                      plhm_trigger_event_t *events, int *n, int max)
+{
+    uint32_t *bits = &t->inside[s * t->n_words];
+
+    if (*n >= max || (bits[r >> 5] & (1u << (r & 31))))
+        return;
+    if (!inside(&t->regions[r], p, 0))
+        return;
+    if (t->n_inside[s] >= PLHM_TRIGGER_MAX_INSIDE)
+        return;
+
+    bits[r >> 5] |= 1u << (r & 31);
+    t->inside_list[s][t->n_inside[s]++] = r;
+    event(events, n, PLHM_TRIGGER_ENTER, r, s, -1);
+}
+
+int plhm_triggers_update(plhm_triggers_t *t, const plhm_frame_t *fr,
+                         plhm_trigger_event_t *events, int max)
+{
+    int n = 0, s, i;
+    float p[3];
+
+    if (!(fr->fields & PLHM_DATA_POSITION) || !t->inside)
+        return 0;
+
+    for (s = 0; s < PLHM_FRAME_STATIONS; s++)
+    {
+        uint32_t *bits = &t->inside[s * t->n_words];
+        int c, x, y, z;
+
+        if (!(fr->station_mask & (1 << s)))
+            continue;
+
+        p[0] = fr->px[s];
+        p[1] = fr->py[s];
+        p[2] = fr->pz[s];
+
+        // leave regions we are no longer in, within the margin
+        for (i = 0; i < t->n_inside[s]; i++)
+        {
+            int r = t->inside_list[s][i];
+            if (n >= max || inside(&t->regions[r], p, t->hysteresis))
+                continue;
+            bits[r >> 5] &= ~(1u << (r & 31));
+            t->inside_list[s][i--] = t->inside_list[s][--t->n_inside[s]];
+            event(events, &n, PLHM_TRIGGER_EXIT, r, s, -1);
+        }
+
+        for (i = 0; i < t->n_unbounded; i++)
+            try_enter(t, s, t->unbounded[i], p, events, &n, max);
+
+        x = (int)floorf((p[0] - t->min[0]) * t->inv_cell[0]);
+        y = (int)floorf((p[1] - t->min[1]) * t->inv_cell[1]);
+        z = (int)floorf((p[2] - t->min[2]) * t->inv_cell[2]);
+        // the far faces belong to the last cell
+        if (x == t->dims[0]) x--;
+        if (y == t->dims[1]) y--;
+        if (z == t->dims[2]) z--;
+        if (x < 0 || y < 0 || z < 0
+            || x >= t->dims[0] || y >= t->dims[1] || z >= t->dims[2])
+            continue;
+
+        c = (z * t->dims[1] + y) * t->dims[0] + x;
+        for (i = t->cell_start[c]; i < t->cell_start[c + 1]; i++)
+            try_enter(t, s, t->cell_items[i], p, events, &n, max);
+    }
+
+    for (i = 0; i < t->n_rules; i++)
+    {
+        const plhm_proximity_t *r = &t->rules[i];
+        float dx, dy, dz, d2, far;
+
+        if (n >= max || !(fr->station_mask & (1 << r->a))
+            || !(fr->station_mask & (1 << r->b)))
+            continue;
+
+        dx = fr->px[r->a] - fr->px[r->b];
+        dy = fr->py[r->a] - fr->py[r->b];
+        dz = fr->pz[r->a] - fr->pz[r->b];
+        d2 = dx * dx + dy * dy + dz * dz;
+        far = r->distance + t->hysteresis;
+
+        if (!t->near[i] && d2 <= r->distance * r->distance) {
+            t->near[i] = 1;
+            event(events, &n, PLHM_TRIGGER_NEAR, i, r->a, r->b);
+        }
+        else if (t->near[i] && d2 > far * far) {
+            t->near[i] = 0;
+            event(events, &n, PLHM_TRIGGER_FAR, i, r->a, r->b);
+        }
+    }
+
+    return n;
+}
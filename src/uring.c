@@ -0,0 +1,335 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "config.h"
+#include "uring.h"
+
+#ifdef HAVE_IO_URING
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/* liburing is not required; the ring is driven through the system
+ * calls directly. */
+
+#define URING_ENTRIES 4
+
+// user_data of each request
+#define TAG_READ 1
+#define TAG_CANCEL 2
+
+struct _plhm_uring
+{
+    int fd;
+    void *ring;
+    size_t ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    int fixed;          // buffer is registered
+    int reading;        // a read is queued or in flight
+    int flags;          // of the device, while the ring reads it
+    char buffer[plhm_rsp_max];
+};
+
+/* Requests queued but not yet seen by the kernel. */
+static unsigned unsubmitted(struct _plhm_uring *u)
+{
+    return *u->sq_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+}
+
+static int uring_enter(plhm_t *p, unsigned wait, int ms)
+{
+    struct _plhm_uring *u = p->uring;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned flags = 0;
+    int rc;
+
+    memset(&arg, 0, sizeof(arg));
+    if (wait) {
+        ts.tv_sec = ms / 1000;
+        ts.tv_nsec = (ms % 1000) * 1000000LL;
+        arg.ts = (unsigned long)&ts;
+        flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+    }
+
+    p->input_calls++;
+    rc = syscall(__NR_io_uring_enter, u->fd, unsubmitted(u), wait, flags,
+                 wait ? &arg : 0, sizeof(arg));
+    return rc < 0 ? -errno : rc;
+}
+
+static void queue(struct _plhm_uring *u, int opcode, int fd, void *addr,
+                  unsigned len, unsigned long long tag)
+{
+    unsigned tail = *u->sq_tail, i = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[i];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long)addr;
+    sqe->len = len;
+    sqe->off = (unsigned long long)-1;  // a stream, no offset
+    sqe->user_data = tag;
+
+    u->sq_array[i] = i;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void queue_read(plhm_t *p)
+{
+    struct _plhm_uring *u = p->uring;
+    unsigned len = plhm_rsp_max - 1 - p->pos;
+
+    if (len > sizeof(u->buffer))
+        len = sizeof(u->buffer);
+    queue(u, u->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ, p->rd,
+          u->buffer, len, TAG_READ);
+    u->reading = 1;
+}
+
+/* Process completions.  Returns the number of bytes added to
+ * p->buffer, or -1 on a read error. */
+static int reap(plhm_t *p)
+{
+    struct _plhm_uring *u = p->uring;
+    unsigned head = *u->cq_head;
+    int got = 0;
+
+    while (head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+        int res = cqe->res;
+        unsigned long long tag = cqe->user_data;
+        __atomic_store_n(u->cq_head, ++head, __ATOMIC_RELEASE);
+
+        if (tag != TAG_READ)
+            continue;
+        u->reading = 0;
+
+        if (res > 0) {
+            // the read was sized to the space left
+            memcpy(&p->buffer[p->pos], u->buffer, res);
+            p->pos += res;
+            got += res;
+        }
+        else if (res < 0 && res != -EAGAIN && res != -EINTR
+                 && res != -ECANCELED)
+        {
+            printf("[error %d] ", -res);
+            fflush(stdout);
+            errno = -res;
+            perror("read");
+            return -1;
+        }
+    }
+    return got;
+}
+
+int plhm_uring_fill(plhm_t *p, int ms)
+{
+    struct _plhm_uring *u = p->uring;
+    int rc;
+
+    rc = reap(p);
+    if (rc)
+        return rc;
+
+    if (!u->reading) {
+        // a read on a non-blocking file completes with EAGAIN rather
+        // than waiting for input
+        if (u->flags < 0) {
+            u->flags = fcntl(p->rd, F_GETFL);
+            fcntl(p->rd, F_SETFL, u->flags & ~O_NONBLOCK);
+        }
+        queue_read(p);
+    }
+
+    rc = uring_enter(p, 1, ms);
+    if (rc < 0 && rc != -ETIME && rc != -EINTR && rc != -EBUSY) {
+        printf("[error %d] ", -rc);
+        fflush(stdout);
+        errno = -rc;
+        perror("io_uring_enter");
+        return -1;
+    }
+    return reap(p);
+}
+
+void plhm_uring_stop(plhm_t *p)
+{
+    struct _plhm_uring *u = p->uring;
+    int rc, tries = 0;
+
+    if (!u)
+        return;
+
+    if (u->reading && unsubmitted(u)) {
+        // never seen by the kernel, take it back
+        (*u->sq_tail)--;
+        u->reading = 0;
+    }
+
+    // the kernel owns the buffer until the read completes, cancelled
+    // or not, so wait for that, asking again each second
+    while (u->reading)
+    {
+        if (tries++ % 10 == 0)
+            queue(u, IORING_OP_ASYNC_CANCEL, -1, (void*)TAG_READ, 0,
+                  TAG_CANCEL);
+        if (tries == 11)
+            printf("Waiting for a cancelled read to complete.\n");
+
+        rc = uring_enter(p, 1, 100);
+        if (rc < 0 && rc != -ETIME && rc != -EINTR && rc != -EBUSY) {
+            printf("[error %d] ", -rc);
+            fflush(stdout);
+            errno = -rc;
+            perror("io_uring_enter");
+            break;
+        }
+        reap(p);
+    }
+
+    if (u->flags >= 0) {
+        fcntl(p->rd, F_SETFL, u->flags);
+        u->flags = -1;
+    }
+}
+
+void plhm_uring_free(plhm_t *p)
+{
+    struct _plhm_uring *u = p->uring;
+    if (!u)
+        return;
+
+    plhm_uring_stop(p);
+    if (u->reading) {
+        // the ring failed with a read in flight that may still write
+        // to the buffer, so none of it can be released
+        p->uring = 0;
+        return;
+    }
+    if (u->sqes)
+        munmap(u->sqes, u->sqes_size);
+    if (u->ring)
+        munmap(u->ring, u->ring_size);
+    if (u->fd >= 0)
+        close(u->fd);
+    free(u);
+    p->uring = 0;
+}
+
+int plhm_uring_start(plhm_t *p)
+{
+    struct io_uring_params params;
+    struct _plhm_uring *u;
+    struct iovec iov;
+    size_t cq_size;
+    char *ring;
+
+    if (p->uring)
+        return 0;
+
+    u = calloc(1, sizeof(struct _plhm_uring));
+    if (!u)
+        return 1;
+    u->flags = -1;
+    p->uring = u;
+
+    memset(&params, 0, sizeof(params));
+    u->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (u->fd < 0
+        || !(params.features & IORING_FEAT_SINGLE_MMAP)
+        || !(params.features & IORING_FEAT_EXT_ARG))
+        goto fail;
+
+    // the rings share one mapping
+    u->ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes
+        + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (cq_size > u->ring_size)
+        u->ring_size = cq_size;
+    u->ring = mmap(0, u->ring_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->ring == MAP_FAILED) {
+        u->ring = 0;
+        goto fail;
+    }
+
+    u->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(0, u->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = 0;
+        goto fail;
+    }
+
+    ring = u->ring;
+    u->sq_head = (unsigned*)(ring + params.sq_off.head);
+    u->sq_tail = (unsigned*)(ring + params.sq_off.tail);
+    u->sq_mask = (unsigned*)(ring + params.sq_off.ring_mask);
+    u->sq_array = (unsigned*)(ring + params.sq_off.array);
+    u->cq_head = (unsigned*)(ring + params.cq_off.head);
+    u->cq_tail = (unsigned*)(ring + params.cq_off.tail);
+    u->cq_mask = (unsigned*)(ring + params.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*)(ring + params.cq_off.cqes);
+
+    // reads into a registered buffer skip mapping it on each request,
+    // but this may be refused under a low memory lock limit
+    iov.iov_base = u->buffer;
+    iov.iov_len = sizeof(u->buffer);
+    u->fixed = !syscall(__NR_io_uring_register, u->fd,
+                        IORING_REGISTER_BUFFERS, &iov, 1);
+    return 0;
+
+  fail:
+    plhm_uring_free(p);
+    return 1;
+}
+
+#else // HAVE_IO_URING
+
+int plhm_uring_start(plhm_t *p)
+{
+    return 1;
+}
+
+int plhm_uring_fill(plhm_t *p, int ms)
+{
+    return -1;
+}
+
+void plhm_uring_stop(plhm_t *p)
+{
+}
+
+void plhm_uring_free(plhm_t *p)
+{
+}
+
+#endif // HAVE_IO_URING
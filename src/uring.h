@@ -0,0 +1,38 @@
+/*
+ * "plhm" and "libplhm" are copyright 2009, Stephen Sinclair and
+ * authors listed in file AUTHORS.
+ *
+ * written at:
+ *   Input Devices and Music Interaction Laboratory
+ *   McGill University, Montreal, Canada
+ *
+ * This code is licensed under the GNU General Public License v2.1 or
+ * later.  See COPYING for more information.
+ */
+
+#ifndef _URING_H_
+#define _URING_H_
+
+#include "plhm.h"
+
+/* Device input through io_uring, internal to libplhm.  A read into a
+ * buffer registered with the kernel is kept queued on the device; it
+ * is submitted together with the wait for its completion, so that
+ * each batch of input costs a single system call instead of a read(),
+ * a poll() and another read(). */
+
+/* Set up a ring for p->rd.  Returns 0 on success, or 1 if io_uring is
+ * not available, in which case the classic path should be used. */
+int plhm_uring_start(plhm_t *p);
+
+/* Append input to p->buffer, waiting up to ms for some to arrive.
+ * Returns the number of bytes added, 0 on timeout, -1 on error. */
+int plhm_uring_fill(plhm_t *p, int ms);
+
+/* Cancel the queued read before the device is read directly.  Input
+ * it had already received is appended to p->buffer. */
+void plhm_uring_stop(plhm_t *p);
+
+void plhm_uring_free(plhm_t *p);
+
+#endif // _URING_H_